@@ -492,6 +492,7 @@ static const char *test_stdlib(void) {
   v7_val_t v = V7_UNDEFINED;
 #if V7_ENABLE__RegExp
   const char *c;
+  char *bin = NULL;
 #endif
 
   v7_own(v7, &v);
@@ -679,6 +680,63 @@ static const char *test_stdlib(void) {
   ASSERT_EVAL_STR_EQ(v7, c, "a\\b");
   c = "\"\"";
   ASSERT_EVAL_EQ(v7, "'abc'.replace(/.+/, '')", c);
+
+  /* Regexps with the same source and flags share the compiled program */
+  {
+    val_t g = v7_get_global(v7);
+    struct slre_prog *p1, *p2, *p3;
+    FILE *fp;
+    size_t bin_len;
+
+    ASSERT_EVAL_OK(v7, "var r1 = /x+y/g, r2 = new RegExp('x+' + 'y', 'g'), "
+                       "r3 = RegExp('x+y');");
+    p1 = v7_get_regexp_struct(v7, v7_get(v7, g, "r1", 2))->compiled_regexp;
+    p2 = v7_get_regexp_struct(v7, v7_get(v7, g, "r2", 2))->compiled_regexp;
+    p3 = v7_get_regexp_struct(v7, v7_get(v7, g, "r3", 2))->compiled_regexp;
+#if V7_REGEXP_CACHE_SIZE > 0
+    ASSERT(p1 == p2);
+#endif
+    ASSERT(p1 != p3);
+    c = "[0,\"z-z\",false]";
+    ASSERT_EVAL_EQ(v7, "r1.lastIndex = 3; "
+                       "[r2.lastIndex, 'xxy-xy'.replace(r2, 'z'), r3.global]",
+                   c);
+
+    /* precompiled regexp literals are compiled once per bcode */
+    ASSERT((fp = tmpfile()) != NULL);
+    ASSERT_EQ(v7_compile("function re_fn() { return /a(b+)c/i; }", 1, 1, fp),
+              V7_OK);
+    bin_len = (size_t) ftell(fp);
+    rewind(fp);
+    ASSERT((bin = (char *) malloc(bin_len)) != NULL);
+    ASSERT_EQ(fread(bin, 1, bin_len, fp), bin_len);
+    fclose(fp);
+    ASSERT_EQ(v7_exec_buf(v7, bin, bin_len, NULL), V7_OK);
+    c = "[false,\"BB\",true]";
+    ASSERT_EVAL_EQ(v7, "var r4 = re_fn(), r5 = re_fn(); "
+                       "[r4 === r5, r5.exec('aBBc')[1], r5.ignoreCase]",
+                   c);
+    p1 = v7_get_regexp_struct(v7, v7_get(v7, g, "r4", 2))->compiled_regexp;
+    p2 = v7_get_regexp_struct(v7, v7_get(v7, g, "r5", 2))->compiled_regexp;
+    ASSERT(p1 == p2);
+    ASSERT_EVAL_OK(v7, "r1 = r2 = r3 = r4 = r5 = re_fn = undefined");
+  }
+
+  /* Matching without backtracking is linear and picks the same captures */
+  c = "[false,true,\"abcd,a,bcd,\",true]";
+  ASSERT_EVAL_EQ(v7, "var s = 'aaaa'; s += s; s += s; s += s; "
+                     "[/(a|aa)*b/.test(s), /^(a|aa)*$/.test(s), "
+                     "/(a|ab)(c|bcd)(d*)/.exec('abcd').join(), "
+                     "/(a|aa){2,}(x)\\2/.test(s + 'xx')]",
+                 c);
+
+  /* Searches skip to where a literal prefix or a first character occurs */
+  c = "[\"ERR 2\",\"Kb\",null,\"b\",\"ab\",\"a1\"]";
+  ASSERT_EVAL_EQ(v7, "s = 'ok\\nERR 1\\n'; s += s; s += s; s += 'ERR 2'; "
+                     "[/ERR 2/.exec(s)[0], /[jk]b/i.exec('xKb')[0], "
+                     "/^ERR/.exec(s), /^b/m.exec('a\\nb')[0], "
+                     "/^ab|[xb]/.exec('ab')[0], /(?:b|a)\\d/.exec('b a1')[0]]",
+                 c);
 #endif /* V7_ENABLE__RegExp */
 
   ASSERT_EVAL_NUM_EQ(v7, "m = 'aa bb cc'.split(); m.length", 1.0);
@@ -722,6 +780,9 @@ static const char *test_stdlib(void) {
   ASSERT_EVAL_NUM_EQ(v7, "(function() {var x = 42; return eval('x')})()", 42);
 
   v7_destroy(v7);
+#if V7_ENABLE__RegExp
+  free(bin);
+#endif
   return NULL;
 }
 
@@ -974,7 +1035,7 @@ static const char *test_apply(void) {
 #if V7_ENABLE_DENSE_ARRAYS
 static const char *test_dense_arrays(void) {
   struct v7 *v7 = v7_create();
-  val_t a;
+  val_t a, v;
 
   a = v7_mk_dense_array(v7);
 
@@ -1011,10 +1072,56 @@ static const char *test_dense_arrays(void) {
   ASSERT_EVAL_NUM_EQ(v7, "(function(){return arguments})(1,2,3).length", 3);
   ASSERT_EVAL_NUM_EQ(
       v7, "(function(){return arguments}).apply(this, [1,2,3]).length", 3);
+  ASSERT_EVAL_EQ(v7, "(function(a){return eval('arguments[1]')})(1,2)", "2");
+  ASSERT_EVAL_NUM_EQ(
+      v7, "(function(a){return (function(){return arguments})(a)})(4)[0]", 4);
 
   /* ensure that a zero length dense arrays is correctly recognized */
   a = v7_mk_dense_array(v7);
-  ASSERT(v7_next_prop(v7, a, NULL) == NULL);
+  ASSERT_EQ(v7_array_length(v7, a), 0);
+  ASSERT_EVAL_EQ(v7, "Object.keys([])", "[]");
+
+  /* holes */
+  ASSERT_EVAL_EQ(v7, "a=[1,,3];[a.length, a[1], 1 in a]", "[3,undefined,false]");
+  ASSERT_EVAL_EQ(v7, "a=[1,2,3];delete a[1];[a.length, 1 in a]", "[3,false]");
+  ASSERT_EVAL_EQ(v7, "a=[];a[3]=1;Object.keys(a)", "[\"3\"]");
+  ASSERT_EVAL_NUM_EQ(v7, "new Array(5).length", 5);
+  ASSERT_EVAL_EQ(v7, "Object.keys(new Array(5))", "[]");
+  ASSERT_EVAL_ERR(v7, "new Array(-1)", V7_EXEC_EXCEPTION);
+
+  /* length */
+  ASSERT_EVAL_EQ(v7, "a=[1,2,3,4];a.length=2;a", "[1,2]");
+  ASSERT_EVAL_EQ(v7, "a=[1,2];a.length=4;[a.length, 3 in a]", "[4,false]");
+
+  /* iteration order: elements first, then other properties */
+  ASSERT_EVAL_EQ(v7, "a=[1,2,3];a.foo=1;Object.keys(a)",
+                 "[\"0\",\"1\",\"2\",\"foo\"]");
+  ASSERT_EVAL_EQ(v7, "r='';a=[1,,3];for(var k in a)r+=k;r", "\"02\"");
+
+  /* too sparse or non-default attributes: fall back to sparse arrays */
+  ASSERT_EVAL_EQ(v7, "a=[1];a[100000]=2;[a.length, a[0], a[100000]]",
+                 "[100001,1,2]");
+  ASSERT_EVAL_EQ(v7,
+                 "a=[1,2];Object.defineProperty(a,'0',{writable:false});"
+                 "a[0]=3;a.push(4);a",
+                 "[1,2,4]");
+  ASSERT_EVAL_EQ(v7, "a=[1,2];Object.preventExtensions(a);a[1]=3;a[2]=4;a",
+                 "[1,3]");
+
+  ASSERT_EVAL_EQ(v7, "a=[1,2,3,4];a.splice(1,2,'x','y','z');a",
+                 "[1,\"x\",\"y\",\"z\",4]");
+
+  /* element kinds */
+  ASSERT_EQ(eval(v7, "a=[1,2.5,,4];a[4]=5;a", &v), V7_OK);
+  ASSERT(get_object_struct(v)->attributes & V7_OBJ_NUMBER_ELEMENTS);
+  ASSERT_EQ(eval(v7, "a.push('x');a", &v), V7_OK);
+  ASSERT(!(get_object_struct(v)->attributes & V7_OBJ_NUMBER_ELEMENTS));
+  ASSERT_EVAL_EQ(v7, "a", "[1,2.5,,4,5,\"x\"]");
+
+  ASSERT_EVAL_NUM_EQ(v7, "[1,2,,3].reduce(function(a,b){return a+b})", 6);
+  ASSERT_EVAL_NUM_EQ(v7, "[1,2,3].reduce(function(a,b,i){return a+b*i},10)",
+                     18);
+  ASSERT_EVAL_ERR(v7, "[].reduce(function(){})", V7_EXEC_EXCEPTION);
 
   v7_destroy(v7);
   return NULL;
@@ -1983,6 +2090,37 @@ static const char *test_interpreter(void) {
                  "o={};switch(10) {case 1: o.one=1; case 2: o.fall=2; break; "
                  "case 3: o.three=1; break; default: o.def=1};o",
                  c);
+  c = "\"a:bc:x:d:d:c\"";
+  ASSERT_EVAL_EQ(v7,
+                 "function sw(v){var r='';switch(v){case 'a': r+='a'; break; "
+                 "case 'b': r+='b'; case 'c': r+='c'; break; default: r+='d'; "
+                 "break; case 'a': r+='?'; case 'a_long_label': r+='x'; "
+                 "break; case 'ccc': r+='C';} return r;}"
+                 "[sw('a'),sw('b'),sw('a_long_'+'label'),sw('q'),sw(1),"
+                 "sw('c')].join(':')",
+                 c);
+  c = "\"zero,zero,one,few,many,none,none,none\"";
+  ASSERT_EVAL_EQ(v7,
+                 "function si(v){switch(v){case 0: return 'zero'; case 1: "
+                 "return 'one'; case 2: case 3: return 'few'; case 1000000: "
+                 "return 'many';} return 'none';}"
+                 "[si(0),si(-0),si(1),si(3),si(1000000),si(1.5),si('1'),"
+                 "si(4)].join()",
+                 c);
+  /* Cases are compared strictly, whether or not they're dispatched by table */
+  c = "\"none,none,none,none,none,none,one,one,zero,true,false\"";
+  ASSERT_EVAL_EQ(v7,
+                 "function s2(v){switch(v){case 1: return 'one'; case 2: "
+                 "return 'two';} return 'none';}"
+                 "function s4(v){switch(v){case 1: return 'one'; case 2: "
+                 "case 3: case 4: return 'few';} return 'none';}"
+                 "function se(v){switch(v){case '': return 'empty';} "
+                 "return 'none';}"
+                 "function sz(v){switch(v){case 0: return 'zero';} "
+                 "return 'none';}"
+                 "[s2('1'),s4('1'),s2(true),s4(true),se(0),se(false),s2(1),"
+                 "s4(1),sz(-0),-0 === 0,NaN === NaN].join()",
+                 c);
 
 #if V7_ENABLE_JS_GETTERS
   ASSERT_EVAL_EQ(v7, "o={get x(){return 42}};o.x", "42");
@@ -2065,6 +2203,35 @@ static const char *test_interpreter(void) {
 
   /* here temporarily because test_stdlib has memory violations */
   ASSERT_EVAL_EQ(v7, "a=[2,1];a.sort();a", "[1,2]");
+  ASSERT_EVAL_EQ(v7, "[10,9,1,undefined,'b','a'].sort()",
+                 "[1,10,9,\"a\",\"b\",undefined]");
+  ASSERT_EVAL_EQ(v7, "[3,20,1,-5].sort(function(a,b){return a-b})",
+                 "[-5,1,3,20]");
+  ASSERT_EVAL_EQ(v7, "[3,20,1,-5].sort(function(x,y){return y-x})",
+                 "[20,3,1,-5]");
+  ASSERT_EVAL_EQ(v7,
+                 "a=[];for(i=0;i<50;i++)a.push({k:i%3,i:i});"
+                 "a.sort(function(x,y){return x.k-y.k});"
+                 "a.every(function(x,i){return i==0||a[i-1].k<x.k||"
+                 "a[i-1].k==x.k&&a[i-1].i<x.i})",
+                 "true");
+  ASSERT_EVAL_EQ(v7, "[1,,3,4].reverse()", "[4,3,,1]");
+#if V7_ENABLE__Array__reduce
+  /*
+   * reduce skips holes, passes numeric indices, and needs an initial value
+   * or at least one element, even if the initial value is undefined
+   */
+  c = "\"1:2@4,true,true,true,7\"";
+  ASSERT_EVAL_EQ(v7,
+                 "function isTE(f){try{f()}catch(e){return e instanceof "
+                 "TypeError}return false}"
+                 "[[,1,,2].reduce(function(a,b,i){return a+':'+b+'@'+(i+1)}),"
+                 "isTE(function(){[].reduce(function(){})}),"
+                 "isTE(function(){[,,].reduce(function(){})}),"
+                 "[5].reduce(function(a){return a===undefined},undefined),"
+                 "[].reduce(function(){},7)].join()",
+                 c);
+#endif
 
   /* check execution failure caused by bad parsing */
   ASSERT_EQ(eval(v7, "function", &v), V7_SYNTAX_ERROR);
@@ -2090,7 +2257,9 @@ static const char *test_interpreter(void) {
 static const char *test_strings(void) {
   val_t s;
   struct v7 *v7;
-  size_t off;
+  size_t off, bin_len;
+  char *bin;
+  FILE *fp;
 
   v7 = v7_create();
   off = v7->owned_strings.len;
@@ -2109,16 +2278,46 @@ static const char *test_strings(void) {
   ASSERT_EQ(memcmp(&s, "\x6c\x65\x6e\x67\x74\x00\xf9\xff", sizeof(s)), 0);
 
   s = v7_mk_string(v7, "longer one", ~0 /* use strlen */, 1);
-  ASSERT(v7->owned_strings.len == off + 12);
-  ASSERT_EQ(memcmp(v7->owned_strings.buf + off, "\x0alonger one\x00", 12), 0);
+  ASSERT(v7->owned_strings.len == off + 12 + STR_META_SIZE);
+  ASSERT_EQ(v7->owned_strings.buf[off], 0x0a);
+  ASSERT_EQ(memcmp(v7->owned_strings.buf + off + 1 + STR_META_SIZE,
+                   "longer one\x00", 11),
+            0);
+
+  /* Metadata is computed on demand */
+  ASSERT_EQ(str_val_hash(v7, &s), str_hash("longer one", 10));
+  ASSERT(str_val_is_ascii(v7, &s));
+#if !V7_DISABLE_STR_META
+  ASSERT_EQ(v7->owned_strings.buf[off + 1], (STR_META_VALID | STR_META_ASCII));
+#endif
 
   s = v7_mk_string(v7, "with embedded \x00 one", 19, 1);
 
-  ASSERT(v7->owned_strings.len == off + 33);
-  ASSERT(memcmp(v7->owned_strings.buf + off,
-                "\x0alonger one\x00"
-                "\x13with embedded \x00 one\x00",
-                33) == 0);
+  ASSERT(v7->owned_strings.len == off + 33 + 2 * STR_META_SIZE);
+  ASSERT(memcmp(v7->owned_strings.buf + off + 12 + STR_META_SIZE, "\x13", 1) ==
+         0);
+  ASSERT(memcmp(v7->owned_strings.buf + off + 13 + 2 * STR_META_SIZE,
+                "with embedded \x00 one\x00", 20) == 0);
+
+  s = v7_mk_string(v7, "na\xc3\xafve string", ~0, 1);
+  ASSERT(!str_val_is_ascii(v7, &s));
+  ASSERT_EVAL_EQ(v7, "'na\\u00efve string'.length", "12");
+  ASSERT_EVAL_EQ(v7, "'plain string'.charCodeAt(6)", "115");
+  ASSERT_EVAL_EQ(v7, "'plain string'.charAt(12)", "\"\"");
+
+  /* Character positions of long non-ASCII strings are indexed */
+  ASSERT_EVAL_EQ(v7,
+                 "var u = ''; for (var i = 0; i < 500; i++) "
+                 "u += i % 10 ? 'a' : '\\u0436'; u = u.slice(0); "
+                 "var re = /\\u0436/g; re.exec(u); re.exec(u); "
+                 "[u.length, u.charCodeAt(490), u.charCodeAt(491), "
+                 "u.indexOf('\\u0436', 481), u.lastIndexOf('a', 3), "
+                 "u.slice(489, 492) === 'a\\u0436a', "
+                 "u.substr(-10, 2) === '\\u0436a', "
+                 "u.substring(498) === 'aa', re.lastIndex, "
+                 "u.search(/a\\u0436/)]",
+                 "[500,1078,97,490,3,true,true,true,11,9]");
+  ASSERT(v7->rune_cache != NULL);
 
   {
     const char *lit = "foobarbaz";
@@ -2135,7 +2334,80 @@ static const char *test_strings(void) {
     }
   }
 
+#if V7_ENABLE_STR_BUILDER
+  /* Repeated concatenation appends to a shared buffer */
+  ASSERT_EQ(eval(v7, "var s = ''; for (var i = 0; i < 1000; i++) s += 'ab'; "
+                     "var t = s; s += 'x'; t += 'y'; s.length",
+                 &s),
+            V7_OK);
+  ASSERT_EQ(v7_get_double(v7, s), 2001);
+  ASSERT(v7->str_bufs != NULL);
+  v7_gc(v7, 1);
+  ASSERT_EVAL_EQ(v7, "[s.slice(-3), t.slice(-3), t.length]",
+                 "[\"abx\",\"aby\",2001]");
+  ASSERT_EVAL_EQ(v7, "s.slice(0, 2000) === t.slice(0, 2000)", "true");
+
+  /* Strings extended by later appends still read as NUL terminated */
+  ASSERT_EVAL_EQ(v7, "s = ''; for (i = 0; i < 200; i++) s += ' '; "
+                     "s += '12'; var p = s; s += '34'; "
+                     "[parseInt(p), Number(p), parseFloat(p), p.length]",
+                 "[12,12,12,202]");
+  ASSERT_EVAL_EQ(v7, "s = ''; for (i = 0; i < 200; i++) s += ' '; "
+                     "s += '1'; p = s; s += '+1'; [eval(p), eval(s)]",
+                 "[1,2]");
+  ASSERT_EVAL_EQ(v7, "s = t = p = undefined", "undefined");
+  v7_gc(v7, 1);
+  ASSERT(v7->str_bufs == NULL);
+#endif
+
+#if !V7_DISABLE_ATOMS
+  /* Property names with the same contents are the same atom */
+  ASSERT_EQ(eval(v7, "var k = 'times', a = {timestamp: 1}, b = {}; "
+                     "b[k + 'tamp'] = 2; "
+                     "var c = JSON.parse('{\"timestamp\": 3}'); "
+                     "var d = {}; d['weak' + 'key'] = 4; "
+                     "[a.timestamp, b.timestamp, c[k + 'tamp']]",
+                 &s),
+            V7_OK);
+  {
+    val_t a = v7_get(v7, v7_get_global(v7), "a", 1);
+    val_t b = v7_get(v7, v7_get_global(v7), "b", 1);
+    val_t c = v7_get(v7, v7_get_global(v7), "c", 1);
+    val_t name = v7_get_own_property(v7, a, "timestamp", 9)->name;
+    ASSERT_EQ(v7_get_own_property(v7, b, "timestamp", 9)->name, name);
+    ASSERT_EQ(v7_get_own_property(v7, c, "timestamp", 9)->name, name);
+    ASSERT_EQ(atom_find(v7, "timestamp", 9, str_hash("timestamp", 9)), name);
+  }
+  ASSERT(atom_find(v7, "weakkey", 7, str_hash("weakkey", 7)) != V7_UNDEFINED);
+  v7_gc(v7, 1);
+  ASSERT_EVAL_EQ(v7, "[a.timestamp, b.timestamp, c.timestamp, d.weakkey]",
+                 "[1,2,3,4]");
+  ASSERT_EVAL_EQ(v7, "d = undefined", "undefined");
+  v7_gc(v7, 1);
+  ASSERT_EQ(atom_find(v7, "weakkey", 7, str_hash("weakkey", 7)), V7_UNDEFINED);
+  ASSERT_EVAL_EQ(v7, "var o = {}; o['proto' + 'type'] = 5; o.prototype", "5");
+#endif
+
+  /* Names and string literals of precompiled bcode are made only once */
+  ASSERT((fp = tmpfile()) != NULL);
+  ASSERT_EQ(v7_compile("function lit_fn(long_arg) {var long_local = "
+                       "'long literal'; return long_arg + long_local;}",
+                       1, 1, fp),
+            V7_OK);
+  bin_len = (size_t) ftell(fp);
+  rewind(fp);
+  ASSERT((bin = (char *) malloc(bin_len)) != NULL);
+  ASSERT_EQ(fread(bin, 1, bin_len, fp), bin_len);
+  fclose(fp);
+  ASSERT_EQ(v7_exec_buf(v7, bin, bin_len, &s), V7_OK);
+  ASSERT_EVAL_EQ(v7, "lit_fn('a')", "\"along literal\"");
+  off = v7->foreign_strings.len;
+  ASSERT_EVAL_EQ(v7, "lit_fn('b') + lit_fn('c')",
+                 "\"blong literalclong literal\"");
+  ASSERT_EQ(v7->foreign_strings.len, off);
+
   v7_destroy(v7);
+  free(bin);
 
   return NULL;
 }
@@ -2174,6 +2446,11 @@ static const char *test_interp_unescape(void) {
   return NULL;
 }
 
+static void test_stringify_cb(const char *data, size_t len, void *user_data) {
+  struct mbuf *m = (struct mbuf *) user_data;
+  mbuf_append(m, data, len);
+}
+
 static const char *test_to_json(void) {
   char buf[100], *p;
   const char *c;
@@ -2252,6 +2529,23 @@ static const char *test_to_json(void) {
   c = "{\"a\":\"2015-11-03T00:00:00.000Z\"}";
   ASSERT_STREQ(p, c);
 
+  /* Output larger than the buffer is generated in one pass */
+  eval(v7, "var a = []; for (var i = 0; i < 100; i++) a.push({i: 'x' + i}); a",
+       &v);
+  ASSERT((p = v7_to_json(v7, v, buf, sizeof(buf))) != buf);
+  ASSERT_EQ(strncmp(p, "[{\"i\":\"x0\"},{\"i\":\"x1\"},", 22), 0);
+  {
+    struct mbuf m;
+    mbuf_init(&m, 0);
+    ASSERT_EQ(v7_stringify_to_callback(v7, v, V7_STRINGIFY_JSON,
+                                       test_stringify_cb, &m),
+              V7_OK);
+    ASSERT_EQ(m.len, strlen(p));
+    ASSERT_EQ(memcmp(m.buf, p, m.len), 0);
+    mbuf_free(&m);
+  }
+  free(p);
+
   v7_destroy(v7);
   return NULL;
 }
@@ -2311,6 +2605,36 @@ static const char *test_json_parse(void) {
     ASSERT_STREQ(s, c1);
   }
 
+  ASSERT_EVAL_JS_EXPR_EQ(
+      v7, "JSON.parse(' [1, {\"a\": [true, null, -1.5e3]}] ')",
+      "[1, {a: [true, null, -1500]}]");
+  ASSERT_EVAL_EQ(v7, "JSON.parse('\"a\\\\/b\\\\u0041\"')", "\"a/bA\"");
+  ASSERT_EVAL_ERR(v7, "JSON.parse('[1,]')", V7_EXEC_EXCEPTION);
+  ASSERT_EVAL_ERR(v7, "JSON.parse('{a: 1}')", V7_EXEC_EXCEPTION);
+  ASSERT_EVAL_ERR(v7, "JSON.parse('01')", V7_EXEC_EXCEPTION);
+  ASSERT_EVAL_ERR(v7, "JSON.parse('[1] 2')", V7_EXEC_EXCEPTION);
+
+  /* feed a document in chunks, splitting it in the middle of tokens */
+  {
+    const char *doc = "{\"key\": [12345, \"s\\u0074r\", false, {}]}";
+    struct v7_json_parser *p = v7_json_parser_create(v7);
+    size_t i, n, len = strlen(doc);
+    val_t res;
+    for (i = 0; i < len; i += n) {
+      n = len - i < 3 ? len - i : 3;
+      ASSERT_EQ(v7_json_parser_feed(p, doc + i, n), V7_OK);
+    }
+    ASSERT_EQ(v7_json_parser_end(p, &res), V7_OK);
+    v7_json_parser_destroy(p);
+    ASSERT(check_js_expr(v7, res, "({key: [12345, 'str', false, {}]})"));
+
+    p = v7_json_parser_create(v7);
+    ASSERT_EQ(v7_json_parser_feed(p, "[1, 2", 5), V7_OK);
+    ASSERT_EQ(v7_json_parser_end(p, &res), V7_SYNTAX_ERROR);
+    v7_json_parser_destroy(p);
+    v7_clear_thrown_value(v7);
+  }
+
   v7_destroy(v7);
   return NULL;
 }
@@ -2521,6 +2845,15 @@ static const char *test_file(void) {
   ASSERT_EVAL_EQ(v7, "File.open('x.txt')", "null");
   ASSERT_EVAL_EQ(v7, "File.write('x.txt', 'hello')", "true");
   ASSERT_EVAL_EQ(v7, "File.remove('x.txt')", "0");
+  ASSERT_EQ(eval(v7,
+                 "a = []; for (var i = 0; i < 100; i++) a.push({i: 'x' + i}); "
+                 "f = File.open('x.txt', 'w'); n = f.writeJSON(a); f.close(); "
+                 "n",
+                 &v),
+            V7_OK);
+  ASSERT_EQ(v7_get_double(v7, v), 1191);
+  ASSERT_EVAL_EQ(v7, "File.read('x.txt') === JSON.stringify(a)", "true");
+  ASSERT_EVAL_EQ(v7, "File.remove('x.txt')", "0");
   ASSERT_EQ(eval(v7, "File.read('test.mk')", &v), V7_OK);
   ASSERT(check_file(v7, v, "test.mk"));
   ASSERT_EVAL_EQ(v7, "File.open('test.mk', '\\0')", "null");
@@ -2555,7 +2888,12 @@ static const char *test_socket(void) {
   ASSERT_EVAL_OK(v7, "s2.send('hi'); ");
   c = "\"hi\"";
   ASSERT_EVAL_EQ(v7, "s3 = s1.accept(); s3.recv();", c);
+  ASSERT_EVAL_EQ(v7, "s2.sendJSON({a: [1, 'x']})", "13");
+  c = "\"{\\\"a\\\":[1,\\\"x\\\"]}\"";
+  ASSERT_EVAL_EQ(v7, "s3.recv()", c);
   ASSERT_EVAL_OK(v7, "s1.close(); s2.close(); s3.close();");
+  /* a failed send is reported rather than dropping the rest */
+  ASSERT_EVAL_EQ(v7, "s2.sendJSON({a: 1})", "-1");
 
   v7_destroy(v7);
   return NULL;
@@ -2662,6 +3000,350 @@ static const char *test_user_data(void) {
   return NULL;
 }
 
+#if !V7_DISABLE_GC && !V7_DISABLE_LAZY_SWEEP && !defined(V7_MALLOC_GC)
+static const char *test_gc_lazy_sweep(void) {
+  struct v7 *v7 = v7_create();
+  val_t obj;
+  int destructed = 0;
+
+  obj = v7_mk_object(v7);
+  v7_set_user_data(v7, obj, &destructed);
+  v7_set_destructor_cb(v7, obj, user_data_destructor);
+  obj = V7_UNDEFINED;
+
+  /* collections triggered by allocations leave the garbage to be swept */
+  ASSERT_EQ(maybe_gc(v7), 1);
+  ASSERT_EQ(destructed, 0);
+  ASSERT(v7->generic_object_arena.sweep != NULL);
+  while (v7_gc_step(v7, 10)) {
+  }
+  ASSERT_EQ(destructed, 1);
+  ASSERT(v7->property_arena.sweep == NULL);
+
+  ASSERT_EVAL_EQ(v7,
+                 "var a = []; for (var i = 0; i < 500; i++) { a.push({x: i}); "
+                 "({y: i}); } a[499].x + a[0].x",
+                 "499");
+  ASSERT_EQ(maybe_gc(v7), 1);
+  ASSERT_EVAL_EQ(v7, "a.length + a[10].x", "510");
+
+  v7_destroy(v7);
+  return NULL;
+}
+#endif
+
+#if !V7_DISABLE_GC && V7_ENABLE__Memory__stats && !defined(V7_MALLOC_GC)
+static int gc_count_for_ratio(unsigned int ratio) {
+  struct v7_create_opts opts;
+  struct v7 *v7;
+  v7_val_t res;
+  int n = -1;
+
+  memset(&opts, 0, sizeof(opts));
+  opts.gc_live_ratio = ratio;
+  v7 = v7_create_opt(opts);
+  if (v7_exec(v7,
+              "var a = []; for (var i = 0; i < 500; i++) a.push({x: i}); "
+              "a[499].x",
+              &res) == V7_OK &&
+      v7_get_double(v7, res) == 499) {
+    n = v7_heap_stat(v7, V7_HEAP_STAT_GC_COUNT);
+  }
+  v7_destroy(v7);
+  return n;
+}
+
+static const char *test_gc_policy(void) {
+  int eager = gc_count_for_ratio(100), lazy = gc_count_for_ratio(50);
+  struct v7_create_opts opts;
+  struct v7 *v7;
+
+  ASSERT(lazy > 0);
+  /* a growing heap gets collected every few allocations */
+  ASSERT(eager > 10 * lazy);
+
+  /* sequence numbers of strings don't wrap around before the budget is hit */
+  memset(&opts, 0, sizeof(opts));
+  opts.gc_alloc_budget = 64 * 1024 * 1024;
+  v7 = v7_create_opt(opts);
+  ASSERT_EVAL_NUM_EQ(v7,
+                     "var keep = 'kept string', n = 0; "
+                     "for (var i = 0; i < 70000; i++) "
+                     "  if ((keep + i).length > keep.length) n++; n",
+                     70000);
+#if !V7_DISABLE_STR_ALLOC_SEQ
+  ASSERT(v7_heap_stat(v7, V7_HEAP_STAT_GC_COUNT) > 0);
+#endif
+  v7_destroy(v7);
+  return NULL;
+}
+#endif
+
+#if V7_ENABLE_PROFILER
+static const char *test_profiler(void) {
+  struct v7 *v7 = v7_create();
+  v7_val_t v;
+  char buf[4096];
+  size_t n;
+  FILE *fp;
+
+  v7_prof_start(v7, 1);
+  ASSERT_EQ(v7_exec(v7, "var s = 0;\nfor (var i = 0; i < 10; i++)\n  s += i;",
+                    &v),
+            V7_OK);
+  v7_prof_stop(v7);
+  /* not profiled */
+  ASSERT_EQ(v7_exec(v7, "s *= 2;", &v), V7_OK);
+
+  ASSERT((fp = tmpfile()) != NULL);
+  v7_prof_dump(v7, fp);
+  rewind(fp);
+  n = fread(buf, 1, sizeof(buf) - 1, fp);
+  buf[n] = '\0';
+  fclose(fp);
+  ASSERT(strstr(buf, "          10 ") != NULL);
+  ASSERT(strstr(buf, ":3 ADD\n") != NULL);
+  ASSERT(strstr(buf, "MUL") == NULL);
+
+  ASSERT((fp = tmpfile()) != NULL);
+  v7_prof_dump_folded(v7, fp);
+  rewind(fp);
+  n = fread(buf, 1, sizeof(buf) - 1, fp);
+  buf[n] = '\0';
+  fclose(fp);
+  ASSERT(strstr(buf, ":3 ") != NULL);
+
+  v7_destroy(v7);
+  return NULL;
+}
+#endif
+
+static const char *test_large_objects(void) {
+  struct v7 *v7 = v7_create();
+  v7_val_t obj = v7_mk_object(v7);
+  char buf[20];
+  int i;
+
+  v7_own(v7, &obj);
+
+  /* big enough to get the property index */
+  ASSERT_EVAL_NUM_EQ(
+      v7, "var o = {}; for (var i = 0; i < 100; i++) o['key' + i] = i; o.key77",
+      77);
+  ASSERT_EVAL_NUM_EQ(v7, "o.k = 1; o.k + o.key0 + o.key99", 100);
+  ASSERT_EVAL_EQ(v7, "delete o.key50; o.key50", "undefined");
+  ASSERT_EVAL_EQ(v7, "'key50' in o", "false");
+  ASSERT_EVAL_NUM_EQ(v7, "o.key50 = 5; o.key50 + o.key51", 56);
+  ASSERT_EVAL_NUM_EQ(v7, "Object.keys(o).length", 101);
+  ASSERT_EVAL_NUM_EQ(v7, "var n = 0; for (var k in o) n++; n", 101);
+  v7_gc(v7, 1);
+  ASSERT_EVAL_NUM_EQ(v7, "o.key1 + o.key98", 99);
+
+  /* arrays manipulate property lists directly */
+  ASSERT_EVAL_NUM_EQ(v7,
+                     "var a = []; for (var i = 0; i < 40; i++) a[i] = i;"
+                     "a.splice(10, 20); a.length",
+                     20);
+  ASSERT_EVAL_NUM_EQ(v7, "a[9] + a[10] + a[19]", 9 + 30 + 39);
+  ASSERT_EVAL_EQ(v7, "a[20]", "undefined");
+
+  /* C API */
+  for (i = 0; i < 50; i++) {
+    c_snprintf(buf, sizeof(buf), "prop_%d", i);
+    v7_set(v7, obj, buf, ~0, v7_mk_number(v7, i));
+  }
+  v7_set_user_data(v7, obj, (void *) 0xdeadbeef);
+  ASSERT(v7_get_user_data(v7, obj) == (void *) 0xdeadbeef);
+  ASSERT_EQ(v7_get_double(v7, v7_get(v7, obj, "prop_42", ~0)), 42.0);
+  ASSERT_EQ(v7_del(v7, obj, "prop_42", ~0), 0);
+  ASSERT(v7_is_undefined(v7_get(v7, obj, "prop_42", ~0)));
+  ASSERT_EQ(v7_del(v7, obj, "prop_42", ~0), -1);
+  ASSERT_EQ(v7_get_double(v7, v7_get(v7, obj, "prop_41", ~0)), 41.0);
+
+  v7_disown(v7, &obj);
+  v7_destroy(v7);
+  return NULL;
+}
+
+static const char *test_inline_cache(void) {
+  struct v7 *v7 = v7_create();
+#if V7_ENABLE__Memory__stats && !V7_DISABLE_INLINE_CACHE
+  unsigned long hits, misses;
+  val_t f;
+#endif
+
+  ASSERT_EVAL_OK(v7,
+                 "var g = 1, P = {z: 3};"
+                 "function f(o) { var s = 0;"
+                 "  for (var i = 0; i < 100; i++) { o.y = o.x + g; s += o.y; }"
+                 "  return s + o.z; }");
+  ASSERT_EVAL_NUM_EQ(v7, "var o = Object.create(P); o.x = 1; f(o)", 203);
+#if V7_ENABLE__Memory__stats && !V7_DISABLE_INLINE_CACHE
+  f = v7_get(v7, v7_get_global(v7), "f", 1);
+  ASSERT_EQ(v7_func_ic_stat(v7, f, &hits, &misses), 0);
+  ASSERT(hits > misses);
+  ASSERT(v7_heap_stat(v7, V7_HEAP_STAT_IC_HITS) > 0);
+  ASSERT_EQ(v7_func_ic_stat(v7, v7_get_global(v7), &hits, &misses), -1);
+#endif
+
+  /* cached lookups must notice shadowing, deletion and prototype changes */
+  ASSERT_EVAL_NUM_EQ(v7, "o.z = 10; f(o)", 210);
+  ASSERT_EVAL_NUM_EQ(v7, "delete o.z; f(o)", 203);
+  ASSERT_EVAL_NUM_EQ(v7, "P.z = 4; f(o)", 204);
+  ASSERT_EVAL_OK(v7, "var Q = {z: 5}");
+  v7_set_proto(v7, v7_get(v7, v7_get_global(v7), "o", 1),
+               v7_get(v7, v7_get_global(v7), "Q", 1));
+  ASSERT_EVAL_NUM_EQ(v7, "f(o)", 205);
+  ASSERT_EVAL_NUM_EQ(v7, "f({x: 2, z: 0})", 300);
+  ASSERT_EVAL_NUM_EQ(
+      v7, "Object.defineProperty(o, 'y', {value: 7, writable: false}); f(o)",
+      705);
+  ASSERT_EVAL_NUM_EQ(v7, "g = 2; f({x: 0, z: 0})", 200);
+  v7_gc(v7, 1);
+  ASSERT_EVAL_NUM_EQ(v7, "f({x: 0, z: 1})", 201);
+
+  v7_destroy(v7);
+  return NULL;
+}
+
+static const char *test_local_slots(void) {
+  struct v7 *v7 = v7_create();
+#if !V7_DISABLE_LOCAL_SLOTS
+  val_t f;
+#endif
+
+  ASSERT_EVAL_OK(v7,
+                 "function f(a, b, a) { var s = a;"
+                 "  for (var i = 0; i < b; i++) s += i;"
+                 "  return s; }"
+                 "function g(n) { return n < 2 ? n : g(n - 1) + g(n - 2); }"
+                 "function h(x) { return function() { return x; }; }");
+  ASSERT_EVAL_NUM_EQ(v7, "f(1, 4, 10)", 16);
+  ASSERT_EVAL_NUM_EQ(v7, "g(15)", 610);
+  ASSERT_EVAL_NUM_EQ(v7, "h(7)()", 7);
+#if !V7_DISABLE_LOCAL_SLOTS
+  f = v7_get(v7, v7_get_global(v7), "f", 1);
+  ASSERT_EQ(get_js_function_struct(f)->bcode->uses_slots, 1);
+  f = v7_get(v7, v7_get_global(v7), "h", 1);
+  ASSERT_EQ(get_js_function_struct(f)->bcode->uses_slots, 0);
+#endif
+
+  ASSERT_EVAL_EQ(v7, "(function(a) { var b; return delete a; })(1)", "false");
+  ASSERT_EVAL_EQ(v7, "(function(a) { var b; return typeof b + a; })(1)",
+                 "\"undefined1\"");
+  ASSERT_EVAL_NUM_EQ(
+      v7, "(function(o) { var n = 0; for (var k in o) n++; return n; })"
+          "({x: 1, y: 2})",
+      2);
+  ASSERT_EVAL_NUM_EQ(
+      v7, "(function() { var e = 1; try { throw 2; } catch (x) { e += x; }"
+          "  return e; })()",
+      3);
+  ASSERT_EVAL_EQ(v7,
+                 "(function(q) { try { q(); } catch (e) { return e.message; }"
+                 "  })(1)",
+                 "\"q is not a function\"");
+  ASSERT_EVAL_EQ(v7,
+                 "(function() { var a = {}; try { a.nope(); }"
+                 "  catch (e) { return e.message; } })()",
+                 "\"a.nope is not a function\"");
+  ASSERT_EVAL_EQ(v7,
+                 "(function(q) { try { q.b(); } catch (e) { return e.message; }"
+                 "  })({})",
+                 "\"q.b is not a function\"");
+
+  v7_destroy(v7);
+  return NULL;
+}
+
+static const char *test_bcode_cache(void) {
+  struct v7_create_opts opts;
+  struct v7 *v7;
+  const char *src =
+      "this.n = (this.n || 0) + 1;"
+      "function f() { return ('n' + n).length + n; } f()";
+  int i;
+
+  memset(&opts, 0, sizeof(opts));
+  opts.bcode_cache_size = 2;
+  v7 = v7_create_opt(opts);
+
+  ASSERT_EVAL_NUM_EQ(v7, src, 3);
+  v7_gc(v7, 1);
+  ASSERT_EVAL_NUM_EQ(v7, src, 4);
+  ASSERT_EVAL_ERR(v7, "var +", V7_SYNTAX_ERROR);
+  ASSERT_EVAL_ERR(v7, "var +", V7_SYNTAX_ERROR);
+  for (i = 0; i < 3; i++) {
+    ASSERT_EVAL_NUM_EQ(v7, "1 + 2", 3);
+  }
+  /* `src` is the least recently used one, so it gets evicted */
+  ASSERT_EVAL_NUM_EQ(v7, "3 + 4", 7);
+  ASSERT_EVAL_NUM_EQ(v7, src, 5);
+#if V7_ENABLE__Memory__stats && !V7_DISABLE_BCODE_CACHE
+  ASSERT_EQ(v7_heap_stat(v7, V7_HEAP_STAT_BCODE_CACHE_HITS), 3);
+  ASSERT_EQ(v7_heap_stat(v7, V7_HEAP_STAT_BCODE_CACHE_MISSES), 6);
+  ASSERT(v7_heap_stat(v7, V7_HEAP_STAT_BCODE_CACHE_BYTES) > (int) strlen(src));
+#endif
+
+  v7_destroy(v7);
+  return NULL;
+}
+
+static const char *test_bcode_image(void) {
+  struct v7 *v7 = v7_create();
+  const char *path = "bcode_image.bin", *c;
+  struct bcode *b1, *b2;
+  struct bcode_image_hdr hdr;
+  val_t res;
+  char *bin;
+  size_t bin_len;
+  FILE *fp;
+
+  ASSERT((fp = fopen(path, "wb")) != NULL);
+  ASSERT_EQ(v7_compile("function mk() { return function(x) { return x + "
+                       "'abcdefgh'; }; } var f1 = mk(), f2 = mk(); f1('x')",
+                       1, 1, fp),
+            V7_OK);
+  fclose(fp);
+
+  ASSERT_EQ(v7_load_image(v7, path, &res), V7_OK);
+  ASSERT(check_value(v7, res, "\"xabcdefgh\""));
+  c = "[false,\"yabcdefgh\"]";
+  ASSERT_EVAL_EQ(v7, "[f1 === f2, f2('y')]", c);
+
+  /* instances of a nested function share the bcode living in the image */
+  b1 = get_js_function_struct(v7_get(v7, v7_get_global(v7), "f1", 2))->bcode;
+  b2 = get_js_function_struct(v7_get(v7, v7_get_global(v7), "f2", 2))->bcode;
+  ASSERT(b1 == b2);
+  ASSERT(b1->image != NULL);
+  ASSERT_EVAL_OK(v7, "mk = f1 = f2 = undefined");
+  v7_gc(v7, 1);
+
+  /* images of an unknown version are rejected */
+  ASSERT((bin = cs_read_file(path, &bin_len)) != NULL);
+  bin[sizeof(BIN_BCODE_IMAGE_SIGNATURE) + 4]++;
+  ASSERT_EQ(v7_exec_buf(v7, bin, bin_len, NULL), V7_SYNTAX_ERROR);
+  bin[sizeof(BIN_BCODE_IMAGE_SIGNATURE) + 4]--;
+
+  /* so are ones whose script record doesn't fit in the declared size */
+  memcpy(&hdr, bin + sizeof(BIN_BCODE_IMAGE_SIGNATURE), sizeof(hdr));
+  hdr.size--;
+  memcpy(bin + sizeof(BIN_BCODE_IMAGE_SIGNATURE), &hdr, sizeof(hdr));
+  ASSERT_EQ(v7_exec_buf(v7, bin, bin_len, NULL), V7_SYNTAX_ERROR);
+
+  ASSERT_EQ(v7_load_image(v7, "nonexistent.bin", NULL), V7_EXEC_EXCEPTION);
+  ASSERT((fp = fopen(path, "wb")) != NULL);
+  fclose(fp);
+  ASSERT_EQ(v7_load_image(v7, path, &res), V7_EXEC_EXCEPTION);
+  c = "\"[bcode_image.bin] is not a bcode image\"";
+  ASSERT(check_value(v7, v7_get(v7, res, "message", ~0), c));
+
+  free(bin);
+  ASSERT_EQ(remove(path), 0);
+  v7_destroy(v7);
+  return NULL;
+}
+
 #define MK_OP_PUSH_LIT(n) OP_PUSH_LIT, (enum opcode)(n)
 #define MK_OP_PUSH_VAR_NAME(n) OP_PUSH_VAR_NAME, (enum opcode)(n)
 #define MK_OP_GET_VAR(n) OP_GET_VAR, (enum opcode)(n)
@@ -4575,6 +5257,20 @@ static const char *run_all_tests(const char *filter, double *total_elapsed) {
   RUN_TEST(test_gc_own);
 #endif
   RUN_TEST(test_user_data);
+#if !V7_DISABLE_GC && !V7_DISABLE_LAZY_SWEEP && !defined(V7_MALLOC_GC)
+  RUN_TEST(test_gc_lazy_sweep);
+#endif
+#if !V7_DISABLE_GC && V7_ENABLE__Memory__stats && !defined(V7_MALLOC_GC)
+  RUN_TEST(test_gc_policy);
+#endif
+#if V7_ENABLE_PROFILER
+  RUN_TEST(test_profiler);
+#endif
+  RUN_TEST(test_large_objects);
+  RUN_TEST(test_inline_cache);
+  RUN_TEST(test_local_slots);
+  RUN_TEST(test_bcode_cache);
+  RUN_TEST(test_bcode_image);
   RUN_TEST(test_exec_generic);
   RUN_TEST(test_ecmac);
   return NULL;
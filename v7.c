@@ -3312,6 +3312,22 @@ void cr_context_free(struct cr_ctx *p_ctx);
 #define V7_DISABLE_GC 0
 #endif
 
+#ifndef V7_DISABLE_LAZY_SWEEP
+#define V7_DISABLE_LAZY_SWEEP 0
+#endif
+
+#ifndef V7_DISABLE_INLINE_CACHE
+#define V7_DISABLE_INLINE_CACHE 0
+#endif
+
+#ifndef V7_DISABLE_LOCAL_SLOTS
+#define V7_DISABLE_LOCAL_SLOTS 0
+#endif
+
+#ifndef V7_DISABLE_BCODE_CACHE
+#define V7_DISABLE_BCODE_CACHE 0
+#endif
+
 #ifndef V7_DISABLE_CALL_ERROR_CONTEXT
 #define V7_DISABLE_CALL_ERROR_CONTEXT 0
 #endif
@@ -3328,6 +3344,18 @@ void cr_context_free(struct cr_ctx *p_ctx);
 #define V7_DISABLE_STR_ALLOC_SEQ 0
 #endif
 
+#ifndef V7_DISABLE_STR_META
+#define V7_DISABLE_STR_META 0
+#endif
+
+#ifndef V7_DISABLE_PROP_INDEX
+#define V7_DISABLE_PROP_INDEX 0
+#endif
+
+#ifndef V7_DISABLE_ATOMS
+#define V7_DISABLE_ATOMS 0
+#endif
+
 #ifndef V7_ENABLE_CALL_TRACE
 #define V7_ENABLE_CALL_TRACE 0
 #endif
@@ -3337,7 +3365,7 @@ void cr_context_free(struct cr_ctx *p_ctx);
 #endif
 
 #ifndef V7_ENABLE_DENSE_ARRAYS
-#define V7_ENABLE_DENSE_ARRAYS 0
+#define V7_ENABLE_DENSE_ARRAYS 1
 #endif
 
 #ifndef V7_ENABLE_ENTITY_IDS
@@ -3364,6 +3392,10 @@ void cr_context_free(struct cr_ctx *p_ctx);
 #define V7_ENABLE_JS_SETTERS 0
 #endif
 
+#ifndef V7_ENABLE_PROFILER
+#define V7_ENABLE_PROFILER 0
+#endif
+
 #ifndef V7_ENABLE_STACK_TRACKING
 #define V7_ENABLE_STACK_TRACKING 0
 #endif
@@ -3372,6 +3404,10 @@ void cr_context_free(struct cr_ctx *p_ctx);
 #define V7_ENABLE_SOCKET 0
 #endif
 
+#ifndef V7_ENABLE_STR_BUILDER
+#define V7_ENABLE_STR_BUILDER 1
+#endif
+
 #ifndef V7_AST_FORCE_LINE_NUMBERS
 #define V7_AST_FORCE_LINE_NUMBERS 0
 #endif
@@ -3664,6 +3700,24 @@ struct v7_create_opts {
   size_t object_arena_size;
   size_t function_arena_size;
   size_t property_arena_size;
+  /*
+   * Max number of scripts whose compiled bcode is kept by `v7_exec()` and
+   * friends, so that executing the same source again skips parsing and
+   * compilation. 0 (the default) disables the cache.
+   */
+  size_t bcode_cache_size;
+  /*
+   * Garbage collection policy. After each collection, the heap is allowed to
+   * grow until the live data (cells and strings) make up `gc_live_ratio`
+   * percent of it, and at least by `gc_alloc_budget` bytes, before the next
+   * collection is triggered; 100 collects whenever an arena runs out of
+   * cells. Arenas grow by blocks of `gc_min_growth` to `gc_max_growth` cells.
+   * Defaults are 80, 0, 10 and 1000 respectively.
+   */
+  unsigned int gc_live_ratio;
+  size_t gc_alloc_budget;
+  size_t gc_min_growth;
+  size_t gc_max_growth;
 #ifdef V7_STACK_SIZE
   void *c_stack_base;
 #endif
@@ -3873,6 +3927,19 @@ struct gc_arena {
   struct gc_cell *free; /* head of free list */
   size_t cell_size;
 
+  /*
+   * Cells of the newest block which were never allocated: they are handed
+   * out by bumping `top`, and are not threaded into the free list.
+   */
+  struct gc_cell *top;
+  struct gc_cell *limit;
+
+  /*
+   * Link to the next block to be swept by the lazy sweep, or NULL if there
+   * is no sweep in progress.
+   */
+  struct gc_block **sweep;
+
 #if V7_ENABLE__Memory__stats
   unsigned long allocations; /* cumulative counter of allocations */
   unsigned long garbage;     /* cumulative counter of garbage */
@@ -3973,6 +4040,8 @@ typedef unsigned short v7_prop_attr_t;
  * keep all offsets in one place
  */
 #define _V7_DESC_PRESERVE_VALUE (1 << 8)
+/* special property holding the hash index of object's own properties */
+#define _V7_PROPERTY_INDEX (1 << 9)
 
 #define V7_PROP_ATTR_IS_WRITABLE(a) (!(a & V7_PROPERTY_NON_WRITABLE))
 #define V7_PROP_ATTR_IS_ENUMERABLE(a) (!(a & V7_PROPERTY_NON_ENUMERABLE))
@@ -4108,6 +4177,10 @@ struct prop_iter_ctx {
   struct prop_iter_proxy_ctx *proxy_ctx;
 #endif
   struct v7_property *cur_prop;
+#if V7_ENABLE_DENSE_ARRAYS
+  v7_val_t dense_array;
+  unsigned long dense_idx;
+#endif
 
   unsigned init : 1;
 };
@@ -4856,6 +4929,36 @@ enum opcode {
    */
   OP_EXIT_CATCH,
 
+  /*
+   * Takes a varint argument -- index of the call frame slot holding an
+   * argument or a local variable of the current function (see
+   * `bcode::uses_slots`), and pushes its value onto the stack.
+   *
+   * `( -- a )`
+   */
+  OP_GET_LOCAL,
+
+  /*
+   * Like `OP_GET_LOCAL`, but stores the value from the top of the stack into
+   * the slot, leaving the value on the stack.
+   *
+   * `( a -- a )`
+   */
+  OP_SET_LOCAL,
+
+  /*
+   * Multi-way branch of a `switch` statement whose `case` expressions are all
+   * string literals, or all integer literals. Takes the operands described
+   * by `struct bcode_switch_slot`, pops the value to dispatch on and jumps
+   * to the matching `case` or to the default target.
+   *
+   * Like `OP_JMP_TRUE_DROP`, when a `case` matches it also drops the value
+   * below.
+   *
+   * `( a b -- b )` or `( a b -- a )`
+   */
+  OP_SWITCH,
+
   OP_MAX,
 };
 
@@ -4979,6 +5082,8 @@ typedef unsigned char v7_obj_attr_t;
 #define V7_OBJ_OFF_HEAP (1 << 3)       /* object not managed by V7 HEAP */
 #define V7_OBJ_HAS_DESTRUCTOR (1 << 4) /* has user data */
 #define V7_OBJ_PROXY (1 << 5)          /* it's a Proxy object */
+#define V7_OBJ_PROTOTYPE (1 << 6)      /* is a prototype of some object */
+#define V7_OBJ_NUMBER_ELEMENTS (1 << 7) /* dense array of numbers and holes */
 
 /*
  * JavaScript value is either a primitive, or an object.
@@ -5100,6 +5205,10 @@ struct v7_call_frame_bcode {
   } vals;
   struct bcode *bcode;
   char *bcode_ops;
+
+  /* Arguments and locals, if `bcode->uses_slots` is set */
+  val_t *slots;
+  size_t slots_cnt;
 };
 
 /*
@@ -5197,12 +5306,37 @@ struct v7 {
 
   struct mbuf stack; /* value stack for bcode interpreter */
 
-  struct mbuf owned_strings;   /* Sequence of (varint len, char data[]) */
+  struct mbuf owned_strings;   /* Sequence of (varint len, meta, data[]) */
   struct mbuf foreign_strings; /* Sequence of (varint len, char *data) */
+#if V7_ENABLE_STR_BUILDER
+  struct str_buf *str_bufs; /* Append buffers of concatenated strings */
+#endif
+#if !V7_DISABLE_ATOMS
+  struct atom_slot *atoms; /* Interned property names, see `atom_intern()` */
+  uint32_t atoms_cap;      /* power of 2 */
+  uint32_t atoms_cnt;
+#endif
+  struct str_rune_index *rune_cache; /* see `str_val_runes()` */
+  int rune_cache_next;               /* entry to be replaced next */
+
+#if V7_ENABLE__RegExp
+  /* Compiled regexps, see `struct regexp_cache_entry` */
+  struct regexp_cache_entry *regexp_cache;
+  size_t regexp_cache_cnt;
+#endif
 
   struct mbuf tmp_stack; /* Stack of val_t* elements, used as root set */
   int need_gc;           /* Set to true to trigger GC when safe */
 
+  /* GC policy, see `struct v7_create_opts` */
+  unsigned int gc_live_ratio;
+  size_t gc_alloc_budget;
+  size_t gc_max_growth;
+
+  size_t gc_live;      /* bytes of cells marked by the last collection */
+  size_t gc_allocated; /* bytes allocated since the last collection */
+  size_t gc_budget;    /* bytes to allocate before the next collection */
+
   struct gc_arena generic_object_arena;
   struct gc_arena function_arena;
   struct gc_arena property_arena;
@@ -5211,6 +5345,7 @@ struct v7 {
   size_t bcode_ops_size;
   size_t bcode_lit_total_size;
   size_t bcode_lit_deser_size;
+  unsigned long gc_count; /* number of garbage collections */
 #endif
   struct mbuf owned_values; /* buffer for GC roots owned by C code */
 
@@ -5250,6 +5385,38 @@ struct v7 {
   /* singleton, pointer because of amalgamation */
   struct v7_property *cur_dense_prop;
 
+#if !V7_DISABLE_INLINE_CACHE
+  /*
+   * Inline cache entries are valid only while this number is the same as at
+   * the time they were filled, see `struct bcode_ic`.
+   */
+  uint64_t ic_epoch;
+#if V7_ENABLE__Memory__stats
+  unsigned long ic_hits;
+  unsigned long ic_misses;
+#endif
+#endif
+
+#if !V7_DISABLE_BCODE_CACHE
+  /*
+   * Compiled scripts executed by `b_exec()`, most recently used first; see
+   * `struct bcode_cache_entry`.
+   */
+  struct bcode_cache_entry *bcode_cache;
+  size_t bcode_cache_cnt;
+  size_t bcode_cache_max; /* 0 if the cache is disabled */
+#if V7_ENABLE__Memory__stats
+  unsigned long bcode_cache_hits;
+  unsigned long bcode_cache_misses;
+  size_t bcode_cache_bytes;
+#endif
+#endif
+
+#if V7_ENABLE_PROFILER
+  /* Bcode profiler, see `v7_prof_start()` */
+  struct prof *prof;
+#endif
+
   volatile int interrupted;
 #ifdef V7_STACK_SIZE
   void *sp_limit;
@@ -5315,12 +5482,13 @@ struct v7 {
   /* true if precompiling; affects compiler bcode choices */
   unsigned int is_precompiling : 1;
 
-  enum opcode last_ops[2]; /* trace of last ops, used for error reporting */
+  enum opcode last_ops[4]; /* trace of last ops, used for error reporting */
 };
 
 struct v7_property {
   struct v7_property *
       next; /* Linkage in struct v7_generic_object::properties */
+  uint8_t gc_flags; /* See `struct gc_cell` */
   v7_prop_attr_t attributes;
 #if V7_ENABLE_ENTITY_IDS
   entity_id_t entity_id;
@@ -5335,6 +5503,7 @@ struct v7_property {
 struct v7_object {
   /* First HIDDEN property in a chain is an internal object value */
   struct v7_property *properties;
+  uint8_t gc_flags; /* See `struct gc_cell` */
   v7_obj_attr_t attributes;
 #if V7_ENABLE_ENTITY_IDS
   entity_id_part_t entity_id_base;
@@ -5688,6 +5857,157 @@ V7_PRIVATE enum v7_err v7_char_code_at(struct v7 *v7, v7_val_t s, v7_val_t at,
 V7_PRIVATE int s_cmp(struct v7 *, val_t a, val_t b);
 V7_PRIVATE val_t s_concat(struct v7 *, val_t, val_t);
 
+#if V7_ENABLE_STR_BUILDER
+
+/*
+ * Minimal length of a concatenation result which is worth keeping in an
+ * append buffer.
+ */
+#ifndef V7_STR_BUF_MIN_LEN
+#define V7_STR_BUF_MIN_LEN 128
+#endif
+
+/*
+ * Append buffer holding the data of strings produced by repeated
+ * concatenation (`s += chunk`).
+ *
+ * Such strings are represented by a small owned string whose length is
+ * encoded as a non-canonical 2-byte varint (which `embed_string()` never
+ * produces), and whose data is a `struct str_buf_ref`. All strings sharing
+ * a buffer are prefixes of its data; concatenating the longest of them with
+ * another string appends to the buffer in place, which makes repeated
+ * concatenation amortized linear. Data never moves, so the existing strings
+ * stay valid; one that is read after the buffer grew past its end is copied
+ * to a buffer of its own to get its NUL terminator back. Buffers are freed by
+ * GC when no string references them.
+ */
+struct str_buf {
+  struct str_buf *next;
+  size_t len;  /* Used bytes of `data` */
+  size_t size; /* Allocated bytes of `data` */
+  int marked;
+  char data[1];
+};
+
+struct str_buf_ref {
+  struct str_buf *buf;
+  size_t len;
+};
+
+/* Whether the owned string `s` (which points to its length) is a reference */
+#define STR_BUF_IS_REF(s)                  \
+  (((s)[0] & 0x80) && (s)[1] == 0 &&       \
+   ((s)[0] & 0x7f) == sizeof(struct str_buf_ref))
+
+/* Mark the buffer referenced by the owned string `s`, if any */
+V7_PRIVATE void str_buf_mark(const char *s);
+
+/* Free unmarked buffers (or all of them, if `all` is non-zero) */
+V7_PRIVATE void str_buf_sweep(struct v7 *v7, int all);
+
+#endif /* V7_ENABLE_STR_BUILDER */
+
+/* FNV-1a hash of the given bytes */
+V7_PRIVATE uint32_t str_hash(const char *s, size_t len);
+
+/*
+ * Owned strings carry metadata between the length and the data, which is
+ * computed lazily: the hash of the string (as returned by `str_hash()`) and
+ * some flags. The metadata of new strings is zeroed, so code which fills
+ * a string created with `v7_mk_string(v7, NULL, len, 1)` must do so before
+ * the string is hashed.
+ */
+#if !V7_DISABLE_STR_META
+#define STR_META_SIZE 5 /* uint8_t flags, uint32_t hash */
+#else
+#define STR_META_SIZE 0
+#endif
+
+#define STR_META_VALID (1 << 0) /* metadata is computed */
+#define STR_META_ASCII (1 << 1) /* all the bytes are below 0x80 */
+
+/* Hash of a string value, cached for owned strings */
+V7_PRIVATE uint32_t str_val_hash(struct v7 *v7, val_t *v);
+
+/* Whether a string value consists of ASCII characters only */
+V7_PRIVATE int str_val_is_ascii(struct v7 *v7, val_t *v);
+
+/*
+ * Character positions.
+ *
+ * JS indexes strings by characters, which are UTF-8 sequences of varying
+ * length. ASCII strings are indexed directly. For long non-ASCII owned
+ * strings, the number of characters and the byte offsets of every
+ * `V7_STR_RUNE_STEP`-th of them are computed once and kept in a small
+ * per-instance cache, which is flushed when GC relocates strings. Shorter
+ * strings are just scanned.
+ */
+#ifndef V7_STR_RUNE_INDEX_MIN
+#define V7_STR_RUNE_INDEX_MIN 256
+#endif
+
+#define V7_STR_RUNE_STEP 64
+#define V7_STR_RUNE_CACHE_SIZE 4
+
+struct str_rune_index {
+  val_t s; /* V7_UNDEFINED for unused entry */
+  size_t runes;
+  size_t *offsets;
+};
+
+/* Number of characters in a string value */
+V7_PRIVATE size_t str_val_runes(struct v7 *v7, val_t *v);
+
+/*
+ * Returns the pointer to the character `idx` of a string value, or to the
+ * end of the string if there's no such character.
+ */
+V7_PRIVATE const char *str_val_rune_ptr(struct v7 *v7, val_t *v, size_t idx);
+
+/* Index of the character which starts at the byte offset `off` */
+V7_PRIVATE size_t str_val_rune_idx(struct v7 *v7, val_t *v, size_t off);
+
+/* Drop the cached character indices */
+V7_PRIVATE void str_rune_cache_flush(struct v7 *v7);
+
+/*
+ * Atoms.
+ *
+ * Owned strings which are used as property names are interned into a
+ * per-instance hash table, so that all property names with the same contents
+ * are the same `val_t`, and name comparison is a single equality check.
+ * Together with inlined and dictionary strings, which are canonical anyway,
+ * this means that only foreign property names have to be compared byte by
+ * byte.
+ *
+ * The table does not keep strings alive: entries whose strings were not
+ * marked are dropped by the GC, before owned strings are compacted.
+ */
+struct atom_slot {
+  uint32_t hash;
+  val_t s; /* V7_UNDEFINED for empty slot */
+};
+
+/*
+ * Returns the canonical property name with the given contents: the atom,
+ * the dictionary string, or `V7_UNDEFINED` if there's none. `len` should be
+ * larger than 5, since shorter strings are inlined.
+ */
+V7_PRIVATE val_t atom_find(struct v7 *v7, const char *s, size_t len,
+                           uint32_t hash);
+
+/*
+ * Returns the canonical version of the string `v`, interning it if needed.
+ * Doesn't allocate strings, so it never invokes GC.
+ */
+V7_PRIVATE val_t atom_intern(struct v7 *v7, val_t v);
+
+/* Like `v7_mk_string(v7, s, len, 1)`, but reuses the atom if there is one */
+V7_PRIVATE val_t atom_mk_string(struct v7 *v7, const char *s, size_t len);
+
+/* Drop unmarked atoms, and mark the slots of the live ones for relocation */
+V7_PRIVATE void atom_sweep(struct v7 *v7);
+
 /*
  * Convert a C string to to an unsigned integer.
  * `ok` will be set to true if the string conforms to
@@ -5710,6 +6030,7 @@ V7_PRIVATE unsigned long cstr_to_ulong(const char *s, size_t len, int *ok);
 enum embstr_flags {
   EMBSTR_ZERO_TERM = (1 << 0),
   EMBSTR_UNESCAPE = (1 << 1),
+  EMBSTR_META = (1 << 2), /* reserve zeroed `STR_META_SIZE` bytes */
 };
 
 V7_PRIVATE void embed_string(struct mbuf *m, size_t offset, const char *p,
@@ -5909,6 +6230,39 @@ V7_PRIVATE int v7_is_generic_object(v7_val_t v);
 
 V7_PRIVATE struct v7_property *v7_mk_property(struct v7 *v7);
 
+/*
+ * Objects having at least this many own properties get a hash index of
+ * property names, see `obj_prop_index_add()`.
+ */
+#ifndef V7_PROP_INDEX_MIN
+#define V7_PROP_INDEX_MIN 16
+#endif
+
+/*
+ * Returns address of the link to the first real property of the object, i.e.
+ * skips the hidden property index if the object has one. Code which walks and
+ * modifies property list directly should start from there.
+ */
+V7_PRIVATE struct v7_property **obj_prop_list(struct v7_object *o);
+
+/*
+ * Insert given property into the object's property index, if any. Property
+ * should be already linked into the list. Needed only by the code which
+ * manipulates property list directly; `def_property_v()` does that itself.
+ */
+V7_PRIVATE void obj_prop_index_add(struct v7 *v7, struct v7_object *o,
+                                   struct v7_property *p);
+
+/*
+ * Remove given property from the object's property index, if any. Must be
+ * called before the property is renamed or unlinked from the list.
+ */
+V7_PRIVATE void obj_prop_index_del(struct v7 *v7, struct v7_object *o,
+                                   struct v7_property *p);
+
+/* Free the index owned by the `_V7_PROPERTY_INDEX` property */
+V7_PRIVATE void obj_prop_index_free(struct v7 *v7, struct v7_property *p);
+
 V7_PRIVATE struct v7_property *v7_get_own_property2(struct v7 *v7, val_t obj,
                                                     const char *name,
                                                     size_t len,
@@ -5929,12 +6283,14 @@ V7_PRIVATE struct v7_property *v7_get_own_property(struct v7 *v7, val_t obj,
 V7_PRIVATE struct v7_property *v7_get_property(struct v7 *v7, val_t obj,
                                                const char *name, size_t len);
 
+#if V7_DISABLE_INLINE_CACHE
 /*
  * Just like `v7_get_property`, but takes name as a `v7_val_t`
  */
 V7_PRIVATE enum v7_err v7_get_property_v(struct v7 *v7, val_t obj,
                                          v7_val_t name,
                                          struct v7_property **res);
+#endif
 
 WARN_UNUSED_RESULT
 V7_PRIVATE enum v7_err v7_get_throwing_v(struct v7 *v7, v7_val_t obj,
@@ -6059,6 +6415,15 @@ V7_PRIVATE enum v7_err next_prop(struct v7 *v7, struct prop_iter_ctx *ctx,
                                  v7_val_t *name, v7_val_t *value,
                                  v7_prop_attr_t *attrs, int *ok);
 
+#if V7_ENABLE_DENSE_ARRAYS
+/*
+ * Fetches the next element of the dense array iterated with `ctx` into `p`,
+ * skipping holes. Returns 0 when there are no more elements.
+ */
+V7_PRIVATE int next_dense_element(struct v7 *v7, struct prop_iter_ctx *ctx,
+                                  struct v7_property *p);
+#endif
+
 /*
  * Set new prototype `proto` for the given object `obj`. Returns `0` at
  * success, `-1` at failure (it may fail if given `obj` is a function object:
@@ -6162,6 +6527,15 @@ enum v7_err v7_exec_buf(struct v7 *v7, const char *js_code, size_t len,
 WARN_UNUSED_RESULT
 enum v7_err v7_exec_file(struct v7 *v7, const char *path, v7_val_t *result);
 
+/*
+ * Executes the precompiled bcode image in `path`, written by `v7_compile()`
+ * with `use_bcode`. Where supported, the file is mapped in memory and
+ * executed in place. The image is unloaded once no function it defines is
+ * alive anymore.
+ */
+WARN_UNUSED_RESULT
+enum v7_err v7_load_image(struct v7 *v7, const char *path, v7_val_t *result);
+
 /*
  * Parse `str` and store corresponding JavaScript object in `res` variable.
  * String `str` should be '\0'-terminated.
@@ -6176,6 +6550,39 @@ enum v7_err v7_parse_json(struct v7 *v7, const char *str, v7_val_t *res);
 WARN_UNUSED_RESULT
 enum v7_err v7_parse_json_file(struct v7 *v7, const char *path, v7_val_t *res);
 
+/*
+ * Incremental JSON parser, for documents which arrive in pieces (e.g. from
+ * the network) or are too large to be kept in memory as a whole:
+ *
+ *    struct v7_json_parser *p = v7_json_parser_create(v7);
+ *    while (<more data>) {
+ *      if (v7_json_parser_feed(p, buf, len) != V7_OK) break;
+ *    }
+ *    rcode = v7_json_parser_end(p, &res);
+ *    v7_json_parser_destroy(p);
+ *
+ * Chunks may be split at arbitrary positions. Errors are reported as soon as
+ * they are detected: `v7_json_parser_feed()` and `v7_json_parser_end()`
+ * return `V7_SYNTAX_ERROR` and the exception is available via
+ * `v7_get_thrown_value()`.
+ */
+struct v7_json_parser;
+
+struct v7_json_parser *v7_json_parser_create(struct v7 *v7);
+
+WARN_UNUSED_RESULT
+enum v7_err v7_json_parser_feed(struct v7_json_parser *p, const char *buf,
+                                size_t len);
+
+/*
+ * Finishes parsing and stores the parsed value in `res`. If the document is
+ * incomplete, returns `V7_SYNTAX_ERROR`.
+ */
+WARN_UNUSED_RESULT
+enum v7_err v7_json_parser_end(struct v7_json_parser *p, v7_val_t *res);
+
+void v7_json_parser_destroy(struct v7_json_parser *p);
+
 #if !defined(V7_NO_COMPILER)
 
 /*
@@ -6338,6 +6745,56 @@ V7_PRIVATE v7_val_t v7_mk_dense_array(struct v7 *v7);
 V7_PRIVATE val_t
 v7_array_get2(struct v7 *v7, v7_val_t arr, unsigned long index, int *has);
 
+/*
+ * If `s` is a canonical array index (a decimal number below 2^32 - 1 without
+ * leading zeros), stores it to `res` and returns non-zero.
+ */
+V7_PRIVATE int cstr_to_array_index(const char *s, size_t len,
+                                   unsigned long *res);
+/* Same as `cstr_to_array_index()`, but for a number */
+V7_PRIVATE int num_to_array_index(double d, unsigned long *res);
+
+#if V7_ENABLE_DENSE_ARRAYS
+/*
+ * Returns the element vector of a dense array, or `NULL` if nothing was
+ * stored into the array yet. See `V7_OBJ_DENSE_ARRAY`.
+ */
+V7_PRIVATE struct mbuf *dense_array_buf(struct v7 *v7, v7_val_t arr);
+
+/*
+ * Returns whether a dense array of length `len` should stay dense when it
+ * gets extended to `new_len`.
+ */
+V7_PRIVATE int dense_array_can_grow(unsigned long len, unsigned long new_len);
+
+/*
+ * Must be called after storing `v` into the element vector directly: keeps
+ * track of whether the array holds only numbers, see `V7_OBJ_NUMBER_ELEMENTS`.
+ */
+V7_PRIVATE void dense_array_note_store(v7_val_t arr, v7_val_t v);
+
+/* Truncates or extends with holes a dense array */
+V7_PRIVATE void dense_array_set_length(struct v7 *v7, v7_val_t arr,
+                                       unsigned long new_len);
+
+/*
+ * Converts a dense array to an ordinary object with index-named properties.
+ * Does nothing if `arr` isn't a dense array. Defined in object.c.
+ */
+V7_PRIVATE void dense_array_to_sparse(struct v7 *v7, v7_val_t arr);
+
+/*
+ * Fast paths of `arr[name]` for the interpreter: if `arr` is a dense array and
+ * `name` is a number, read an existing element into `res`, or store `v` to an
+ * existing element or right after the last one. Return 0 if the generic
+ * property access has to be used instead.
+ */
+V7_PRIVATE int dense_array_get_fast(struct v7 *v7, v7_val_t arr, v7_val_t name,
+                                    v7_val_t *res);
+V7_PRIVATE int dense_array_set_fast(struct v7 *v7, v7_val_t arr, v7_val_t name,
+                                    v7_val_t v);
+#endif
+
 #if defined(__cplusplus)
 }
 #endif /* __cplusplus */
@@ -6418,6 +6875,32 @@ enum v7_err v7_stringify_throwing(struct v7 *v7, v7_val_t v, char *buf,
                                   size_t size, enum v7_stringify_mode mode,
                                   char **res);
 
+/*
+ * Output callback for `v7_stringify_to_callback()`: receives the next `len`
+ * bytes of the generated string. The data is not 0-terminated.
+ */
+typedef void (*v7_stringify_cb_t)(const char *data, size_t len,
+                                  void *user_data);
+
+/*
+ * Like `v7_stringify_throwing()`, but instead of collecting the whole string
+ * in memory, passes it to the callback `cb` in chunks as it's generated. Use
+ * it to write large values directly to a file or a socket.
+ *
+ * Example code:
+ *
+ *     static void write_cb(const char *data, size_t len, void *user_data) {
+ *       fwrite(data, 1, len, (FILE *) user_data);
+ *     }
+ *     ...
+ *     rcode = v7_stringify_to_callback(v7, obj, V7_STRINGIFY_JSON, write_cb,
+ *                                      stdout);
+ */
+WARN_UNUSED_RESULT
+enum v7_err v7_stringify_to_callback(struct v7 *v7, v7_val_t v,
+                                     enum v7_stringify_mode mode,
+                                     v7_stringify_cb_t cb, void *user_data);
+
 /*
  * A shortcut for `v7_stringify()` with `V7_STRINGIFY_JSON`
  */
@@ -6483,20 +6966,21 @@ extern "C" {
  *   `to_boolean_v()`.
  *
  * - If you want to get the JSON representation of a value, use
- *   `to_json_or_debug()`, passing `0` as `is_debug` : writes data to your C
- *   buffer;
+ *   `to_json_or_debug()`, passing `0` as `is_debug` : writes data to
+ *   `struct stringify_out`;
  *
  * - There is one more kind of representation: `DEBUG`. It's very similar to
  *   JSON, but it will not omit non-JSON values, such as functions. Again, use
  *   `to_json_or_debug()`, but pass `1` as `is_debug` this time: writes data to
- *   your C buffer;
+ *   `struct stringify_out`;
  *
  * Additionally, for any kind of to-string conversion into C buffer, you can
  * use a convenience wrapper function (mostly for public API), which can
  * allocate the buffer for you:
  *
  *   - `v7_stringify_throwing()`;
- *   - `v7_stringify()` : the same as above, but doesn't throw.
+ *   - `v7_stringify()` : the same as above, but doesn't throw;
+ *   - `v7_stringify_to_callback()` : passes the data to a callback in chunks.
  *
  * There are a couple of more specific conversions, which I'd like to probably
  * refactor or remove in the future:
@@ -6629,6 +7113,33 @@ V7_PRIVATE enum v7_err primitive_to_str(struct v7 *v7, val_t v, val_t *res,
 WARN_UNUSED_RESULT
 V7_PRIVATE enum v7_err primitive_to_number(struct v7 *v7, val_t v, val_t *res);
 
+/* Size of the chunks passed to the callback of `v7_stringify_to_callback()` */
+#ifndef V7_STRINGIFY_CHUNK_SIZE
+#define V7_STRINGIFY_CHUNK_SIZE 256
+#endif
+
+/*
+ * Output of the stringification functions. Data is appended to `buf`; when
+ * it's full, `buf` is either flushed to the callback `cb` (if set), or
+ * reallocated to a bigger heap buffer, so that the value is stringified in a
+ * single pass in both cases.
+ */
+struct stringify_out {
+  char *buf;         /* Initially provided by the caller */
+  size_t size;       /* Size of `buf` */
+  size_t len;        /* Number of bytes in `buf` */
+  uint8_t buf_owned; /* Whether `buf` was allocated by `stringify_out_append` */
+  v7_stringify_cb_t cb;
+  void *cb_data;
+};
+
+/*
+ * Append data to the output. Without a callback, the output is kept
+ * 0-terminated.
+ */
+V7_PRIVATE void stringify_out_append(struct stringify_out *out, const char *p,
+                                     size_t len);
+
 /*
  * Convert value to JSON or "debug" representation, depending on whether
  * `is_debug` is non-zero. The "debug" is the same as JSON, but non-JSON values
@@ -6637,8 +7148,8 @@ V7_PRIVATE enum v7_err primitive_to_number(struct v7 *v7, val_t v, val_t *res);
  * See also `v7_stringify()`, `v7_stringify_throwing()`.
  */
 WARN_UNUSED_RESULT
-V7_PRIVATE enum v7_err to_json_or_debug(struct v7 *v7, val_t v, char *buf,
-                                        size_t size, size_t *res_len,
+V7_PRIVATE enum v7_err to_json_or_debug(struct v7 *v7, val_t v,
+                                        struct stringify_out *out,
                                         uint8_t is_debug);
 
 /*
@@ -7066,6 +7577,10 @@ V7_PRIVATE void release_ast(struct v7 *v7, struct ast *a);
 #define CS_V7_SRC_BCODE_H_
 
 #define BIN_BCODE_SIGNATURE "V\007BCODE:"
+#define BIN_BCODE_IMAGE_SIGNATURE "V\007BIMG:"
+
+#define BCODE_IMAGE_VERSION 1
+#define BCODE_IMAGE_ENDIAN 0x01020304
 
 #if !defined(V7_NAMES_CNT_WIDTH)
 #define V7_NAMES_CNT_WIDTH 10
@@ -7101,6 +7616,60 @@ extern "C" {
 
 typedef uint32_t bcode_off_t;
 
+/*
+ * Precompiled bcode image, as written by `v7_compile()`:
+ *
+ *   BIN_BCODE_IMAGE_SIGNATURE
+ *   struct bcode_image_hdr
+ *   <function record> // the script, at `root`
+ *
+ * A function record is what `bcode_serialize_func()` writes: a few varints
+ * with the function metadata, followed by `ops`. All literals are inlined
+ * into `ops`, including nested functions, which are function records too.
+ * The image contains no pointers, so it can be executed in place wherever
+ * it's loaded or mapped. Numbers are in the native byte order, which is
+ * checked by `endian`.
+ *
+ * Images with `BIN_BCODE_SIGNATURE` instead (older ones) have no header, and
+ * the script record follows the signature.
+ */
+struct bcode_image_hdr {
+  uint32_t endian;  /* BCODE_IMAGE_ENDIAN */
+  uint32_t version; /* BCODE_IMAGE_VERSION */
+  uint32_t size;    /* Of the whole image, including the signature */
+  uint32_t root;    /* Offset of the script record */
+};
+
+/* Who owns the memory of an image, and how to free it */
+enum bcode_image_owner {
+  BCODE_IMAGE_FOREIGN,  /* The caller: it has to outlive the v7 instance */
+  BCODE_IMAGE_MALLOCED, /* Freed by `free()` */
+  BCODE_IMAGE_MAPPED    /* Unmapped by `munmap()` */
+};
+
+struct bcode_image_func {
+  bcode_off_t off; /* Offset of the function record in the image */
+  struct bcode *bcode;
+};
+
+/*
+ * Loaded image. Every bcode executed from it holds a reference; once the last
+ * one is freed, so is the image.
+ *
+ * Nested functions are deserialized when their literal is first evaluated,
+ * and the bcode is shared by all the instances of the function created
+ * afterwards. `funcs` is the index of the ones alive, sorted by offset.
+ */
+struct bcode_image {
+  const char *data;
+  size_t size;
+  enum bcode_image_owner owner;
+  unsigned int refcnt;
+  struct bcode_image_func *funcs;
+  size_t funcs_cnt;
+  size_t funcs_size;
+};
+
 /*
  * Each JS function will have one bcode structure
  * containing the instruction stream, a literal table, and function
@@ -7156,12 +7725,109 @@ struct bcode {
   /* Set when `ops` contains function name as the first `name` */
   unsigned int func_name_present : 1;
 
+  /*
+   * Set when arguments and local variables of the function are kept in the
+   * call frame slots, one per name, instead of a scope object. See
+   * `OP_GET_LOCAL`.
+   */
+  unsigned int uses_slots : 1;
+
+  /*
+   * Set when the function body may refer to the `arguments` object (directly
+   * or via `eval`); otherwise the object is not created on call.
+   */
+  unsigned int uses_arguments : 1;
+
 #if !V7_DISABLE_FILENAMES
   /* If set, `filename` points to ROM, so we shouldn't free it */
   unsigned int filename_in_rom : 1;
 #endif
+
+#if !V7_DISABLE_INLINE_CACHE
+  /* Allocated on first use, see `struct bcode_ic` */
+  struct bcode_ic *ic;
+#endif
+
+  /* Allocated on first use, see `struct bcode_lit_cache` */
+  struct bcode_lit_cache *lit_cache;
+
+  /* Image `ops` are in, if any; referenced by this bcode */
+  struct bcode_image *image;
+};
+
+/*
+ * Values made out of the names and the inline literals stored in `ops`:
+ *
+ * - Strings (`BCODE_INLINE_STRING_TYPE_TAG` and names): each of them is
+ *   created once, so that executing the same instruction or calling the same
+ *   function again doesn't allocate a new copy of the string (or leak one
+ *   into `foreign_strings`, if `ops` is in ROM).
+ * - Regexps (`BCODE_INLINE_REGEXP_TYPE_TAG`): the object created by the first
+ *   evaluation, whose compiled program is shared by the objects created
+ *   afterwards, see `regexp_clone()`.
+ *
+ * The values are appended to the literal table, so they are kept alive and
+ * relocated by GC. This is an open addressing hash table mapping the offset
+ * of the literal in `ops` to its index in the literal table.
+ */
+struct bcode_lit_cache_slot {
+  bcode_off_t off; /* offset in `ops` plus one, 0 for an empty slot */
+  uint32_t idx;
+};
+
+struct bcode_lit_cache {
+  uint32_t mask; /* number of slots - 1 */
+  uint32_t cnt;
+  struct bcode_lit_cache_slot slots[1]; /* `mask + 1` items */
+};
+
+#if !V7_DISABLE_INLINE_CACHE
+/*
+ * Inline cache of the property lookups done by `OP_GET`, `OP_SET`,
+ * `OP_GET_VAR`, `OP_SAFE_GET_VAR` and `OP_SET_VAR` instructions.
+ *
+ * It is a small set-associative table indexed by the instruction offset; each
+ * entry remembers the property found for some object at this instruction.
+ * There are two kinds of entries:
+ *
+ * - `proto == 0`: `obj` is the object which owns `prop`. Since property names
+ *   are unique, the entry stays valid until the property is deleted.
+ * - `proto == 1`: `obj` is the prototype of the receiver, and `prop` was found
+ *   somewhere up the chain starting at `obj`. The receiver's own properties
+ *   are checked on every hit, but it doesn't have to be the same object, so
+ *   e.g. per-call scope objects share cached lookups of global variables.
+ *
+ * We don't have object shapes, so instead of checking them, all the entries
+ * are invalidated at once by bumping `v7->ic_epoch` whenever a cached lookup
+ * might change its result: on GC (cells get reused), on property deletion, on
+ * prototype change, and on adding a property to an object which is a
+ * prototype of some other object (`V7_OBJ_PROTOTYPE`).
+ */
+struct bcode_ic_entry {
+  uint64_t epoch; /* `v7->ic_epoch` at the time of filling */
+  bcode_off_t off;
+  unsigned int proto : 1;
+  struct v7_object *obj;
+  struct v7_property *prop;
+  val_t name;
 };
 
+#define BCODE_IC_WAYS 2
+#define BCODE_IC_MAX_SETS 64
+
+struct bcode_ic {
+  uint32_t mask; /* number of sets - 1 */
+  unsigned long hits;
+  unsigned long misses;
+  struct bcode_ic_entry entries[1]; /* `(mask + 1) * BCODE_IC_WAYS` items */
+};
+
+/* Invalidate all inline caches, see `struct bcode_ic` */
+V7_PRIVATE void bcode_ic_invalidate(struct v7 *v7);
+#else
+#define bcode_ic_invalidate(v7) ((void) (v7))
+#endif
+
 /*
  * Bcode builder context: it contains mutable mbufs for opcodes and literals,
  * whereas the bcode itself contains just vectors (`struct v7_vec`).
@@ -7199,6 +7865,44 @@ V7_PRIVATE void bcode_free(struct v7 *v7, struct bcode *bcode);
 V7_PRIVATE void release_bcode(struct v7 *v7, struct bcode *bcode);
 V7_PRIVATE void retain_bcode(struct v7 *v7, struct bcode *bcode);
 
+#if !V7_DISABLE_BCODE_CACHE
+/*
+ * Cache of the compiled scripts, keyed by the source text, filename and the
+ * JSON flag. Enabled by `v7_create_opts::bcode_cache_size`.
+ */
+struct bcode_cache_entry {
+  struct bcode_cache_entry *next;
+  struct bcode *bcode; /* retained by the cache */
+  uint32_t hash;
+  uint8_t is_json;
+  size_t src_len;
+  char *src; /* copy of the source, followed by the filename, if any */
+  size_t filename_len;
+  size_t size; /* accounted in `v7->bcode_cache_bytes` */
+};
+
+/*
+ * Looks up the bcode compiled from the given source; returns NULL if there
+ * is none. The returned bcode is not retained.
+ */
+V7_PRIVATE struct bcode *bcode_cache_find(struct v7 *v7, const char *src,
+                                          size_t src_len, const char *filename,
+                                          uint8_t is_json);
+
+#if !defined(V7_NO_COMPILER)
+/*
+ * Adds the bcode compiled from the given source to the cache, evicting the
+ * least recently used entry if the cache is full.
+ */
+V7_PRIVATE void bcode_cache_add(struct v7 *v7, const char *src, size_t src_len,
+                                const char *filename, uint8_t is_json,
+                                struct bcode *bcode);
+#endif
+
+/* Releases all the cached bcodes */
+V7_PRIVATE void bcode_cache_free(struct v7 *v7);
+#endif
+
 #if !V7_DISABLE_FILENAMES
 /*
  * Return a pointer to null-terminated filename string
@@ -7227,8 +7931,21 @@ V7_PRIVATE void bcode_copy_filename_from(struct bcode *dst, struct bcode *src);
 /*V7_PRIVATE*/ void bcode_serialize(struct v7 *v7, struct bcode *bcode,
                                     FILE *f);
 
-V7_PRIVATE void bcode_deserialize(struct v7 *v7, struct bcode *bcode,
-                                  const char *data);
+/* Returns whether `len` bytes at `data` start with an image signature */
+V7_PRIVATE int bcode_is_image(const char *data, size_t len);
+
+/*
+ * Makes `bcode` the script of the image at `data`, to be executed in place.
+ * On success, the memory belongs to the image: see `enum bcode_image_owner`.
+ */
+WARN_UNUSED_RESULT
+V7_PRIVATE enum v7_err bcode_image_load(struct v7 *v7, struct bcode *bcode,
+                                        const char *data, size_t len,
+                                        enum bcode_image_owner owner);
+
+/* Frees the memory of an image as its `owner` says */
+V7_PRIVATE void bcode_image_free_data(const char *data, size_t len,
+                                      enum bcode_image_owner owner);
 
 #ifdef V7_BCODE_DUMP
 V7_PRIVATE void dump_bcode(struct v7 *v7, FILE *, struct bcode *);
@@ -7367,6 +8084,29 @@ V7_PRIVATE bcode_off_t bcode_add_target(struct bcode_builder *bbuilder);
 /*V7_PRIVATE*/ void bcode_patch_target(struct bcode_builder *bbuilder,
                                        bcode_off_t label, bcode_off_t target);
 
+/* Kinds of keys `OP_SWITCH` dispatches on */
+enum bcode_switch_mode {
+  BCODE_SWITCH_STR,
+  BCODE_SWITCH_INT,
+};
+
+/*
+ * `OP_SWITCH` is followed by a mode byte (`enum bcode_switch_mode`), a varint
+ * mask of the hash table size, the default target and `mask + 1` slots of
+ * this structure, probed linearly starting from `key & mask`.
+ *
+ * For strings, `key` is `str_hash()` of the case label, and `lit` points to
+ * an `OP_PUSH_LIT` emitted after the table, whose literal is the label to
+ * compare with. For integers, `key` is the label itself.
+ *
+ * Empty slots have zero `target`.
+ */
+struct bcode_switch_slot {
+  uint32_t key;
+  bcode_off_t target;
+  bcode_off_t lit;
+};
+
 V7_PRIVATE void bcode_add_varint(struct bcode_builder *bbuilder, size_t value);
 /*
  * Reads varint-encoded integer from the provided pointer, and adjusts
@@ -7386,6 +8126,11 @@ V7_PRIVATE void dump_op(struct v7 *v7, FILE *f, struct bcode *bcode,
                         char **ops);
 #endif
 
+#if V7_ENABLE_PROFILER
+/* Returns the mnemonic of the opcode, as printed by `dump_op()` */
+V7_PRIVATE const char *opcode_name(uint8_t op);
+#endif
+
 #if defined(__cplusplus)
 }
 #endif /* __cplusplus */
@@ -7434,11 +8179,26 @@ enum v7_heap_stat_what {
   V7_HEAP_STAT_BCODE_LIT_TOTAL_SIZE,
   V7_HEAP_STAT_BCODE_LIT_DESER_SIZE,
   V7_HEAP_STAT_FUNC_OWNED,
-  V7_HEAP_STAT_FUNC_OWNED_MAX
+  V7_HEAP_STAT_FUNC_OWNED_MAX,
+  V7_HEAP_STAT_IC_HITS,
+  V7_HEAP_STAT_IC_MISSES,
+  V7_HEAP_STAT_BCODE_CACHE_HITS,
+  V7_HEAP_STAT_BCODE_CACHE_MISSES,
+  V7_HEAP_STAT_BCODE_CACHE_BYTES,
+  V7_HEAP_STAT_GC_COUNT
 };
 
 /* Returns a given heap statistics */
 int v7_heap_stat(struct v7 *v7, enum v7_heap_stat_what what);
+
+/*
+ * Returns inline cache statistics of the given JS function: number of
+ * property lookups served by the cache (`hits`) and the ones which had to
+ * walk the property lists (`misses`). Returns 0 on success, or -1 if `func`
+ * is not a JS function.
+ */
+int v7_func_ic_stat(struct v7 *v7, v7_val_t func, unsigned long *hits,
+                    unsigned long *misses);
 #endif
 
 /*
@@ -7447,6 +8207,17 @@ int v7_heap_stat(struct v7 *v7, enum v7_heap_stat_what what);
  */
 void v7_gc(struct v7 *v7, int full);
 
+/*
+ * Collections triggered by allocations only mark the live cells, and leave
+ * the garbage to be swept lazily, a few blocks at a time, when the arenas run
+ * out of free cells. This function performs a step of that pending sweep,
+ * visiting about `max_cells` cells at most, so that the host can get it done
+ * in between I/O. Returns non-zero if some sweeping is still pending.
+ *
+ * `v7_gc()` always sweeps the whole heap before returning.
+ */
+int v7_gc_step(struct v7 *v7, size_t max_cells);
+
 #if defined(__cplusplus)
 }
 #endif /* __cplusplus */
@@ -7469,20 +8240,20 @@ void v7_gc(struct v7 *v7, int full);
 /* Amalgamated: #include "v7/src/core.h" */
 
 /*
- * Macros for marking reachable things: use bit 0.
+ * Macros for marking reachable things: use bit 0 of the cell flags.
  */
-#define MARK(p) (((struct gc_cell *) (p))->head.word |= 1)
-#define UNMARK(p) (((struct gc_cell *) (p))->head.word &= ~1)
-#define MARKED(p) (((struct gc_cell *) (p))->head.word & 1)
+#define MARK(p) (((struct gc_cell *) (p))->flags |= 1)
+#define UNMARK(p) (((struct gc_cell *) (p))->flags &= ~1)
+#define MARKED(p) (((struct gc_cell *) (p))->flags & 1)
 
 /*
  * Similar to `MARK()` / `UNMARK()` / `MARKED()`, but `.._FREE` counterparts
  * are intended to mark free cells (as opposed to used ones), so they use
- * bit 1.
+ * bit 1. Cells on the free list always have it set.
  */
-#define MARK_FREE(p) (((struct gc_cell *) (p))->head.word |= 2)
-#define UNMARK_FREE(p) (((struct gc_cell *) (p))->head.word &= ~2)
-#define MARKED_FREE(p) (((struct gc_cell *) (p))->head.word & 2)
+#define MARK_FREE(p) (((struct gc_cell *) (p))->flags |= 2)
+#define UNMARK_FREE(p) (((struct gc_cell *) (p))->flags &= ~2)
+#define MARKED_FREE(p) (((struct gc_cell *) (p))->flags & 2)
 
 /*
  * performs arithmetics on gc_cell pointers as if they were arena->cell_size
@@ -7496,11 +8267,17 @@ struct gc_tmp_frame {
   size_t pos;
 };
 
+/*
+ * Every structure managed by the GC starts with a pointer, followed by a byte
+ * of GC flags. The flags are kept out of the pointer so that live cells can
+ * stay marked while the mutator runs, until the lazy sweep gets to them.
+ */
 struct gc_cell {
   union {
     struct gc_cell *link;
     uintptr_t word;
   } head;
+  uint8_t flags;
 };
 
 #if defined(__cplusplus)
@@ -7512,11 +8289,12 @@ V7_PRIVATE struct v7_property *new_property(struct v7 *);
 V7_PRIVATE struct v7_js_function *new_function(struct v7 *);
 
 V7_PRIVATE void gc_mark(struct v7 *, val_t);
+void gc_mark_string(struct v7 *, val_t *);
 
 V7_PRIVATE void gc_arena_init(struct gc_arena *, size_t, size_t, size_t,
                               const char *);
 V7_PRIVATE void gc_arena_destroy(struct v7 *, struct gc_arena *a);
-V7_PRIVATE void gc_sweep(struct v7 *, struct gc_arena *, size_t);
+V7_PRIVATE void gc_sweep(struct v7 *, struct gc_arena *);
 V7_PRIVATE void *gc_alloc_cell(struct v7 *, struct gc_arena *);
 
 V7_PRIVATE struct gc_tmp_frame new_tmp_frame(struct v7 *);
@@ -7626,6 +8404,34 @@ V7_PRIVATE struct v7_regexp *v7_get_regexp_struct(struct v7 *, v7_val_t);
  */
 V7_PRIVATE size_t
 get_regexp_flags_str(struct v7 *v7, struct v7_regexp *rp, char *buf);
+
+/* Number of compiled regexps kept by the cache; 0 disables the cache */
+#ifndef V7_REGEXP_CACHE_SIZE
+#define V7_REGEXP_CACHE_SIZE 16
+#endif
+
+/*
+ * Compiled regexp program, shared by all the `RegExp` objects created with
+ * the same source and flags while the entry stays in the cache. Entries are
+ * kept in `v7->regexp_cache`, most recently used first.
+ */
+struct regexp_cache_entry {
+  struct regexp_cache_entry *next;
+  struct slre_prog *prog; /* retained by the cache */
+  uint32_t hash;
+  size_t src_len;
+  size_t flags_len;
+  char src[1]; /* source followed by flags */
+};
+
+V7_PRIVATE void regexp_cache_free(struct v7 *v7);
+
+/*
+ * Returns a new `RegExp` object with the source and the compiled program of
+ * the given one. Used to create a fresh object on each evaluation of a regexp
+ * literal without compiling it again.
+ */
+V7_PRIVATE v7_val_t regexp_clone(struct v7 *v7, v7_val_t re);
 #endif /* V7_ENABLE__RegExp */
 
 #endif /* CS_V7_SRC_REGEXP_H_ */
@@ -7807,6 +8613,11 @@ void v7_fprint(FILE *f, struct v7 *v7, v7_val_t v);
  * V7_STRINGIFY_DEBUG mode is used. */
 void v7_fprintln(FILE *f, struct v7 *v7, v7_val_t v);
 
+/* Output JSON representation of the value to a file, without building it in
+ * memory first. See `v7_stringify_to_callback()`. */
+WARN_UNUSED_RESULT
+enum v7_err v7_fprint_json(FILE *f, struct v7 *v7, v7_val_t v);
+
 /* Output stack trace recorded in the exception `e` to file `f` */
 void v7_fprint_stack_trace(FILE *f, struct v7 *v7, v7_val_t e);
 
@@ -7975,6 +8786,11 @@ V7_PRIVATE enum v7_err b_apply(struct v7 *v7, v7_val_t func, v7_val_t this_obj,
                                v7_val_t args, uint8_t is_constructor,
                                v7_val_t *res);
 
+/*
+ * Executes the source or precompiled code `src`, or calls `func`. `fr` tells
+ * whether `src` should be disposed of afterwards: it's one of `enum
+ * bcode_image_owner`, and can only be `BCODE_IMAGE_MAPPED` for an image.
+ */
 WARN_UNUSED_RESULT
 V7_PRIVATE enum v7_err b_exec(struct v7 *v7, const char *src, size_t src_len,
                               const char *filename, val_t func, val_t args,
@@ -8090,6 +8906,147 @@ void v7_stack_stat_clean(struct v7 *v7);
 
 #endif /* CS_V7_SRC_CYG_PROFILE_H_ */
 #ifdef V7_MODULE_LINES
+#line 1 "v7/src/profiler_public.h"
+#endif
+/*
+ * Copyright (c) 2014 Cesanta Software Limited
+ * All rights reserved
+ */
+
+/*
+ * === Bcode profiler
+ */
+
+#ifndef CS_V7_SRC_PROFILER_PUBLIC_H_
+#define CS_V7_SRC_PROFILER_PUBLIC_H_
+
+/* Amalgamated: #include "v7/src/core_public.h" */
+
+#if V7_ENABLE_PROFILER
+
+#include <stdio.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Starts profiling the bcode executed by the given instance: every
+ * `period`-th executed instruction is sampled and attributed, together with
+ * the wall time elapsed since the previous sample, to its filename, line
+ * number and opcode, as well as to the current JS call stack. A `period` of 1
+ * (or 0) counts every instruction.
+ *
+ * Data collected by a previous run is discarded.
+ */
+void v7_prof_start(struct v7 *v7, unsigned int period);
+
+/*
+ * Stops profiling. Collected data is kept until the next `v7_prof_start()`
+ * or `v7_destroy()`, so it can be dumped later.
+ */
+void v7_prof_stop(struct v7 *v7);
+
+/*
+ * Writes a flat profile to `fp`: one line per (file, line, opcode) with the
+ * number of instructions and the wall time attributed to it, most executed
+ * first.
+ */
+void v7_prof_dump(struct v7 *v7, FILE *fp);
+
+/*
+ * Writes sampled call stacks to `fp` in the "folded" format consumed by
+ * flame graph tools: one line per distinct stack, frames separated by `;`
+ * from the outermost, followed by the instruction count.
+ */
+void v7_prof_dump_folded(struct v7 *v7, FILE *fp);
+
+#if defined(__cplusplus)
+}
+#endif /* __cplusplus */
+
+#endif /* V7_ENABLE_PROFILER */
+
+#endif /* CS_V7_SRC_PROFILER_PUBLIC_H_ */
+#ifdef V7_MODULE_LINES
+#line 1 "v7/src/profiler.h"
+#endif
+/*
+ * Copyright (c) 2014 Cesanta Software Limited
+ * All rights reserved
+ */
+
+#ifndef CS_V7_SRC_PROFILER_H_
+#define CS_V7_SRC_PROFILER_H_
+
+/* Amalgamated: #include "v7/src/profiler_public.h" */
+/* Amalgamated: #include "v7/src/internal.h" */
+/* Amalgamated: #include "v7/src/bcode.h" */
+
+#if V7_ENABLE_PROFILER
+
+/* Profile entry of a single (file, line, opcode) */
+struct prof_site {
+  struct prof_site *next;
+  const char *filename;
+  unsigned long count;
+  double usec;
+  uint16_t line_no;
+  uint8_t op;
+};
+
+/* Profile entry of a single call stack, see `v7_prof_dump_folded()` */
+struct prof_stack {
+  struct prof_stack *next;
+  unsigned long count;
+  size_t hash;
+  char stack[1]; /* null-terminated, allocated along with the struct */
+};
+
+#define PROF_HASH_SIZE 1024
+
+struct prof {
+  /* Instructions left until the next sample */
+  unsigned int countdown;
+  unsigned int period;
+  unsigned int running : 1;
+
+  struct prof_site *sites[PROF_HASH_SIZE];
+  struct prof_stack *stacks[PROF_HASH_SIZE];
+
+  /* Filenames referenced by the sites; retained `struct shdata` pointers */
+  struct mbuf files;
+  const void *last_file_key;
+  const char *last_file;
+
+  /* Scratch buffer the current call stack is printed into */
+  struct mbuf stack_buf;
+
+  /* Site of the previous sample, which gets the time elapsed since then */
+  struct prof_site *last_site;
+  double last_time;
+};
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Records a sample of the instruction `op` which is about to be executed in
+ * `bcode`. Called by `eval_bcode()` once `countdown` drops to zero.
+ */
+V7_PRIVATE void prof_sample(struct v7 *v7, struct bcode *bcode, uint8_t op);
+
+V7_PRIVATE void prof_free(struct v7 *v7);
+
+#if defined(__cplusplus)
+}
+#endif /* __cplusplus */
+
+#endif /* V7_ENABLE_PROFILER */
+
+#endif /* CS_V7_SRC_PROFILER_H_ */
+#ifdef V7_MODULE_LINES
 #line 1 "v7/builtin/builtin.h"
 #endif
 /*
@@ -8316,6 +9273,13 @@ int slre_compile(const char *regexp, size_t regexp_len, const char *flags,
                  size_t flags_len, struct slre_prog **, int is_regex);
 int slre_exec(struct slre_prog *prog, int flag_g, const char *start,
               const char *end, struct slre_loot *loot);
+
+/*
+ * Compiled programs are reference counted: `slre_retain()` takes one more
+ * reference, and `slre_free()` drops one, freeing the program with the last
+ * one. A program returned by `slre_compile()` has a single reference.
+ */
+struct slre_prog *slre_retain(struct slre_prog *prog);
 void slre_free(struct slre_prog *prog);
 
 int slre_match(const char *, size_t, const char *, size_t, const char *, size_t,
@@ -8599,6 +9563,14 @@ extern "C" {
 
 V7_PRIVATE void init_json(struct v7 *v7);
 
+/*
+ * Parses JSON text `buf` of length `len` into `res`. On error, returns
+ * `V7_SYNTAX_ERROR` and leaves the exception thrown.
+ */
+WARN_UNUSED_RESULT
+V7_PRIVATE enum v7_err json_parse(struct v7 *v7, const char *buf, size_t len,
+                                  v7_val_t *res);
+
 #if defined(__cplusplus)
 }
 #endif /* __cplusplus */
@@ -12307,6 +13279,42 @@ V7_PRIVATE enum v7_err File_obj_write(struct v7 *v7, v7_val_t *res) {
   return rcode;
 }
 
+struct f_json_ctx {
+  FILE *fp;
+  size_t sent;
+};
+
+static void f_json_cb(const char *data, size_t len, void *user_data) {
+  struct f_json_ctx *ctx = (struct f_json_ctx *) user_data;
+  ctx->sent += fwrite(data, 1, len, ctx->fp);
+}
+
+/*
+ * Writes JSON representation of the argument to the file, in chunks as it's
+ * generated. Returns number of bytes written.
+ */
+WARN_UNUSED_RESULT
+V7_PRIVATE enum v7_err File_obj_writeJSON(struct v7 *v7, v7_val_t *res) {
+  enum v7_err rcode = V7_OK;
+  v7_val_t this_obj = v7_get_this(v7);
+  v7_val_t arg0 = v7_get(v7, this_obj, s_fd_prop, sizeof(s_fd_prop) - 1);
+  struct f_json_ctx ctx = {NULL, 0};
+
+  if (v7_is_file_type(arg0)) {
+    ctx.fp = v7_val_to_file(v7, arg0);
+    rcode = v7_stringify_to_callback(v7, v7_arg(v7, 0), V7_STRINGIFY_JSON,
+                                     f_json_cb, &ctx);
+    if (rcode != V7_OK) {
+      goto clean;
+    }
+  }
+
+  *res = v7_mk_number(v7, ctx.sent);
+
+clean:
+  return rcode;
+}
+
 WARN_UNUSED_RESULT
 V7_PRIVATE enum v7_err File_obj_close(struct v7 *v7, v7_val_t *res) {
   enum v7_err rcode = V7_OK;
@@ -12530,6 +13538,7 @@ void init_file(struct v7 *v7) {
   v7_set_method(v7, file_proto, "close", File_obj_close);
   v7_set_method(v7, file_proto, "read", File_obj_read);
   v7_set_method(v7, file_proto, "write", File_obj_write);
+  v7_set_method(v7, file_proto, "writeJSON", File_obj_writeJSON);
 
 #if V7_ENABLE__File__require
   v7_def(v7, v7_get_global(v7), "_modcache", ~0, 0, v7_mk_object(v7));
@@ -12794,6 +13803,56 @@ V7_PRIVATE enum v7_err Socket_send(struct v7 *v7, v7_val_t *res) {
   return rcode;
 }
 
+struct s_json_ctx {
+  sock_t sock;
+  size_t sent;
+  int failed;
+};
+
+static void s_json_cb(const char *data, size_t len, void *user_data) {
+  struct s_json_ctx *ctx = (struct s_json_ctx *) user_data;
+  size_t sent = 0;
+  int n;
+
+  /* Once sending has failed, drop the rest of the output */
+  while (!ctx->failed && sent < len) {
+    n = send(ctx->sock, data + sent, len - sent, 0);
+    if (n <= 0) {
+      ctx->failed = 1;
+    } else {
+      sent += n;
+    }
+  }
+  ctx->sent += sent;
+}
+
+/*
+ * Sends JSON representation of the argument, in chunks as it's generated.
+ * Returns number of bytes sent, or -1 if sending failed.
+ */
+WARN_UNUSED_RESULT
+V7_PRIVATE enum v7_err Socket_sendJSON(struct v7 *v7, v7_val_t *res) {
+  enum v7_err rcode = V7_OK;
+  v7_val_t this_obj = v7_get_this(v7);
+  v7_val_t prop = v7_get(v7, this_obj, s_sock_prop, sizeof(s_sock_prop) - 1);
+  struct s_json_ctx ctx;
+
+  memset(&ctx, 0, sizeof(ctx));
+  if (v7_is_number(prop)) {
+    ctx.sock = (sock_t) v7_get_double(v7, prop);
+    rcode = v7_stringify_to_callback(v7, v7_arg(v7, 0), V7_STRINGIFY_JSON,
+                                     s_json_cb, &ctx);
+    if (rcode != V7_OK) {
+      goto clean;
+    }
+  }
+
+  *res = ctx.failed ? v7_mk_number(v7, -1) : v7_mk_number(v7, ctx.sent);
+
+clean:
+  return rcode;
+}
+
 void init_socket(struct v7 *v7) {
   v7_val_t socket_obj = v7_mk_object(v7), sock_proto = v7_mk_object(v7);
 
@@ -12806,6 +13865,7 @@ void init_socket(struct v7 *v7) {
 
   v7_set_method(v7, sock_proto, "accept", Socket_accept);
   v7_set_method(v7, sock_proto, "send", Socket_send);
+  v7_set_method(v7, sock_proto, "sendJSON", Socket_sendJSON);
   v7_set_method(v7, sock_proto, "recv", Socket_recv);
   v7_set_method(v7, sock_proto, "recvAll", Socket_recvAll);
   v7_set_method(v7, sock_proto, "close", Socket_close);
@@ -14555,7 +15615,8 @@ V7_PRIVATE void release_ast(struct v7 *v7, struct ast *a) {
 #include <sys/mman.h>
 #endif
 
-#if defined(V7_BCODE_DUMP) || defined(V7_BCODE_TRACE)
+#if defined(V7_BCODE_DUMP) || defined(V7_BCODE_TRACE) || \
+    V7_ENABLE_PROFILER
 /* clang-format off */
 static const char *op_names[] = {
   "DROP",
@@ -14631,6 +15692,9 @@ static const char *op_names[] = {
   "CONTINUE",
   "ENTER_CATCH",
   "EXIT_CATCH",
+  "GET_LOCAL",
+  "SET_LOCAL",
+  "SWITCH",
 };
 /* clang-format on */
 
@@ -14638,6 +15702,12 @@ V7_STATIC_ASSERT(OP_MAX == ARRAY_SIZE(op_names), bad_op_names);
 V7_STATIC_ASSERT(OP_MAX <= _OP_LINE_NO, bad_OP_LINE_NO);
 #endif
 
+#if V7_ENABLE_PROFILER
+V7_PRIVATE const char *opcode_name(uint8_t op) {
+  return op < OP_MAX ? op_names[op] : "?";
+}
+#endif
+
 static void bcode_serialize_func(struct v7 *v7, struct bcode *bcode, FILE *out);
 
 static size_t bcode_ops_append(struct bcode_builder *bbuilder, const void *buf,
@@ -14706,6 +15776,23 @@ V7_PRIVATE void dump_op(struct v7 *v7, FILE *f, struct bcode *bcode,
       v7_fprint(f, v7, ((val_t *) bcode->lit.p)[idx]);
       break;
     }
+    case OP_GET_LOCAL:
+    case OP_SET_LOCAL:
+      fprintf(f, "(%lu)", (unsigned long) bcode_get_varint(&p));
+      break;
+    case OP_SWITCH: {
+      bcode_off_t target;
+      size_t mask;
+      p++;
+      fprintf(f, "(%s", *p == BCODE_SWITCH_STR ? "str" : "int");
+      mask = bcode_get_varint(&p);
+      p++;
+      memcpy(&target, p, sizeof(target));
+      fprintf(f, ", %lu, default %lu)", (unsigned long) mask + 1,
+              (unsigned long) target);
+      p += sizeof(target) + (mask + 1) * sizeof(struct bcode_switch_slot) - 1;
+      break;
+    }
     case OP_CALL:
     case OP_NEW:
       p++;
@@ -14745,6 +15832,63 @@ V7_PRIVATE void dump_bcode(struct v7 *v7, FILE *f, struct bcode *bcode) {
 }
 #endif
 
+V7_PRIVATE void bcode_image_free_data(const char *data, size_t len,
+                                      enum bcode_image_owner owner) {
+  switch (owner) {
+    case BCODE_IMAGE_FOREIGN:
+      break;
+    case BCODE_IMAGE_MALLOCED:
+      free((void *) data);
+      break;
+    case BCODE_IMAGE_MAPPED:
+#if CS_PLATFORM == CS_P_UNIX
+      munmap((void *) data, len);
+#endif
+      break;
+  }
+  (void) len;
+}
+
+static void bcode_image_release(struct bcode_image *img) {
+  assert(img->refcnt > 0);
+  if (--img->refcnt == 0) {
+    assert(img->funcs_cnt == 0);
+    bcode_image_free_data(img->data, img->size, img->owner);
+    free(img->funcs);
+    free(img);
+  }
+}
+
+/*
+ * Returns the index in `img->funcs` of the function at `off`, or where it
+ * should be inserted
+ */
+static size_t bcode_image_func_idx(struct bcode_image *img, bcode_off_t off) {
+  size_t lo = 0, hi = img->funcs_cnt, mid;
+  while (lo < hi) {
+    mid = (lo + hi) / 2;
+    if (img->funcs[mid].off < off) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+/* Removes the freed `bcode` from the index of its image, if it's there */
+static void bcode_image_forget(struct bcode_image *img, struct bcode *bcode) {
+  size_t i;
+  for (i = 0; i < img->funcs_cnt; i++) {
+    if (img->funcs[i].bcode == bcode) {
+      img->funcs_cnt--;
+      memmove(&img->funcs[i], &img->funcs[i + 1],
+              (img->funcs_cnt - i) * sizeof(img->funcs[0]));
+      break;
+    }
+  }
+}
+
 V7_PRIVATE void bcode_init(struct bcode *bcode, uint8_t strict_mode,
                            void *filename, uint8_t filename_in_rom) {
   memset(bcode, 0x00, sizeof(*bcode));
@@ -14788,9 +15932,29 @@ V7_PRIVATE void bcode_free(struct v7 *v7, struct bcode *bcode) {
   }
 #endif
 
+#if !V7_DISABLE_INLINE_CACHE
+  free(bcode->ic);
+  bcode->ic = NULL;
+#endif
+
+  free(bcode->lit_cache);
+  bcode->lit_cache = NULL;
+
+  if (bcode->image != NULL) {
+    bcode_image_forget(bcode->image, bcode);
+    bcode_image_release(bcode->image);
+    bcode->image = NULL;
+  }
+
   bcode->refcnt = 0;
 }
 
+#if !V7_DISABLE_INLINE_CACHE
+V7_PRIVATE void bcode_ic_invalidate(struct v7 *v7) {
+  v7->ic_epoch++;
+}
+#endif
+
 V7_PRIVATE void retain_bcode(struct v7 *v7, struct bcode *b) {
   (void) v7;
   if (!b->frozen) {
@@ -14811,6 +15975,125 @@ V7_PRIVATE void release_bcode(struct v7 *v7, struct bcode *b) {
   }
 }
 
+#if !V7_DISABLE_BCODE_CACHE
+/* FNV-1a over the source and the filename */
+static uint32_t bcode_cache_hash(const char *src, size_t src_len,
+                                 const char *filename, size_t filename_len,
+                                 uint8_t is_json) {
+  uint32_t h = 2166136261u ^ is_json;
+  size_t i;
+  for (i = 0; i < src_len; i++) {
+    h = (h ^ (uint8_t) src[i]) * 16777619u;
+  }
+  for (i = 0; i < filename_len; i++) {
+    h = (h ^ (uint8_t) filename[i]) * 16777619u;
+  }
+  return h;
+}
+
+static void bcode_cache_entry_free(struct v7 *v7, struct bcode_cache_entry *e) {
+#if V7_ENABLE__Memory__stats
+  v7->bcode_cache_bytes -= e->size;
+#endif
+  release_bcode(v7, e->bcode);
+  free(e->src);
+  free(e);
+  v7->bcode_cache_cnt--;
+}
+
+V7_PRIVATE struct bcode *bcode_cache_find(struct v7 *v7, const char *src,
+                                          size_t src_len, const char *filename,
+                                          uint8_t is_json) {
+  size_t filename_len = filename != NULL ? strlen(filename) : 0;
+  uint32_t hash =
+      bcode_cache_hash(src, src_len, filename, filename_len, is_json);
+  struct bcode_cache_entry **pe, *e;
+
+  for (pe = &v7->bcode_cache; (e = *pe) != NULL; pe = &e->next) {
+    if (e->hash == hash && e->is_json == is_json && e->src_len == src_len &&
+        e->filename_len == filename_len &&
+        memcmp(e->src, src, src_len) == 0 &&
+        (filename_len == 0 ||
+         memcmp(e->src + src_len, filename, filename_len) == 0)) {
+      /* move to front */
+      *pe = e->next;
+      e->next = v7->bcode_cache;
+      v7->bcode_cache = e;
+#if V7_ENABLE__Memory__stats
+      v7->bcode_cache_hits++;
+#endif
+      return e->bcode;
+    }
+  }
+
+#if V7_ENABLE__Memory__stats
+  v7->bcode_cache_misses++;
+#endif
+  return NULL;
+}
+
+#if !defined(V7_NO_COMPILER)
+#if V7_ENABLE__Memory__stats
+static size_t bcode_cache_entry_size(struct bcode_cache_entry *e) {
+  return sizeof(*e) + e->src_len + e->filename_len + e->bcode->ops.len +
+         e->bcode->lit.len;
+}
+#endif
+
+V7_PRIVATE void bcode_cache_add(struct v7 *v7, const char *src, size_t src_len,
+                                const char *filename, uint8_t is_json,
+                                struct bcode *bcode) {
+  size_t filename_len = filename != NULL ? strlen(filename) : 0;
+  struct bcode_cache_entry *e, **pe;
+
+  e = (struct bcode_cache_entry *) calloc(1, sizeof(*e));
+  if (e == NULL) return;
+  /* never zero-sized, so that `e->src` of an empty script isn't NULL */
+  e->src = (char *) malloc(src_len + filename_len + 1);
+  if (e->src == NULL) {
+    free(e);
+    return;
+  }
+  memcpy(e->src, src, src_len);
+  if (filename_len > 0) {
+    memcpy(e->src + src_len, filename, filename_len);
+  }
+  e->src_len = src_len;
+  e->filename_len = filename_len;
+  e->is_json = is_json;
+  e->hash = bcode_cache_hash(src, src_len, filename, filename_len, is_json);
+  e->bcode = bcode;
+  retain_bcode(v7, bcode);
+
+  e->next = v7->bcode_cache;
+  v7->bcode_cache = e;
+  v7->bcode_cache_cnt++;
+#if V7_ENABLE__Memory__stats
+  /* the literal table grows as strings get materialized, see `bcode_str()` */
+  e->size = bcode_cache_entry_size(e);
+  v7->bcode_cache_bytes += e->size;
+#endif
+
+  /* evict the least recently used entry */
+  if (v7->bcode_cache_cnt > v7->bcode_cache_max) {
+    for (pe = &v7->bcode_cache; (*pe)->next != NULL; pe = &(*pe)->next) {
+    }
+    e = *pe;
+    *pe = NULL;
+    bcode_cache_entry_free(v7, e);
+  }
+}
+#endif
+
+V7_PRIVATE void bcode_cache_free(struct v7 *v7) {
+  struct bcode_cache_entry *e;
+  while ((e = v7->bcode_cache) != NULL) {
+    v7->bcode_cache = e->next;
+    bcode_cache_entry_free(v7, e);
+  }
+}
+#endif
+
 #if !V7_DISABLE_FILENAMES
 V7_PRIVATE const char *bcode_get_filename(struct bcode *bcode) {
   const char *ret = NULL;
@@ -14942,6 +16225,186 @@ V7_PRIVATE v7_val_t bcode_get_lit(struct bcode *bcode, size_t idx) {
 static const char *bcode_deserialize_func(struct v7 *v7, struct bcode *bcode,
                                           const char *data);
 
+/*
+ * Makes a string out of `len` bytes at `p` in `bcode->ops`: a foreign one if
+ * `ops` is in ROM (and hence outlives the string), or an owned atom otherwise.
+ * Images freed when unused are not considered ROM.
+ */
+static val_t bcode_mk_str(struct v7 *v7, struct bcode *bcode, const char *p,
+                          size_t len) {
+  if (bcode->ops_in_rom &&
+      (bcode->image == NULL || bcode->image->owner == BCODE_IMAGE_FOREIGN)) {
+    return v7_mk_string(v7, p, len, 0);
+  }
+  return atom_intern(v7, atom_mk_string(v7, p, len));
+}
+
+/*
+ * Returns the slot of `c` holding the literal at `off` in `ops`, or the empty
+ * slot where it should be put
+ */
+static struct bcode_lit_cache_slot *bcode_lit_cache_lookup(
+    struct bcode_lit_cache *c, bcode_off_t off) {
+  uint32_t i = off & c->mask;
+  while (c->slots[i].off != 0 && c->slots[i].off != off + 1) {
+    i = (i + 1) & c->mask;
+  }
+  return &c->slots[i];
+}
+
+/* Makes room for one more item in `bcode->lit_cache`; returns 0 on OOM */
+static int bcode_lit_cache_reserve(struct bcode *bcode) {
+  struct bcode_lit_cache *c = bcode->lit_cache, *n;
+  uint32_t size = 16, i;
+
+  if (c != NULL) {
+    if ((c->cnt + 1) * 2 <= c->mask + 1) {
+      return 1;
+    }
+    size = (c->mask + 1) * 2;
+  }
+
+  n = (struct bcode_lit_cache *) calloc(
+      1, sizeof(*n) + (size - 1) * sizeof(struct bcode_lit_cache_slot));
+  if (n == NULL) {
+    return 0;
+  }
+  n->mask = size - 1;
+  if (c != NULL) {
+    for (i = 0; i <= c->mask; i++) {
+      if (c->slots[i].off != 0) {
+        *bcode_lit_cache_lookup(n, c->slots[i].off - 1) = c->slots[i];
+      }
+    }
+    n->cnt = c->cnt;
+    free(c);
+  }
+  bcode->lit_cache = n;
+  return 1;
+}
+
+/*
+ * Looks up the value made out of the literal at `off` in `ops`, see
+ * `struct bcode_lit_cache`. Returns 0 if there is none.
+ */
+static int bcode_lit_cache_get(struct bcode *bcode, bcode_off_t off,
+                               val_t *res) {
+  struct bcode_lit_cache_slot *slot;
+  if (bcode->lit_cache == NULL) {
+    return 0;
+  }
+  slot = bcode_lit_cache_lookup(bcode->lit_cache, off);
+  if (slot->off == 0) {
+    return 0;
+  }
+  *res = ((val_t *) bcode->lit.p)[slot->idx];
+  return 1;
+}
+
+/*
+ * Appends `v`, made out of the literal at `off` in `ops`, to the literal
+ * table, so that `bcode_lit_cache_get()` finds it. Does nothing if out of
+ * memory.
+ */
+static void bcode_lit_cache_put(struct v7 *v7, struct bcode *bcode,
+                                bcode_off_t off, val_t v) {
+  struct bcode_lit_cache_slot *slot;
+  char *lit;
+
+  if (bcode->frozen || !bcode_lit_cache_reserve(bcode) ||
+      (lit = (char *) realloc(bcode->lit.p, bcode->lit.len + sizeof(v))) ==
+          NULL) {
+    return;
+  }
+
+  slot = bcode_lit_cache_lookup(bcode->lit_cache, off);
+  slot->off = off + 1;
+  slot->idx = bcode->lit.len / sizeof(v);
+  bcode->lit_cache->cnt++;
+
+  memcpy(lit + bcode->lit.len, &v, sizeof(v));
+  bcode->lit.p = lit;
+  bcode->lit.len += sizeof(v);
+
+#if V7_ENABLE__Memory__stats
+  v7->bcode_lit_total_size += sizeof(v);
+  if (bcode->deserialized) {
+    v7->bcode_lit_deser_size += sizeof(v);
+  }
+#else
+  (void) v7;
+#endif
+}
+
+/*
+ * Returns the string of `len` bytes at `p` in `bcode->ops`: an inline string
+ * literal or a name.
+ */
+static val_t bcode_str(struct v7 *v7, struct bcode *bcode, const char *p,
+                       size_t len) {
+  bcode_off_t off = (bcode_off_t)(p - bcode->ops.p);
+  val_t res;
+
+  if (len <= 5) {
+    /* short strings are stored right in the `val_t` */
+    return bcode_mk_str(v7, bcode, p, len);
+  }
+  if (!bcode_lit_cache_get(bcode, off, &res)) {
+    res = bcode_mk_str(v7, bcode, p, len);
+    bcode_lit_cache_put(v7, bcode, off, res);
+  }
+  return res;
+}
+
+/*
+ * Returns a new bcode for the function record at `rec` in `parent->ops`, or
+ * the existing one if the record is in an image and was deserialized before.
+ * The bcode is not retained.
+ */
+static struct bcode *bcode_inline_func(struct v7 *v7, struct bcode *parent,
+                                       const char *rec) {
+  struct bcode_image *img = parent->image;
+  struct bcode_image_func *f;
+  struct bcode *bcode;
+  bcode_off_t off = 0;
+  size_t i = 0;
+
+  if (img != NULL) {
+    off = (bcode_off_t)(rec - img->data);
+    i = bcode_image_func_idx(img, off);
+    if (i < img->funcs_cnt && img->funcs[i].off == off) {
+      return img->funcs[i].bcode;
+    }
+  }
+
+  bcode = (struct bcode *) calloc(1, sizeof(*bcode));
+  bcode_init(bcode, parent->strict_mode, NULL /* will be set below */, 0);
+  bcode_copy_filename_from(bcode, parent);
+  bcode_deserialize_func(v7, bcode, rec);
+
+  if (img != NULL) {
+    bcode->image = img;
+    img->refcnt++;
+    if (img->funcs_cnt == img->funcs_size) {
+      size_t size = img->funcs_size == 0 ? 8 : img->funcs_size * 2;
+      f = (struct bcode_image_func *) realloc(img->funcs,
+                                              size * sizeof(*f));
+      if (f == NULL) {
+        /* not indexed: the next instance gets a new bcode */
+        return bcode;
+      }
+      img->funcs = f;
+      img->funcs_size = size;
+    }
+    memmove(&img->funcs[i + 1], &img->funcs[i],
+            (img->funcs_cnt - i) * sizeof(img->funcs[0]));
+    img->funcs[i].off = off;
+    img->funcs[i].bcode = bcode;
+    img->funcs_cnt++;
+  }
+  return bcode;
+}
+
 V7_PRIVATE v7_val_t
 bcode_decode_lit(struct v7 *v7, struct bcode *bcode, char **ops) {
   struct v7_vec *vec = &bcode->lit;
@@ -14950,9 +16413,9 @@ bcode_decode_lit(struct v7 *v7, struct bcode *bcode, char **ops) {
     case BCODE_INLINE_STRING_TYPE_TAG: {
       val_t res;
       size_t len = bcode_get_varint(ops);
-      res = v7_mk_string(
-          v7, (const char *) *ops + 1 /*skip BCODE_INLINE_STRING_TYPE_TAG*/,
-          len, !bcode->ops_in_rom);
+      res = bcode_str(
+          v7, bcode,
+          (const char *) *ops + 1 /*skip BCODE_INLINE_STRING_TYPE_TAG*/, len);
       *ops += len + 1;
       return res;
     }
@@ -14973,27 +16436,25 @@ bcode_decode_lit(struct v7 *v7, struct bcode *bcode, char **ops) {
        */
       val_t res = mk_js_function(v7, NULL, v7_mk_object(v7));
 
-      /* Create bcode in this half-done function */
+      /* Get bcode for this half-done function from `ops` */
       struct v7_js_function *func = get_js_function_struct(res);
 
-      func->bcode = (struct bcode *) calloc(1, sizeof(*func->bcode));
-      bcode_init(func->bcode, bcode->strict_mode, NULL /* will be set below */,
-                 0);
-      bcode_copy_filename_from(func->bcode, bcode);
+      func->bcode = bcode_inline_func(
+          v7, bcode, *ops + 1 /*skip BCODE_INLINE_FUNC_TYPE_TAG*/);
       retain_bcode(v7, func->bcode);
 
-      /* deserialize the function's bcode from `ops` */
-      *ops = (char *) bcode_deserialize_func(
-          v7, func->bcode, *ops + 1 /*skip BCODE_INLINE_FUNC_TYPE_TAG*/);
-
-      /* decrement *ops, because it will be incremented by `eval_bcode` soon */
-      *ops -= 1;
+      /*
+       * skip the function record, which ends with its `ops`; minus one,
+       * because `*ops` will be incremented by `eval_bcode` soon
+       */
+      *ops = func->bcode->ops.p + func->bcode->ops.len - 1;
 
       return res;
     }
     case BCODE_INLINE_REGEXP_TYPE_TAG: {
 #if V7_ENABLE__RegExp
       enum v7_err rcode = V7_OK;
+      bcode_off_t off = (bcode_off_t)(*ops - bcode->ops.p);
       val_t res;
       size_t len_src, len_flags;
       char *buf_src, *buf_flags;
@@ -15006,10 +16467,16 @@ bcode_decode_lit(struct v7 *v7, struct bcode *bcode, char **ops) {
       buf_flags = *ops + 1;
       *ops += len_flags + 1 /* nul term */;
 
+      /* compile once, but yield a new object each time */
+      if (bcode_lit_cache_get(bcode, off, &res)) {
+        return regexp_clone(v7, res);
+      }
+
       rcode = v7_mk_regexp(v7, buf_src, len_src, buf_flags, len_flags, &res);
       assert(rcode == V7_OK);
       (void) rcode;
 
+      bcode_lit_cache_put(v7, bcode, off, res);
       return res;
 #else
       fprintf(stderr, "Firmware is built without -DV7_ENABLE__RegExp\n");
@@ -15212,12 +16679,7 @@ V7_PRIVATE char *bcode_next_name_v(struct v7 *v7, struct bcode *bcode,
   size_t len;
 
   ops = bcode_next_name(ops, &name, &len);
-
-  /*
-   * If `ops` is in RAM, we create owned string, since the string may outlive
-   * bcode. Otherwise (`ops` is in ROM), we create foreign string.
-   */
-  *res = v7_mk_string(v7, name, len, !bcode->ops_in_rom);
+  *res = bcode_str(v7, bcode, name, len);
 
   return ops;
 }
@@ -15257,10 +16719,17 @@ V7_PRIVATE bcode_off_t bcode_add_target(struct bcode_builder *bbuilder) {
 
 /*V7_PRIVATE*/ void bcode_serialize(struct v7 *v7, struct bcode *bcode,
                                     FILE *out) {
-  (void) v7;
-  (void) bcode;
+  struct bcode_image_hdr hdr;
 
-  fwrite(BIN_BCODE_SIGNATURE, sizeof(BIN_BCODE_SIGNATURE), 1, out);
+  hdr.endian = BCODE_IMAGE_ENDIAN;
+  hdr.version = BCODE_IMAGE_VERSION;
+  hdr.root = sizeof(BIN_BCODE_IMAGE_SIGNATURE) + sizeof(hdr);
+  hdr.size = hdr.root + calc_llen(bcode->args_cnt) +
+             calc_llen(bcode->names_cnt) + 1 /* flags */ +
+             calc_llen(bcode->ops.len) + bcode->ops.len;
+
+  fwrite(BIN_BCODE_IMAGE_SIGNATURE, sizeof(BIN_BCODE_IMAGE_SIGNATURE), 1, out);
+  fwrite(&hdr, sizeof(hdr), 1, out);
   bcode_serialize_func(v7, bcode, out);
 }
 
@@ -15288,8 +16757,10 @@ static void bcode_serialize_func(struct v7 *v7, struct bcode *bcode,
   /* names_cnt */
   bcode_serialize_varint(bcode->names_cnt, out);
 
-  /* func_name_present */
-  bcode_serialize_varint(bcode->func_name_present, out);
+  /* flags: func_name_present, uses_slots, uses_arguments */
+  bcode_serialize_varint(bcode->func_name_present | (bcode->uses_slots << 1) |
+                             (bcode->uses_arguments << 2),
+                         out);
 
   /*
    * bcode:
@@ -15333,8 +16804,14 @@ static const char *bcode_deserialize_func(struct v7 *v7, struct bcode *bcode,
   /* get number of names */
   bcode->names_cnt = bcode_deserialize_varint(&data);
 
-  /* get whether the function name is present in `names` */
-  bcode->func_name_present = bcode_deserialize_varint(&data);
+  /*
+   * get whether the function name is present in `names`, whether the
+   * function uses call frame slots and the `arguments` object
+   */
+  size = bcode_deserialize_varint(&data);
+  bcode->func_name_present = size & 1;
+  bcode->uses_slots = (size >> 1) & 1;
+  bcode->uses_arguments = (size >> 2) & 1;
 
   /* get opcode size */
   size = bcode_deserialize_varint(&data);
@@ -15351,9 +16828,86 @@ static const char *bcode_deserialize_func(struct v7 *v7, struct bcode *bcode,
   return data;
 }
 
-V7_PRIVATE void bcode_deserialize(struct v7 *v7, struct bcode *bcode,
-                                  const char *data) {
-  data = bcode_deserialize_func(v7, bcode, data);
+/*
+ * Returns the size of the function record at `data`, as written by
+ * `bcode_serialize_func()`, or 0 if it doesn't fit in `avail` bytes
+ */
+static size_t bcode_func_record_size(const char *data, size_t avail) {
+  const unsigned char *p = (const unsigned char *) data;
+  size_t off = 0, v = 0;
+  int i, n;
+
+  /* number of args, number of names, flags and size of `ops` */
+  for (i = 0; i < 4; i++) {
+    for (n = 0; off + n < avail && n < (int) sizeof(size_t) &&
+                (p[off + n] & 0x80);
+         n++) {
+    }
+    if (off + n >= avail) {
+      return 0;
+    }
+    v = decode_varint(p + off, &n);
+    off += n;
+  }
+
+  return v <= avail - off ? off + v : 0;
+}
+
+V7_PRIVATE int bcode_is_image(const char *data, size_t len) {
+  return (len >= sizeof(BIN_BCODE_IMAGE_SIGNATURE) &&
+          memcmp(data, BIN_BCODE_IMAGE_SIGNATURE,
+                 sizeof(BIN_BCODE_IMAGE_SIGNATURE)) == 0) ||
+         (len >= sizeof(BIN_BCODE_SIGNATURE) &&
+          memcmp(data, BIN_BCODE_SIGNATURE, sizeof(BIN_BCODE_SIGNATURE)) == 0);
+}
+
+V7_PRIVATE enum v7_err bcode_image_load(struct v7 *v7, struct bcode *bcode,
+                                        const char *data, size_t len,
+                                        enum bcode_image_owner owner) {
+  enum v7_err rcode = V7_OK;
+  struct bcode_image_hdr hdr;
+  struct bcode_image *img;
+
+  if (memcmp(data, BIN_BCODE_SIGNATURE, sizeof(BIN_BCODE_SIGNATURE)) == 0) {
+    hdr.root = sizeof(BIN_BCODE_SIGNATURE);
+    hdr.size = len;
+  } else if (len < sizeof(BIN_BCODE_IMAGE_SIGNATURE) + sizeof(hdr)) {
+    rcode = v7_throwf(v7, SYNTAX_ERROR, "truncated bcode image");
+    V7_THROW(V7_SYNTAX_ERROR);
+  } else {
+    /* the header may be unaligned */
+    memcpy(&hdr, data + sizeof(BIN_BCODE_IMAGE_SIGNATURE), sizeof(hdr));
+    if (hdr.endian != BCODE_IMAGE_ENDIAN || hdr.version != BCODE_IMAGE_VERSION) {
+      rcode = v7_throwf(v7, SYNTAX_ERROR, "unsupported bcode image version");
+      V7_THROW(V7_SYNTAX_ERROR);
+    }
+    if (hdr.size > len || hdr.root >= hdr.size) {
+      rcode = v7_throwf(v7, SYNTAX_ERROR, "truncated bcode image");
+      V7_THROW(V7_SYNTAX_ERROR);
+    }
+  }
+
+  /* nested function records are inside the `ops` of the script record */
+  if (bcode_func_record_size(data + hdr.root, hdr.size - hdr.root) == 0) {
+    rcode = v7_throwf(v7, SYNTAX_ERROR, "truncated bcode image");
+    V7_THROW(V7_SYNTAX_ERROR);
+  }
+
+  img = (struct bcode_image *) calloc(1, sizeof(*img));
+  if (img == NULL) {
+    rcode = v7_throwf(v7, INTERNAL_ERROR, "out of memory");
+    V7_THROW(V7_INTERNAL_ERROR);
+  }
+  img->data = data;
+  img->size = len;
+  img->owner = owner;
+  img->refcnt = 1;
+
+  bcode_deserialize_func(v7, bcode, data + hdr.root);
+  bcode->image = img;
+
+clean:
+  return rcode;
 }
 #ifdef V7_MODULE_LINES
 #line 1 "v7/src/eval.c"
@@ -15372,6 +16926,7 @@ V7_PRIVATE void bcode_deserialize(struct v7 *v7, struct bcode *bcode,
 /* Amalgamated: #include "v7/src/gc.h" */
 /* Amalgamated: #include "v7/src/compiler.h" */
 /* Amalgamated: #include "v7/src/cyg_profile.h" */
+/* Amalgamated: #include "v7/src/profiler.h" */
 /* Amalgamated: #include "v7/src/core.h" */
 /* Amalgamated: #include "v7/src/function.h" */
 /* Amalgamated: #include "v7/src/util.h" */
@@ -15519,12 +17074,21 @@ V7_PRIVATE val_t stack_tos(struct mbuf *s) {
   return *(val_t *) (s->buf + s->len - sizeof(val_t));
 }
 
-#ifdef V7_BCODE_TRACE_STACK
 V7_PRIVATE val_t stack_at(struct mbuf *s, size_t idx) {
   assert(s->len >= sizeof(val_t) * idx);
   return *(val_t *) (s->buf + s->len - sizeof(val_t) - idx * sizeof(val_t));
 }
-#endif
+
+/*
+ * Drops `cnt` values from the stack. They stay in the buffer until the next
+ * push, so the caller may still read them via the returned pointer to the
+ * first dropped value, provided no GC can happen in between.
+ */
+V7_PRIVATE val_t *stack_drop(struct mbuf *s, size_t cnt) {
+  assert(s->len >= sizeof(val_t) * cnt);
+  s->len -= sizeof(val_t) * cnt;
+  return (val_t *) (s->buf + s->len);
+}
 
 V7_PRIVATE int stack_sp(struct mbuf *s) {
   return s->len / sizeof(val_t);
@@ -15680,6 +17244,7 @@ struct bcode_registers {
   struct bcode *bcode;
   char *ops;
   char *end;
+  val_t *slots; /* slots of the current bcode call frame */
   unsigned int need_inc_ops : 1;
 };
 
@@ -15703,15 +17268,6 @@ static void bcode_adjust_retval(struct v7 *v7, uint8_t is_explicit_return) {
   }
 }
 
-static void bcode_restore_registers(struct v7 *v7, struct bcode *bcode,
-                                    struct bcode_registers *r) {
-  r->bcode = bcode;
-  r->ops = bcode->ops.p;
-  r->end = r->ops + bcode->ops.len;
-
-  (void) v7;
-}
-
 V7_PRIVATE struct v7_call_frame_base *find_call_frame(struct v7 *v7,
                                                       uint8_t type_mask) {
   struct v7_call_frame_base *ret = v7->call_stack;
@@ -15733,6 +17289,14 @@ static struct v7_call_frame_bcode *find_call_frame_bcode(struct v7 *v7) {
       v7, V7_CALL_FRAME_MASK_BCODE);
 }
 
+static void bcode_restore_registers(struct v7 *v7, struct bcode *bcode,
+                                    struct bcode_registers *r) {
+  r->bcode = bcode;
+  r->ops = bcode->ops.p;
+  r->end = r->ops + bcode->ops.len;
+  r->slots = find_call_frame_bcode(v7)->slots;
+}
+
 #if 0
 static struct v7_call_frame_cfunc *find_call_frame_cfunc(struct v7 *v7) {
   return (struct v7_call_frame_cfunc *) find_call_frame(
@@ -15811,12 +17375,24 @@ static void init_call_frame_bcode(struct v7 *v7,
 static void append_call_frame_bcode(struct v7 *v7, char *prev_bcode_ops,
                                     struct bcode *bcode, val_t this_obj,
                                     val_t scope, uint8_t is_constructor) {
+  size_t slots_cnt = bcode->uses_slots ? bcode->names_cnt : 0;
   struct v7_call_frame_bcode *call_frame =
-      (struct v7_call_frame_bcode *) create_call_frame(v7, sizeof(*call_frame));
+      (struct v7_call_frame_bcode *) create_call_frame(
+          v7, sizeof(*call_frame) + slots_cnt * sizeof(val_t));
 
   init_call_frame_bcode(v7, call_frame, prev_bcode_ops, bcode, this_obj, scope,
                         is_constructor);
 
+  /* slots are allocated right after the frame */
+  if (slots_cnt > 0) {
+    size_t i;
+    call_frame->slots = (val_t *) (call_frame + 1);
+    call_frame->slots_cnt = slots_cnt;
+    for (i = 0; i < slots_cnt; i++) {
+      call_frame->slots[i] = V7_UNDEFINED;
+    }
+  }
+
   v7->call_stack = &call_frame->base.base;
 }
 
@@ -15857,8 +17433,13 @@ static enum v7_err bcode_perform_call(struct v7 *v7, v7_val_t scope_frame,
                                       struct bcode_registers *r,
                                       val_t this_object, char *ops,
                                       uint8_t is_constructor) {
-  /* new scope_frame will inherit from the function's scope */
-  obj_prototype_set(v7, get_object_struct(scope_frame), &func->scope->base);
+  if (func->bcode->uses_slots) {
+    /* there is no scope frame: non-locals are looked up in function's scope */
+    scope_frame = v7_object_to_value(&func->scope->base);
+  } else {
+    /* new scope_frame will inherit from the function's scope */
+    obj_prototype_set(v7, get_object_struct(scope_frame), &func->scope->base);
+  }
 
   /* create new `call_frame` which will replace `v7->call_stack` */
   append_call_frame_bcode(v7, r->ops + 1, func->bcode, this_object, scope_frame,
@@ -16396,6 +17977,47 @@ static void eval_try_push(struct v7 *v7, enum opcode op,
   tmp_frame_cleanup(&tf);
 }
 
+/*
+ * Evaluate `OP_SWITCH` at `ops` for the value `v`: stores the target to jump
+ * to into `target`, and returns whether some `case` matched.
+ */
+static int eval_switch(struct v7 *v7, struct bcode *bcode, char *ops, val_t v,
+                       bcode_off_t *target) {
+  struct bcode_switch_slot slot;
+  enum bcode_switch_mode mode = (enum bcode_switch_mode) * ++ops;
+  size_t mask = bcode_get_varint(&ops), i;
+  char *slots;
+  uint32_t key;
+
+  *target = bcode_get_target(&ops);
+  slots = ops + 1;
+
+  if (mode == BCODE_SWITCH_STR) {
+    if (!v7_is_string(v)) return 0;
+    key = str_val_hash(v7, &v);
+  } else {
+    double d;
+    if (!v7_is_number(v)) return 0;
+    d = v7_get_double(v7, v);
+    if (!(d >= INT32_MIN && d <= INT32_MAX) || d != (int32_t) d) return 0;
+    key = (uint32_t)(int32_t) d;
+  }
+
+  for (i = key & mask;; i = (i + 1) & mask) {
+    memcpy(&slot, slots + i * sizeof(slot), sizeof(slot));
+    if (slot.target == 0) {
+      return 0;
+    } else if (slot.key == key) {
+      if (mode == BCODE_SWITCH_STR) {
+        char *p = bcode->ops.p + slot.lit;
+        if (s_cmp(v7, v, bcode_decode_lit(v7, bcode, &p)) != 0) continue;
+      }
+      *target = slot.target;
+      return 1;
+    }
+  }
+}
+
 /*
  * Evaluate `OP_TRY_POP`: just pop latest item from "try stack", ignoring it
  */
@@ -16460,6 +18082,19 @@ static void reset_last_name(struct v7 *v7) {
   v7->vals.last_name[0] = V7_UNDEFINED;
   v7->vals.last_name[1] = V7_UNDEFINED;
 }
+
+/*
+ * `OP_GET_LOCAL` records the slot number of the local instead of its name:
+ * replaces it in `name` with the name of the slot in `bcode`.
+ */
+static void local_name(struct v7 *v7, struct bcode *bcode, val_t *name) {
+  char *ops = bcode->ops.p;
+  size_t slot = v7_get_double(v7, *name);
+  while (slot-- > 0) {
+    ops = bcode_next_name(ops, NULL, NULL);
+  }
+  bcode_next_name_v(v7, bcode, ops, name);
+}
 #else
 static void reset_last_name(struct v7 *v7) {
   /* should be inlined out */
@@ -16473,6 +18108,160 @@ static void prop_iter_ctx_dtor(struct v7 *v7, void *ud) {
   free(ctx);
 }
 
+#if !V7_DISABLE_INLINE_CACHE
+
+/* properties which can't be assigned by a cached store */
+#define IC_NO_STORE \
+  (V7_PROPERTY_NON_WRITABLE | V7_PROPERTY_GETTER | V7_PROPERTY_SETTER)
+
+/*
+ * Returns first entry of the inline cache set for the instruction at `off`,
+ * allocating the cache if needed. Returns `NULL` if the bcode can't have one.
+ */
+static struct bcode_ic_entry *bcode_ic_set(struct bcode *bcode,
+                                           bcode_off_t off) {
+  struct bcode_ic *ic = bcode->ic;
+  if (ic == NULL) {
+    uint32_t sets = 4;
+    if (bcode->frozen) {
+      return NULL;
+    }
+    while (sets < BCODE_IC_MAX_SETS && sets * 8 < bcode->ops.len) {
+      sets *= 2;
+    }
+    ic = (struct bcode_ic *) calloc(
+        1, sizeof(*ic) +
+               (sets * BCODE_IC_WAYS - 1) * sizeof(struct bcode_ic_entry));
+    if (ic == NULL) {
+      return NULL;
+    }
+    ic->mask = sets - 1;
+    bcode->ic = ic;
+  }
+  return &ic->entries[(off & ic->mask) * BCODE_IC_WAYS];
+}
+
+static void bcode_ic_count(struct v7 *v7, struct bcode *bcode, int hit) {
+  if (hit) {
+    bcode->ic->hits++;
+#if V7_ENABLE__Memory__stats
+    v7->ic_hits++;
+#endif
+  } else {
+    bcode->ic->misses++;
+#if V7_ENABLE__Memory__stats
+    v7->ic_misses++;
+#endif
+  }
+  (void) v7;
+}
+
+/*
+ * Looks up the inline cache of the instruction at `off` for the property
+ * `name` of `obj`, which must be an object. Name comparison can be skipped
+ * with `check_name == 0` for instructions taking the name from the literal.
+ */
+static struct bcode_ic_entry *bcode_ic_find(struct v7 *v7,
+                                            struct bcode *bcode,
+                                            bcode_off_t off, val_t obj,
+                                            val_t name, int check_name) {
+  struct bcode_ic_entry *e = bcode_ic_set(bcode, off);
+  struct v7_object *o = get_object_struct(obj);
+  int i;
+
+  if (e == NULL) {
+    return NULL;
+  }
+
+  for (i = 0; i < BCODE_IC_WAYS; i++, e++) {
+    if (e->off != off || e->epoch != v7->ic_epoch || e->obj == NULL) continue;
+    if (check_name && e->name != name && s_cmp(v7, e->name, name) != 0) {
+      continue;
+    }
+    if (!e->proto) {
+      if (e->obj == o) break;
+    } else if (obj_prototype(v7, o) == e->obj) {
+      size_t len;
+      const char *s = v7_get_string(v7, &name, &len);
+      if (v7_get_own_property(v7, obj, s, len) == NULL) break;
+    }
+  }
+
+  if (i < BCODE_IC_WAYS) {
+    bcode_ic_count(v7, bcode, 1);
+    return e;
+  }
+  bcode_ic_count(v7, bcode, 0);
+  return NULL;
+}
+
+/*
+ * Remembers that the property `name` of `obj` is `prop`, owned by `holder`.
+ */
+static void bcode_ic_fill(struct v7 *v7, struct bcode *bcode, bcode_off_t off,
+                          val_t obj, val_t name, val_t holder,
+                          struct v7_property *prop) {
+  struct bcode_ic_entry *e = bcode_ic_set(bcode, off);
+  struct v7_object *o = get_object_struct(obj);
+
+  if (e == NULL || prop == v7->cur_dense_prop) {
+    return;
+  }
+
+  /* most recently filled entry goes first */
+  memmove(e + 1, e, (BCODE_IC_WAYS - 1) * sizeof(*e));
+  e->epoch = v7->ic_epoch;
+  e->off = off;
+  e->name = name;
+  e->prop = prop;
+  if (holder == obj) {
+    e->proto = 0;
+    e->obj = o;
+  } else {
+    e->proto = 1;
+    e->obj = obj_prototype(v7, o);
+  }
+}
+
+/*
+ * Like `v7_get_property_v()`, but uses the inline cache of the instruction at
+ * `off`. `obj` must be an object, and `name` must be a string.
+ */
+static struct v7_property *bcode_ic_get_property(struct v7 *v7,
+                                                 struct bcode *bcode,
+                                                 bcode_off_t off, val_t obj,
+                                                 val_t name, int check_name) {
+  struct bcode_ic_entry *e;
+  struct v7_property *p = NULL;
+  int cacheable = 1;
+  const char *s;
+  size_t len;
+  val_t h;
+
+  if ((e = bcode_ic_find(v7, bcode, off, obj, name, check_name)) != NULL) {
+    return e->prop;
+  }
+
+  s = v7_get_string(v7, &name, &len);
+  for (h = obj; h != V7_NULL; h = v7_get_proto(v7, h)) {
+    /* elements of dense arrays aren't linked properties */
+    if (get_object_struct(h)->attributes & V7_OBJ_DENSE_ARRAY) {
+      unsigned long index;
+      if (cstr_to_array_index(s, len, &index)) cacheable = 0;
+    }
+    if ((p = v7_get_own_property(v7, h, s, len)) != NULL) {
+      break;
+    }
+  }
+
+  if (p != NULL && cacheable) {
+    bcode_ic_fill(v7, bcode, off, obj, name, h, p);
+  }
+  return p;
+}
+
+#endif /* V7_DISABLE_INLINE_CACHE */
+
 /*
  * Evaluates given `bcode`. If `reset_line_no` is non-zero, the line number
  * is initially reset to 1; otherwise, it is inherited from the previous call
@@ -16568,6 +18357,13 @@ restart:
 
     push_bcode_history(v7, op);
 
+#if V7_ENABLE_PROFILER
+    if (v7->prof != NULL && v7->prof->running &&
+        --v7->prof->countdown == 0) {
+      prof_sample(v7, r.bcode, (uint8_t) op);
+    }
+#endif
+
     if (v7->need_gc) {
       if (maybe_gc(v7)) {
         v7->need_gc = 0;
@@ -16738,8 +18534,10 @@ restart:
         v1 = POP();
         if (v7_is_string(v1) && v7_is_string(v2)) {
           res = v7_mk_boolean(v7, s_cmp(v7, v1, v2) == 0);
-        } else if (v1 == v2 && v1 == V7_TAG_NAN) {
-          res = v7_mk_boolean(v7, 0);
+        } else if (v7_is_number(v1) && v7_is_number(v2)) {
+          /* by value: NaN is not equal to itself, -0 is equal to 0 */
+          res = v7_mk_boolean(v7, b_bool_bin_op(op, v7_get_double(v7, v1),
+                                                v7_get_double(v7, v2)));
         } else {
           res = v7_mk_boolean(v7, v1 == v2);
         }
@@ -16751,8 +18549,10 @@ restart:
         v1 = POP();
         if (v7_is_string(v1) && v7_is_string(v2)) {
           res = v7_mk_boolean(v7, s_cmp(v7, v1, v2) != 0);
-        } else if (v1 == v2 && v1 == V7_TAG_NAN) {
-          res = v7_mk_boolean(v7, 1);
+        } else if (v7_is_number(v1) && v7_is_number(v2)) {
+          /* by value: NaN is not equal to itself, -0 is equal to 0 */
+          res = v7_mk_boolean(v7, b_bool_bin_op(op, v7_get_double(v7, v1),
+                                                v7_get_double(v7, v2)));
         } else {
           res = v7_mk_boolean(v7, v1 != v2);
         }
@@ -16898,7 +18698,22 @@ restart:
       case OP_GET:
         v2 = POP();
         v1 = POP();
-        BTRY(v7_get_throwing_v(v7, v1, v2, &v3));
+#if V7_ENABLE_DENSE_ARRAYS
+        if (dense_array_get_fast(v7, v1, v2, &v3)) {
+          /* `a[i]` of an existing element of a dense array */
+        } else
+#endif
+#if !V7_DISABLE_INLINE_CACHE
+        if (v7_is_object(v1) && v7_is_string(v2) &&
+            !(get_object_struct(v1)->attributes & V7_OBJ_PROXY)) {
+          struct v7_property *p = bcode_ic_get_property(
+              v7, r.bcode, r.ops - r.bcode->ops.p, v1, v2, 1);
+          BTRY(v7_property_value(v7, v1, p, &v3));
+        } else
+#endif
+        {
+          BTRY(v7_get_throwing_v(v7, v1, v2, &v3));
+        }
         PUSH(v3);
 #if !V7_DISABLE_CALL_ERROR_CONTEXT
         v7->vals.last_name[1] = v7->vals.last_name[0];
@@ -16910,6 +18725,35 @@ restart:
         v2 = POP();
         v1 = POP();
 
+#if V7_ENABLE_DENSE_ARRAYS
+        if (dense_array_set_fast(v7, v1, v2, v3)) {
+          PUSH(v3);
+          break;
+        }
+#endif
+
+#if !V7_DISABLE_INLINE_CACHE
+        if (v7_is_object(v1) && v7_is_string(v2) &&
+            !(get_object_struct(v1)->attributes & V7_OBJ_PROXY)) {
+          bcode_off_t off = r.ops - r.bcode->ops.p;
+          struct bcode_ic_entry *e =
+              bcode_ic_find(v7, r.bcode, off, v1, v2, 1);
+          struct v7_property *prop = NULL;
+
+          if (e != NULL && !e->proto && !(e->prop->attributes & IC_NO_STORE)) {
+            e->prop->value = v3;
+          } else {
+            BTRY(set_property_v(v7, v1, v2, v3, &prop));
+            /* only plain own data properties are stored directly */
+            if (prop != NULL && !(prop->attributes & IC_NO_STORE)) {
+              bcode_ic_fill(v7, r.bcode, off, v1, v2, v1, prop);
+            }
+          }
+          PUSH(v3);
+          break;
+        }
+#endif
+
         /* convert name to string, if it's not already */
         BTRY(to_string(v7, v2, &v2, NULL, 0, NULL));
 
@@ -16923,8 +18767,16 @@ restart:
       case OP_SAFE_GET_VAR: {
         struct v7_property *p = NULL;
         assert(r.ops < r.end - 1);
+#if !V7_DISABLE_INLINE_CACHE
+        {
+          bcode_off_t off = r.ops - r.bcode->ops.p;
+          v1 = bcode_decode_lit(v7, r.bcode, &r.ops);
+          p = bcode_ic_get_property(v7, r.bcode, off, get_scope(v7), v1, 0);
+        }
+#else
         v1 = bcode_decode_lit(v7, r.bcode, &r.ops);
         BTRY(v7_get_property_v(v7, get_scope(v7), v1, &p));
+#endif
         if (p == NULL) {
           if (op == OP_SAFE_GET_VAR) {
             PUSH(V7_UNDEFINED);
@@ -16944,14 +18796,36 @@ restart:
 #endif
         break;
       }
+      case OP_GET_LOCAL: {
+        size_t slot = bcode_get_varint(&r.ops);
+        PUSH(r.slots[slot]);
+#if !V7_DISABLE_CALL_ERROR_CONTEXT
+        /* the name is looked up only if needed, see `OP_CHECK_CALL` */
+        v7->vals.last_name[0] = v7_mk_number(v7, slot);
+        v7->vals.last_name[1] = V7_UNDEFINED;
+#endif
+        break;
+      }
+      case OP_SET_LOCAL:
+        r.slots[bcode_get_varint(&r.ops)] = TOS();
+        break;
       case OP_SET_VAR: {
         struct v7_property *prop;
         v3 = POP();
+#if !V7_DISABLE_INLINE_CACHE
+        {
+          bcode_off_t off = r.ops - r.bcode->ops.p;
+          v2 = bcode_decode_lit(v7, r.bcode, &r.ops);
+          v1 = get_scope(v7);
+          prop = bcode_ic_get_property(v7, r.bcode, off, v1, v2, 0);
+        }
+#else
         v2 = bcode_decode_lit(v7, r.bcode, &r.ops);
         v1 = get_scope(v7);
 
         BTRY(to_string(v7, v2, NULL, buf, sizeof(buf), NULL));
         prop = v7_get_property(v7, v1, buf, strlen(buf));
+#endif
         if (prop != NULL) {
           /* Property already exists: update its value */
           /*
@@ -17024,6 +18898,16 @@ restart:
         v7->is_continuing = 0;
         break;
       }
+      case OP_SWITCH: {
+        bcode_off_t target;
+        v1 = POP();
+        if (eval_switch(v7, r.bcode, r.ops, v1, &target)) {
+          POP();
+          PUSH(v1);
+        }
+        r.ops = r.bcode->ops.p + target - 1;
+        break;
+      }
       case OP_CREATE_OBJ:
         PUSH(v7_mk_object(v7));
         break;
@@ -17127,6 +19011,9 @@ restart:
            */
           if (v7->last_ops[0] == OP_GET_VAR) {
             arity = 1;
+          } else if (v7->last_ops[0] == OP_GET_LOCAL) {
+            local_name(v7, r.bcode, &v7->vals.last_name[0]);
+            arity = 1;
           } else if (v7->last_ops[0] == OP_GET &&
                      v7->last_ops[1] == OP_PUSH_LIT) {
             /*
@@ -17141,6 +19028,11 @@ restart:
             if (v7_is_undefined(v7->vals.last_name[1])) {
               arity = 1;
             } else {
+              /* the object of a method call is duplicated as `this` */
+              if (v7->last_ops[2] == OP_DUP &&
+                  v7->last_ops[3] == OP_GET_LOCAL) {
+                local_name(v7, r.bcode, &v7->vals.last_name[1]);
+              }
               arity = 2;
             }
           }
@@ -17171,7 +19063,6 @@ restart:
         break;
       case OP_CALL:
       case OP_NEW: {
-        /* Naive implementation pending stack frame redesign */
         int args = (int) *(++r.ops);
         uint8_t is_constructor = (op == OP_NEW);
 
@@ -17179,15 +19070,17 @@ restart:
           BTRY(v7_throwf(v7, INTERNAL_ERROR, "stack underflow"));
           goto op_done;
         } else {
-          v2 = v7_mk_dense_array(v7);
-          while (args > 0) {
-            BTRY(v7_array_set_throwing(v7, v2, --args, POP(), NULL));
-          }
-          /* pop function to call */
-          v1 = POP();
+          /*
+           * Arguments are left on the stack (where GC can see them) until
+           * the callee is set up: the arguments array is created only for
+           * cfunctions and for functions which use the `arguments` object.
+           */
 
-          /* pop `this` */
-          v3 = POP();
+          /* function to call */
+          v1 = stack_at(&v7->stack, args);
+
+          /* `this` */
+          v3 = stack_at(&v7->stack, args + 1);
 
           /*
            * adjust `this` if the function is called with the constructor
@@ -17206,6 +19099,7 @@ restart:
             v4 = v7_get(v7, v1 /*func*/, "prototype", 9);
             if (!v7_is_object(v4)) {
               /* TODO(dfrank): box primitive value */
+              stack_drop(&v7->stack, args + 2);
               BTRY(v7_throwf(
                   v7, TYPE_ERROR,
                   "Cannot set a primitive value as object prototype"));
@@ -17215,6 +19109,7 @@ restart:
                * TODO(dfrank): maybe add support for a cfunction pointer to be
                * a prototype
                */
+              stack_drop(&v7->stack, args + 2);
               BTRY(v7_throwf(v7, TYPE_ERROR,
                              "Not implemented: cfunction as a prototype"));
               goto op_done;
@@ -17227,10 +19122,19 @@ restart:
 
           if (!v7_is_callable(v7, v1)) {
             /* tried to call non-function object: throw a TypeError */
+            stack_drop(&v7->stack, args + 2);
             BTRY(v7_throw(v7, v7->vals.call_check_ex));
             goto op_done;
           } else if (is_cfunction_lite(v1) || is_cfunction_obj(v7, v1)) {
             /* call cfunction */
+            int arg_num;
+            v2 = v7_mk_dense_array(v7);
+            for (arg_num = 0; arg_num < args; ++arg_num) {
+              BTRY(v7_array_set_throwing(
+                  v7, v2, arg_num,
+                  stack_at(&v7->stack, args - 1 - arg_num), NULL));
+            }
+            stack_drop(&v7->stack, args + 2);
 
             /*
              * In "function invocation pattern", the `this` value popped from
@@ -17262,6 +19166,24 @@ restart:
               v3 = v7->vals.global_object;
             }
 
+            if (func->bcode->uses_slots) {
+              /*
+               * Names were resolved to slots by the compiler: the function
+               * itself goes to slot 0, arguments follow, and locals are
+               * `undefined` initially. There is no scope object to populate.
+               */
+              int arg_num, cnt = func->bcode->args_cnt;
+              val_t *argv = stack_drop(&v7->stack, args + 2) + 2;
+              ops = bcode_end_names(func->bcode->ops.p, func->bcode->names_cnt);
+              V7_TRY(bcode_perform_call(v7, V7_UNDEFINED, func, &r,
+                                        v3 /*this*/, ops, is_constructor));
+              r.slots[0] = v1;
+              for (arg_num = 0; arg_num < cnt && arg_num < args; ++arg_num) {
+                r.slots[arg_num + 1] = argv[arg_num];
+              }
+              break;
+            }
+
             scope_frame = v7_mk_object(v7);
 
             /*
@@ -17291,11 +19213,13 @@ restart:
                 ops = bcode_next_name_v(v7, func->bcode, ops, &v4);
                 BTRY(def_property_v(
                     v7, scope_frame, v4, V7_DESC_CONFIGURABLE(0),
-                    v7_array_get(v7, v2, arg_num), 0 /*not assign*/, NULL));
+                    arg_num < args ? stack_at(&v7->stack, args - 1 - arg_num)
+                                   : V7_UNDEFINED,
+                    0 /*not assign*/, NULL));
               }
             }
 
-            /* populate `arguments` object */
+            /* populate `arguments` object, if the function needs it */
 
             /*
              * TODO(dfrank): it's actually much more complicated than that:
@@ -17307,8 +19231,17 @@ restart:
              *
              * should yield 2. Currently, it yields 1.
              */
-            v7_def(v7, scope_frame, "arguments", 9, V7_DESC_CONFIGURABLE(0),
-                   v2);
+            if (func->bcode->uses_arguments) {
+              int arg_num;
+              v2 = v7_mk_dense_array(v7);
+              for (arg_num = 0; arg_num < args; ++arg_num) {
+                BTRY(v7_array_set_throwing(
+                    v7, v2, arg_num,
+                    stack_at(&v7->stack, args - 1 - arg_num), NULL));
+              }
+              v7_def(v7, scope_frame, "arguments", 9, V7_DESC_CONFIGURABLE(0),
+                     v2);
+            }
 
             /* populate local variables */
             {
@@ -17324,6 +19257,7 @@ restart:
             }
 
             /* transfer control to the function */
+            stack_drop(&v7->stack, args + 2);
             V7_TRY(bcode_perform_call(v7, scope_frame, func, &r, v3 /*this*/,
                                       ops, is_constructor));
 
@@ -17618,6 +19552,9 @@ V7_PRIVATE enum v7_err b_exec(struct v7 *v7, const char *src, size_t src_len,
   val_t _res = V7_UNDEFINED;
   struct gc_tmp_frame tf = new_tmp_frame(v7);
   struct bcode *bcode = NULL;
+#if !V7_DISABLE_BCODE_CACHE
+  struct bcode *cached;
+#endif
 #if V7_ENABLE_STACK_TRACKING
   struct stack_track_ctx stack_track_ctx;
 #endif
@@ -17667,29 +19604,34 @@ V7_PRIVATE enum v7_err b_exec(struct v7 *v7, const char *src, size_t src_len,
 
     flags.line_no_reset = 1;
 
-    if (src_len >= sizeof(BIN_BCODE_SIGNATURE) &&
-        strncmp(BIN_BCODE_SIGNATURE, src, sizeof(BIN_BCODE_SIGNATURE)) == 0) {
-      /* we have a serialized bcode */
-
-      bcode_deserialize(v7, bcode, src + sizeof(BIN_BCODE_SIGNATURE));
-
-/*
- * Currently, we only support serialized bcode that is stored in some
- * mmapped memory. Otherwise, we don't yet have any mechanism to free
- * this memory at the appropriate time.
- */
+#if !V7_DISABLE_BCODE_CACHE
+    if (v7->bcode_cache_max > 0 &&
+        (cached = bcode_cache_find(v7, src, src_len, filename, is_json)) !=
+            NULL) {
+      /* the same script was compiled before: use that bcode instead */
+      disown_bcode(v7, bcode);
+      release_bcode(v7, bcode);
+      bcode = cached;
+      retain_bcode(v7, bcode);
+      own_bcode(v7, bcode);
 
-/*
- * TODO(dfrank): currently, we remove this assert, and introduce memory
- * leak. We need to support that properly.
- */
-#if 0
-      assert(fr == 0);
-#else
-      if (fr) {
-        fr = 0;
+      if (v7_is_undefined(this_object)) {
+        this_object = v7->vals.global_object;
       }
+    } else
 #endif
+        if (bcode_is_image(src, src_len)) {
+      /*
+       * we have a serialized bcode: it's executed in place, and `src` now
+       * belongs to the image
+       */
+      V7_TRY(bcode_image_load(v7, bcode, src, src_len,
+                              (enum bcode_image_owner) fr));
+      fr = 0;
+
+      if (v7_is_undefined(this_object)) {
+        this_object = v7->vals.global_object;
+      }
     } else {
 /* Maybe regular JavaScript source or binary AST data */
 #if !defined(V7_NO_COMPILER)
@@ -17733,6 +19675,13 @@ V7_PRIVATE enum v7_err b_exec(struct v7 *v7, const char *src, size_t src_len,
         ast_off_t pos = 0;
         V7_TRY(compile_expr(v7, a, &pos, bcode));
       }
+
+#if !V7_DISABLE_BCODE_CACHE
+      /* AST living in ROM is not worth copying to RAM */
+      if (v7->bcode_cache_max > 0 && !flags.noopt) {
+        bcode_cache_add(v7, src, src_len, filename, is_json, bcode);
+      }
+#endif
 #else  /* V7_NO_COMPILER */
       (void) is_json;
       /* Parsing JavaScript code is disabled */
@@ -17814,7 +19763,7 @@ clean:
    * V7_TRY2() with custom label instead of V7_TRY()
    */
   if (src != NULL && fr) {
-    free((void *) src);
+    bcode_image_free_data(src, src_len, (enum bcode_image_owner) fr);
   }
 
   /* disown and release current bcode */
@@ -17915,6 +19864,7 @@ V7_PRIVATE enum v7_err b_apply(struct v7 *v7, v7_val_t func, v7_val_t this_obj,
 /* Amalgamated: #include "v7/src/gc.h" */
 /* Amalgamated: #include "v7/src/heapusage.h" */
 /* Amalgamated: #include "v7/src/eval.h" */
+/* Amalgamated: #include "v7/src/string.h" */
 
 #ifdef V7_THAW
 extern struct v7_vals *fr_vals;
@@ -17993,15 +19943,17 @@ static void function_destructor(struct v7 *v7, void *ptr) {
 #endif
 }
 
-#if V7_ENABLE_ENTITY_IDS
 static void property_destructor(struct v7 *v7, void *ptr) {
   struct v7_property *p = (struct v7_property *) ptr;
   (void) v7;
   if (p == NULL) return;
 
+  obj_prop_index_free(v7, p);
+
+#if V7_ENABLE_ENTITY_IDS
   p->entity_id = V7_ENTITY_ID_NONE;
-}
 #endif
+}
 
 struct v7 *v7_create(void) {
   struct v7_create_opts opts;
@@ -18027,6 +19979,13 @@ struct v7 *v7_create_opt(struct v7_create_opts opts) {
   if (opts.object_arena_size == 0) opts.object_arena_size = 200;
   if (opts.function_arena_size == 0) opts.function_arena_size = 100;
   if (opts.property_arena_size == 0) opts.property_arena_size = 400;
+  if (opts.gc_live_ratio == 0) opts.gc_live_ratio = 80;
+  if (opts.gc_live_ratio > 100) opts.gc_live_ratio = 100;
+  if (opts.gc_min_growth == 0) opts.gc_min_growth = 10;
+  if (opts.gc_max_growth == 0) opts.gc_max_growth = 1000;
+  if (opts.gc_max_growth < opts.gc_min_growth) {
+    opts.gc_max_growth = opts.gc_min_growth;
+  }
 
   if ((v7 = (struct v7 *) calloc(1, sizeof(*v7))) != NULL) {
 #ifdef V7_STACK_SIZE
@@ -18049,17 +20008,20 @@ struct v7 *v7_create_opt(struct v7_create_opts opts) {
 
     v7->cur_dense_prop =
         (struct v7_property *) calloc(1, sizeof(struct v7_property));
+    v7->gc_live_ratio = opts.gc_live_ratio;
+    v7->gc_alloc_budget = opts.gc_alloc_budget;
+    v7->gc_max_growth = opts.gc_max_growth;
+    v7->gc_budget = opts.gc_alloc_budget;
+
     gc_arena_init(&v7->generic_object_arena, sizeof(struct v7_generic_object),
-                  opts.object_arena_size, 10, "object");
+                  opts.object_arena_size, opts.gc_min_growth, "object");
     v7->generic_object_arena.destructor = generic_object_destructor;
     gc_arena_init(&v7->function_arena, sizeof(struct v7_js_function),
-                  opts.function_arena_size, 10, "function");
+                  opts.function_arena_size, opts.gc_min_growth, "function");
     v7->function_arena.destructor = function_destructor;
     gc_arena_init(&v7->property_arena, sizeof(struct v7_property),
-                  opts.property_arena_size, 10, "property");
-#if V7_ENABLE_ENTITY_IDS
+                  opts.property_arena_size, opts.gc_min_growth, "property");
     v7->property_arena.destructor = property_destructor;
-#endif
 
     /*
      * The compacting GC exploits the null terminator of the previous
@@ -18094,6 +20056,11 @@ struct v7 *v7_create_opt(struct v7_create_opts opts) {
     init_socket(v7);
 #endif
 
+#if !V7_DISABLE_BCODE_CACHE
+    /* scripts of the stdlib are executed just once, so don't cache them */
+    v7->bcode_cache_max = opts.bcode_cache_size;
+#endif
+
     v7->inhibit_gc = 0;
   }
 
@@ -18106,6 +20073,12 @@ val_t v7_get_global(struct v7 *v7) {
 
 void v7_destroy(struct v7 *v7) {
   if (v7 == NULL) return;
+#if !V7_DISABLE_BCODE_CACHE
+  bcode_cache_free(v7);
+#endif
+#if V7_ENABLE_PROFILER
+  prof_free(v7);
+#endif
   gc_arena_destroy(v7, &v7->generic_object_arena);
   gc_arena_destroy(v7, &v7->function_arena);
   gc_arena_destroy(v7, &v7->property_arena);
@@ -18113,6 +20086,17 @@ void v7_destroy(struct v7 *v7) {
   mbuf_free(&v7->owned_strings);
   mbuf_free(&v7->owned_values);
   mbuf_free(&v7->foreign_strings);
+#if V7_ENABLE_STR_BUILDER
+  str_buf_sweep(v7, 1);
+#endif
+#if !V7_DISABLE_ATOMS
+  free(v7->atoms);
+#endif
+  str_rune_cache_flush(v7);
+  free(v7->rune_cache);
+#if V7_ENABLE__RegExp
+  regexp_cache_free(v7);
+#endif
   mbuf_free(&v7->json_visited_stack);
   mbuf_free(&v7->tmp_stack);
   mbuf_free(&v7->act_bcodes);
@@ -18590,6 +20574,7 @@ int v7_is_callable(struct v7 *v7, val_t v) {
 /* Amalgamated: #include "v7/src/ast.h" */
 /* Amalgamated: #include "v7/src/compiler.h" */
 /* Amalgamated: #include "v7/src/exceptions.h" */
+/* Amalgamated: #include "v7/src/std_json.h" */
 
 enum v7_err v7_exec(struct v7 *v7, const char *js_code, v7_val_t *res) {
   return b_exec(v7, js_code, strlen(js_code), NULL, V7_UNDEFINED, V7_UNDEFINED,
@@ -18598,10 +20583,13 @@ enum v7_err v7_exec(struct v7 *v7, const char *js_code, v7_val_t *res) {
 
 enum v7_err v7_exec_opt(struct v7 *v7, const char *js_code,
                         const struct v7_exec_opts *opts, v7_val_t *res) {
+  if (opts->is_json) {
+    return v7_parse_json(v7, js_code, res);
+  }
   return b_exec(v7, js_code, strlen(js_code), opts->filename, V7_UNDEFINED,
                 V7_UNDEFINED,
-                (opts->this_obj == 0 ? V7_UNDEFINED : opts->this_obj),
-                opts->is_json, 0, 0, res);
+                (opts->this_obj == 0 ? V7_UNDEFINED : opts->this_obj), 0, 0, 0,
+                res);
 }
 
 enum v7_err v7_exec_buf(struct v7 *v7, const char *js_code, size_t len,
@@ -18610,14 +20598,31 @@ enum v7_err v7_exec_buf(struct v7 *v7, const char *js_code, size_t len,
                 V7_UNDEFINED, 0, 0, 0, res);
 }
 
+/*
+ * Like `b_exec()` does, on error store the exception in `res`, and clear it
+ * unless we were called by some script.
+ */
+static enum v7_err json_parse_result(struct v7 *v7, enum v7_err rcode,
+                                     val_t *res) {
+  if (rcode != V7_OK) {
+    val_t ex = v7->vals.thrown_error;
+    if (v7->act_bcodes.len == 0) {
+      v7_clear_thrown_value(v7);
+    }
+    if (res != NULL) *res = ex;
+  }
+  return rcode;
+}
+
 enum v7_err v7_parse_json(struct v7 *v7, const char *str, v7_val_t *res) {
-  return b_exec(v7, str, strlen(str), NULL, V7_UNDEFINED, V7_UNDEFINED,
-                V7_UNDEFINED, 1, 0, 0, res);
+  val_t v = V7_UNDEFINED;
+  enum v7_err rcode = json_parse(v7, str, strlen(str), &v);
+  if (res != NULL) *res = v;
+  return json_parse_result(v7, rcode, res);
 }
 
 #ifndef V7_NO_FS
-static enum v7_err exec_file(struct v7 *v7, const char *path, val_t *res,
-                             int is_json) {
+static enum v7_err exec_file(struct v7 *v7, const char *path, val_t *res) {
   enum v7_err rcode = V7_OK;
   char *p;
   size_t file_size;
@@ -18655,7 +20660,7 @@ static enum v7_err exec_file(struct v7 *v7, const char *path, val_t *res,
     int fr = 0;
 #endif
     rcode = b_exec(v7, p, file_size, path, V7_UNDEFINED, V7_UNDEFINED,
-                   V7_UNDEFINED, is_json, fr, 0, res);
+                   V7_UNDEFINED, 0, fr, 0, res);
     if (rcode != V7_OK) {
       goto clean;
     }
@@ -18666,11 +20671,80 @@ clean:
 }
 
 enum v7_err v7_exec_file(struct v7 *v7, const char *path, val_t *res) {
-  return exec_file(v7, path, res, 0);
+  return exec_file(v7, path, res);
+}
+
+enum v7_err v7_load_image(struct v7 *v7, const char *path, val_t *res) {
+  enum v7_err rcode = V7_OK;
+  enum bcode_image_owner owner = BCODE_IMAGE_MALLOCED;
+  size_t size = 0;
+  char *p = NULL;
+  int empty = 0;
+#if CS_PLATFORM == CS_P_UNIX
+  struct stat st;
+  int fd;
+
+  if ((fd = open(path, O_RDONLY)) >= 0) {
+    if (fstat(fd, &st) == 0) {
+      size = (size_t) st.st_size;
+      /* empty files can't be mapped, and are not images anyway */
+      empty = size == 0;
+      if (!empty) {
+        p = (char *) mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) p = NULL;
+        owner = BCODE_IMAGE_MAPPED;
+      }
+    }
+    close(fd);
+  }
+#else
+  p = cs_read_file(path, &size);
+#endif
+
+  if (p == NULL && !empty) {
+    rcode = v7_throwf(v7, SYNTAX_ERROR, "cannot open [%s]", path);
+  } else if (p == NULL || !bcode_is_image(p, size)) {
+    if (p != NULL) bcode_image_free_data(p, size, owner);
+    rcode = v7_throwf(v7, SYNTAX_ERROR, "[%s] is not a bcode image", path);
+  } else {
+    return b_exec(v7, p, size, path, V7_UNDEFINED, V7_UNDEFINED, V7_UNDEFINED,
+                  0, owner, 0, res);
+  }
+
+  /* like `exec_file()`, store the exception in `*res` */
+  if (res != NULL) *res = v7_get_thrown_value(v7, NULL);
+  return rcode;
 }
 
 enum v7_err v7_parse_json_file(struct v7 *v7, const char *path, v7_val_t *res) {
-  return exec_file(v7, path, res, 1);
+  enum v7_err rcode = V7_OK;
+  struct v7_json_parser *p = NULL;
+  char buf[BUFSIZ];
+  size_t n;
+  FILE *fp;
+
+  if (res != NULL) *res = V7_UNDEFINED;
+
+  /* the file is read and parsed chunk by chunk */
+  if ((fp = fopen(path, "rb")) == NULL) {
+    rcode = v7_throwf(v7, SYNTAX_ERROR, "cannot open [%s]", path);
+    goto clean;
+  }
+  if ((p = v7_json_parser_create(v7)) == NULL) {
+    rcode = v7_throwf(v7, INTERNAL_ERROR, "out of memory");
+    goto clean;
+  }
+  while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+    V7_TRY(v7_json_parser_feed(p, buf, n));
+  }
+  V7_TRY(v7_json_parser_end(p, res));
+
+clean:
+  v7_json_parser_destroy(p);
+  if (fp != NULL) {
+    fclose(fp);
+  }
+  return json_parse_result(v7, rcode, res);
 }
 #endif /* V7_NO_FS */
 
@@ -18778,6 +20852,14 @@ void v7_fprintln(FILE *f, struct v7 *v7, val_t v) {
   fprintf(f, ENDL);
 }
 
+static void fprint_json_cb(const char *data, size_t len, void *user_data) {
+  fwrite(data, 1, len, (FILE *) user_data);
+}
+
+enum v7_err v7_fprint_json(FILE *f, struct v7 *v7, val_t v) {
+  return v7_stringify_to_callback(v7, v, V7_STRINGIFY_JSON, fprint_json_cb, f);
+}
+
 void v7_fprint_stack_trace(FILE *f, struct v7 *v7, val_t e) {
   size_t s;
   val_t strace_v = v7_get(v7, e, "stack", ~0);
@@ -19173,12 +21255,10 @@ V7_PRIVATE enum v7_err v7_char_code_at(struct v7 *v7, val_t obj, val_t arg,
     goto clean;
   }
 
-  p = v7_get_string(v7, &s, &n);
-
-  n = utfnlen(p, n);
+  n = str_val_runes(v7, &s);
   if (v7_is_number(arg) && at >= 0 && at < n) {
     Rune r = 0;
-    p = utfnshift(p, at);
+    p = str_val_rune_ptr(v7, &s, at);
     chartorune(&r, (char *) p);
     *res = r;
     goto clean;
@@ -19210,6 +21290,468 @@ V7_PRIVATE int s_cmp(struct v7 *v7, val_t a, val_t b) {
   }
 }
 
+#if V7_ENABLE_STR_BUILDER
+
+/* Allocates an append buffer of `size` bytes holding a copy of `p` */
+static struct str_buf *str_buf_new(struct v7 *v7, const char *p, size_t len,
+                                   size_t size) {
+  struct str_buf *buf = (struct str_buf *) malloc(sizeof(*buf) + size);
+  if (buf == NULL) return NULL;
+  buf->size = size;
+  buf->len = len;
+  buf->marked = 0;
+  memcpy(buf->data, p, len);
+  buf->data[len] = '\0';
+  buf->next = v7->str_bufs;
+  v7->str_bufs = buf;
+  v7->gc_allocated += size;
+  return buf;
+}
+
+/*
+ * Concatenate strings through an append buffer, if `a` is the most recently
+ * allocated owned string (the likely result of the previous concatenation),
+ * or if it already lives at the end of an append buffer. Returns 0 if `a`
+ * is neither.
+ */
+static int s_concat_buf(struct v7 *v7, val_t a, const char *a_ptr,
+                        size_t a_len, const char *b_ptr, size_t b_len,
+                        val_t *res) {
+  struct mbuf *m = &v7->owned_strings;
+  const char *s = m->buf + gc_string_val_to_offset(a);
+  struct str_buf *buf = NULL;
+  struct str_buf_ref ref;
+
+  if (STR_BUF_IS_REF(s)) {
+    memcpy(&ref, s + 2 + STR_META_SIZE, sizeof(ref));
+    if (ref.len == ref.buf->len && ref.buf->size - ref.buf->len > b_len) {
+      buf = ref.buf;
+    }
+  } else if (a_ptr + a_len + 1 != m->buf + m->len) {
+    return 0;
+  }
+
+  if (buf == NULL &&
+      (buf = str_buf_new(v7, a_ptr, a_len, (a_len + b_len) * 2 + 1)) == NULL) {
+    return 0;
+  }
+
+  /* `b` may be a prefix of the same buffer, but never overlaps the tail */
+  memcpy(buf->data + buf->len, b_ptr, b_len);
+  buf->len += b_len;
+  buf->data[buf->len] = '\0';
+
+  /* Allocating the reference may relocate `a_ptr` and `b_ptr` */
+  ref.buf = buf;
+  ref.len = buf->len;
+  *res = v7_mk_string(v7, NULL, sizeof(ref) + 1, 1);
+  s = m->buf + gc_string_val_to_offset(*res);
+  ((uint8_t *) s)[0] = 0x80 | sizeof(ref);
+  ((uint8_t *) s)[1] = 0;
+  memset((char *) s + 2, 0, STR_META_SIZE);
+  memcpy((char *) s + 2 + STR_META_SIZE, &ref, sizeof(ref));
+
+  return 1;
+}
+
+/*
+ * Returns the data of the reference `ref` stored at `p`. A string that is
+ * no longer the longest one in its buffer has lost its NUL terminator to
+ * later appends, so it first gets a buffer of its own: that doesn't move any
+ * owned string, so pointers returned by `v7_get_string()` stay valid.
+ */
+static const char *str_buf_data(struct v7 *v7, struct str_buf_ref *ref,
+                                char *p) {
+  if (ref->len != ref->buf->len) {
+    struct str_buf *buf =
+        str_buf_new(v7, ref->buf->data, ref->len, ref->len + 1);
+    if (buf != NULL) {
+      ref->buf = buf;
+      memcpy(p, ref, sizeof(*ref));
+    }
+  }
+  return ref->buf->data;
+}
+
+V7_PRIVATE void str_buf_mark(const char *s) {
+  if (STR_BUF_IS_REF(s)) {
+    struct str_buf_ref ref;
+    memcpy(&ref, s + 2 + STR_META_SIZE, sizeof(ref));
+    ref.buf->marked = 1;
+  }
+}
+
+V7_PRIVATE void str_buf_sweep(struct v7 *v7, int all) {
+  struct str_buf **pp = &v7->str_bufs;
+
+  while (*pp != NULL) {
+    struct str_buf *buf = *pp;
+    if (buf->marked && !all) {
+      buf->marked = 0;
+      v7->gc_live += buf->size;
+      pp = &buf->next;
+    } else {
+      *pp = buf->next;
+      free(buf);
+    }
+  }
+}
+
+#endif /* V7_ENABLE_STR_BUILDER */
+
+V7_PRIVATE uint32_t str_hash(const char *s, size_t len) {
+  uint32_t h = 2166136261u;
+  while (len-- > 0) {
+    h ^= (unsigned char) *s++;
+    h *= 16777619u;
+  }
+  return h;
+}
+
+/* Returns the metadata of a string value, computing it if needed */
+static uint8_t str_val_meta(struct v7 *v7, val_t *v, uint32_t *hash) {
+  uint8_t flags = STR_META_VALID | STR_META_ASCII;
+  char *meta = NULL;
+  const char *p;
+  size_t len, i;
+
+#if !V7_DISABLE_STR_META
+  if ((*v & V7_TAG_MASK) == V7_TAG_STRING_O) {
+    int llen;
+    meta = v7->owned_strings.buf + gc_string_val_to_offset(*v);
+    decode_varint((uint8_t *) meta, &llen);
+    meta += llen;
+    if (meta[0] & STR_META_VALID) {
+      memcpy(hash, meta + 1, sizeof(*hash));
+      return meta[0];
+    }
+  }
+#endif
+
+  p = v7_get_string(v7, v, &len);
+  for (i = 0; i < len; i++) {
+    if (p[i] & 0x80) {
+      flags &= ~STR_META_ASCII;
+      break;
+    }
+  }
+  *hash = str_hash(p, len);
+
+  if (meta != NULL) {
+    meta[0] = flags;
+    memcpy(meta + 1, hash, sizeof(*hash));
+  }
+  return flags;
+}
+
+V7_PRIVATE uint32_t str_val_hash(struct v7 *v7, val_t *v) {
+  uint32_t hash;
+  str_val_meta(v7, v, &hash);
+  return hash;
+}
+
+V7_PRIVATE int str_val_is_ascii(struct v7 *v7, val_t *v) {
+  uint32_t hash;
+  return !!(str_val_meta(v7, v, &hash) & STR_META_ASCII);
+}
+
+/* Skips `n` characters, but not past the `end` */
+static const char *str_rune_shift(const char *p, const char *end, size_t n) {
+  Rune r;
+  for (; n > 0 && p < end; n--) {
+    if (*(unsigned char *) p < Runeself) {
+      p++;
+    } else if (fullrune(p, end - p)) {
+      p += chartorune(&r, p);
+    } else {
+      return end;
+    }
+  }
+  return p;
+}
+
+/*
+ * Returns the character index of the string value `v` (whose data is `p`),
+ * building it if needed, or NULL if the string doesn't need one.
+ */
+static struct str_rune_index *str_rune_index(struct v7 *v7, val_t *v,
+                                             const char *p, size_t len) {
+  struct str_rune_index *ri;
+  const char *q = p, *end = p + len;
+  size_t n;
+  int i;
+
+  if (len < V7_STR_RUNE_INDEX_MIN || (*v & V7_TAG_MASK) != V7_TAG_STRING_O ||
+      str_val_is_ascii(v7, v)) {
+    return NULL;
+  }
+
+  if (v7->rune_cache == NULL) {
+    v7->rune_cache = (struct str_rune_index *) calloc(
+        V7_STR_RUNE_CACHE_SIZE, sizeof(*v7->rune_cache));
+    if (v7->rune_cache == NULL) return NULL;
+    for (i = 0; i < V7_STR_RUNE_CACHE_SIZE; i++) {
+      v7->rune_cache[i].s = V7_UNDEFINED;
+    }
+  }
+  for (i = 0; i < V7_STR_RUNE_CACHE_SIZE; i++) {
+    if (v7->rune_cache[i].s == *v) return &v7->rune_cache[i];
+  }
+
+  ri = &v7->rune_cache[v7->rune_cache_next];
+  v7->rune_cache_next = (v7->rune_cache_next + 1) % V7_STR_RUNE_CACHE_SIZE;
+  ri->s = V7_UNDEFINED;
+  free(ri->offsets);
+  ri->offsets = (size_t *) malloc((len / V7_STR_RUNE_STEP + 1) * sizeof(size_t));
+  if (ri->offsets == NULL) return NULL;
+
+  for (n = 0; q < end; n++) {
+    if (n % V7_STR_RUNE_STEP == 0) {
+      ri->offsets[n / V7_STR_RUNE_STEP] = q - p;
+    }
+    q = str_rune_shift(q, end, 1);
+  }
+  ri->runes = n;
+  ri->s = *v;
+  return ri;
+}
+
+V7_PRIVATE size_t str_val_runes(struct v7 *v7, val_t *v) {
+  struct str_rune_index *ri;
+  size_t len;
+  const char *p = v7_get_string(v7, v, &len);
+
+  if (str_val_is_ascii(v7, v)) {
+    return len;
+  } else if ((ri = str_rune_index(v7, v, p, len)) != NULL) {
+    return ri->runes;
+  }
+  return utfnlen(p, len);
+}
+
+V7_PRIVATE const char *str_val_rune_ptr(struct v7 *v7, val_t *v, size_t idx) {
+  struct str_rune_index *ri;
+  size_t len;
+  const char *p = v7_get_string(v7, v, &len), *end = p + len;
+
+  if (str_val_is_ascii(v7, v)) {
+    return idx < len ? p + idx : end;
+  } else if ((ri = str_rune_index(v7, v, p, len)) != NULL) {
+    if (idx >= ri->runes) return end;
+    p += ri->offsets[idx / V7_STR_RUNE_STEP];
+    idx %= V7_STR_RUNE_STEP;
+  }
+  return str_rune_shift(p, end, idx);
+}
+
+V7_PRIVATE size_t str_val_rune_idx(struct v7 *v7, val_t *v, size_t off) {
+  struct str_rune_index *ri;
+  size_t len, base = 0;
+  const char *p = v7_get_string(v7, v, &len);
+
+  if (off > len) off = len;
+  if (str_val_is_ascii(v7, v)) {
+    return off;
+  } else if ((ri = str_rune_index(v7, v, p, len)) != NULL) {
+    /* find the last indexed character at or before `off` */
+    size_t lo = 0, hi = (ri->runes + V7_STR_RUNE_STEP - 1) / V7_STR_RUNE_STEP;
+    while (hi - lo > 1) {
+      size_t mid = lo + (hi - lo) / 2;
+      if (ri->offsets[mid] <= off) {
+        lo = mid;
+      } else {
+        hi = mid;
+      }
+    }
+    base = lo * V7_STR_RUNE_STEP;
+    p += ri->offsets[lo];
+    off -= ri->offsets[lo];
+  }
+  return base + utfnlen(p, off);
+}
+
+V7_PRIVATE void str_rune_cache_flush(struct v7 *v7) {
+  int i;
+  if (v7->rune_cache == NULL) return;
+  for (i = 0; i < V7_STR_RUNE_CACHE_SIZE; i++) {
+    v7->rune_cache[i].s = V7_UNDEFINED;
+    free(v7->rune_cache[i].offsets);
+    v7->rune_cache[i].offsets = NULL;
+  }
+}
+
+#if !V7_DISABLE_ATOMS
+
+static void atom_put(struct atom_slot *atoms, uint32_t cap, uint32_t hash,
+                     val_t v) {
+  uint32_t mask = cap - 1, i;
+  for (i = hash & mask; atoms[i].s != V7_UNDEFINED; i = (i + 1) & mask) {
+  }
+  atoms[i].hash = hash;
+  atoms[i].s = v;
+}
+
+/*
+ * Makes room for one more atom, keeping the load factor below 1/2. Returns 0
+ * if the table is full and can't grow.
+ */
+static int atom_reserve(struct v7 *v7) {
+  struct atom_slot *atoms;
+  uint32_t cap = v7->atoms_cap == 0 ? 64 : v7->atoms_cap * 2, i;
+
+  if ((v7->atoms_cnt + 1) * 2 <= v7->atoms_cap) {
+    return 1;
+  }
+
+  atoms = (struct atom_slot *) malloc(cap * sizeof(*atoms));
+  if (atoms == NULL) {
+    return v7->atoms_cnt + 1 < v7->atoms_cap;
+  }
+  for (i = 0; i < cap; i++) {
+    atoms[i].s = V7_UNDEFINED;
+  }
+  for (i = 0; i < v7->atoms_cap; i++) {
+    if (v7->atoms[i].s != V7_UNDEFINED) {
+      atom_put(atoms, cap, v7->atoms[i].hash, v7->atoms[i].s);
+    }
+  }
+  free(v7->atoms);
+  v7->atoms = atoms;
+  v7->atoms_cap = cap;
+  return 1;
+}
+
+/* Returns the slot of the atom with given contents, or the empty slot */
+static struct atom_slot *atom_lookup(struct v7 *v7, const char *s, size_t len,
+                                     uint32_t hash) {
+  uint32_t mask = v7->atoms_cap - 1, i;
+
+  for (i = hash & mask; v7->atoms[i].s != V7_UNDEFINED; i = (i + 1) & mask) {
+    if (v7->atoms[i].hash == hash) {
+      size_t n;
+      const char *p = v7_get_string(v7, &v7->atoms[i].s, &n);
+      if (n == len && memcmp(p, s, len) == 0) break;
+    }
+  }
+  return &v7->atoms[i];
+}
+
+V7_PRIVATE val_t atom_find(struct v7 *v7, const char *s, size_t len,
+                           uint32_t hash) {
+  int dict_index;
+
+  if (v7->atoms_cap > 0) {
+    struct atom_slot *slot = atom_lookup(v7, s, len, hash);
+    if (slot->s != V7_UNDEFINED) {
+      return slot->s;
+    }
+  }
+  if ((dict_index = v_find_string_in_dictionary(s, len)) >= 0) {
+    /* cannot be owned, so `v7_mk_string()` doesn't allocate */
+    return v7_mk_string(v7, s, len, 1);
+  }
+  return V7_UNDEFINED;
+}
+
+V7_PRIVATE val_t atom_intern(struct v7 *v7, val_t v) {
+  struct atom_slot *slot;
+  uint32_t hash;
+  size_t len;
+  const char *s;
+
+  if ((v & V7_TAG_MASK) != V7_TAG_STRING_O) {
+    return v;
+  }
+
+  s = v7_get_string(v7, &v, &len);
+  if (len <= 5 || v_find_string_in_dictionary(s, len) >= 0) {
+    /* e.g. a result of concatenation; the canonical string is not owned */
+    return v7_mk_string(v7, s, len, 1);
+  }
+
+  hash = str_val_hash(v7, &v);
+  if (v7->atoms_cap > 0) {
+    slot = atom_lookup(v7, s, len, hash);
+    if (slot->s != V7_UNDEFINED) {
+      return slot->s;
+    }
+  }
+  if (atom_reserve(v7)) {
+    atom_put(v7->atoms, v7->atoms_cap, hash, v);
+    v7->atoms_cnt++;
+  }
+  return v;
+}
+
+V7_PRIVATE val_t atom_mk_string(struct v7 *v7, const char *s, size_t len) {
+  if (len > 5) {
+    val_t v = atom_find(v7, s, len, str_hash(s, len));
+    if (v != V7_UNDEFINED) {
+      return v;
+    }
+  }
+  return v7_mk_string(v7, s, len, 1);
+}
+
+V7_PRIVATE void atom_sweep(struct v7 *v7) {
+  uint32_t mask = v7->atoms_cap - 1, i, j, k, n;
+
+  for (n = 0; n < v7->atoms_cap; n++) {
+    /* the string is marked if the NUL terminator of the previous one is 1 */
+    while (v7->atoms[n].s != V7_UNDEFINED &&
+           v7->owned_strings.buf[gc_string_val_to_offset(v7->atoms[n].s) -
+                                 1] != 1) {
+      /*
+       * Backward shift deletion, see `obj_prop_index_del()`. Entries can
+       * only be moved to the already checked slots from the ones which are
+       * checked too.
+       */
+      i = n;
+      for (j = (i + 1) & mask; v7->atoms[j].s != V7_UNDEFINED;
+           j = (j + 1) & mask) {
+        k = v7->atoms[j].hash & mask;
+        if ((j > i && (k <= i || k > j)) || (j < i && k <= i && k > j)) {
+          v7->atoms[i] = v7->atoms[j];
+          i = j;
+        }
+      }
+      v7->atoms[i].s = V7_UNDEFINED;
+      v7->atoms_cnt--;
+    }
+  }
+
+  /* compaction will update the slots along with all the other references */
+  for (i = 0; i < v7->atoms_cap; i++) {
+    gc_mark_string(v7, &v7->atoms[i].s);
+  }
+}
+
+#else /* V7_DISABLE_ATOMS */
+
+V7_PRIVATE val_t atom_find(struct v7 *v7, const char *s, size_t len,
+                           uint32_t hash) {
+  (void) hash;
+  if (v_find_string_in_dictionary(s, len) >= 0) {
+    return v7_mk_string(v7, s, len, 1);
+  }
+  return V7_UNDEFINED;
+}
+
+V7_PRIVATE val_t atom_intern(struct v7 *v7, val_t v) {
+  (void) v7;
+  return v;
+}
+
+V7_PRIVATE val_t atom_mk_string(struct v7 *v7, const char *s, size_t len) {
+  return v7_mk_string(v7, s, len, 1);
+}
+
+V7_PRIVATE void atom_sweep(struct v7 *v7) {
+  (void) v7;
+}
+
+#endif /* V7_DISABLE_ATOMS */
+
 V7_PRIVATE val_t s_concat(struct v7 *v7, val_t a, val_t b) {
   size_t a_len, b_len, res_len;
   const char *a_ptr, *b_ptr, *res_ptr;
@@ -19219,6 +21761,14 @@ V7_PRIVATE val_t s_concat(struct v7 *v7, val_t a, val_t b) {
   a_ptr = v7_get_string(v7, &a, &a_len);
   b_ptr = v7_get_string(v7, &b, &b_len);
 
+#if V7_ENABLE_STR_BUILDER
+  if (a_len + b_len >= V7_STR_BUF_MIN_LEN &&
+      (a & V7_TAG_MASK) == V7_TAG_STRING_O &&
+      s_concat_buf(v7, a, a_ptr, a_len, b_ptr, b_len, &res)) {
+    return res;
+  }
+#endif
+
   /* Create an placeholder string */
   res = v7_mk_string(v7, NULL, a_len + b_len, 1);
 
@@ -19263,8 +21813,8 @@ V7_PRIVATE void embed_string(struct mbuf *m, size_t offset, const char *p,
   uint8_t p_backed_by_mbuf = p >= old_base && p < old_base + m->len;
   size_t n = (flags & EMBSTR_UNESCAPE) ? unescape(p, len, NULL) : len;
 
-  /* Calculate how many bytes length takes */
-  int k = calc_llen(n);
+  /* Calculate how many bytes length (and metadata) takes */
+  int k = calc_llen(n) + ((flags & EMBSTR_META) ? STR_META_SIZE : 0);
 
   /* total length: varing length + string len + zero-term */
   size_t tot_len = k + n + !!(flags & EMBSTR_ZERO_TERM);
@@ -19281,6 +21831,9 @@ V7_PRIVATE void embed_string(struct mbuf *m, size_t offset, const char *p,
 
   /* Write length */
   encode_varint(n, (unsigned char *) m->buf + offset);
+  if (flags & EMBSTR_META) {
+    memset(m->buf + offset + k - STR_META_SIZE, 0, STR_META_SIZE);
+  }
 
   /* Write string */
   if (p != 0) {
@@ -19329,19 +21882,26 @@ v7_val_t v7_mk_string(struct v7 *v7, const char *p, size_t len, int copy) {
     GET_VAL_NAN_PAYLOAD(offset)[0] = dict_index;
     tag = V7_TAG_STRING_D;
   } else if (copy) {
+    v7->gc_allocated += len;
     compute_need_gc(v7);
 
     /*
      * Before embedding new string, check if the reallocation is needed.  If
      * so, perform the reallocation by calling `mbuf_resize` manually, since we
-     * need to preallocate some extra space (`_V7_STRING_BUF_RESERVE`)
+     * need to preallocate some extra space: `_V7_STRING_BUF_RESERVE`, or the
+     * rest of the allocation budget, up to the current size.
      */
     if ((m->len + len) > m->size) {
+      size_t reserve = _V7_STRING_BUF_RESERVE;
+      if (v7->gc_budget > v7->gc_allocated + reserve) {
+        reserve = v7->gc_budget - v7->gc_allocated;
+        if (reserve > m->size) reserve = m->size;
+      }
       heapusage_dont_count(1);
-      mbuf_resize(m, m->len + len + _V7_STRING_BUF_RESERVE);
+      mbuf_resize(m, m->len + len + reserve);
       heapusage_dont_count(0);
     }
-    embed_string(m, m->len, p, len, EMBSTR_ZERO_TERM);
+    embed_string(m, m->len, p, len, EMBSTR_ZERO_TERM | EMBSTR_META);
     tag = V7_TAG_STRING_O;
 #if !V7_DISABLE_STR_ALLOC_SEQ
     /* TODO(imax): panic if offset >= 2^32. */
@@ -19408,7 +21968,15 @@ const char *v7_get_string(struct v7 *v7, val_t *v, size_t *sizep) {
 #endif
 
     size = decode_varint((uint8_t *) s, &llen);
-    p = s + llen;
+    p = s + llen + STR_META_SIZE;
+#if V7_ENABLE_STR_BUILDER
+    if (STR_BUF_IS_REF(s)) {
+      struct str_buf_ref ref;
+      memcpy(&ref, p, sizeof(ref));
+      size = ref.len;
+      p = str_buf_data(v7, &ref, (char *) p);
+    }
+#endif
   } else if (tag == V7_TAG_STRING_F) {
     /*
      * short foreign strings on <=32-bit machines can be encoded in a compact
@@ -19487,8 +22055,19 @@ static int v_sprintf_s(char *buf, size_t size, const char *fmt, ...) {
 
 v7_val_t v7_mk_array(struct v7 *v7) {
   val_t a = mk_object(v7, v7->vals.array_prototype);
-#if 0
+#if V7_ENABLE_DENSE_ARRAYS
+  v7_own(v7, &a);
   v7_def(v7, a, "", 0, _V7_DESC_HIDDEN(1), V7_NULL);
+
+  /*
+   * Before setting a `V7_OBJ_DENSE_ARRAY` flag, make sure we don't have
+   * `V7_OBJ_FUNCTION` flag set
+   */
+  assert(!(get_object_struct(a)->attributes & V7_OBJ_FUNCTION));
+  get_object_struct(a)->attributes |=
+      V7_OBJ_DENSE_ARRAY | V7_OBJ_NUMBER_ELEMENTS;
+
+  v7_disown(v7, &a);
 #endif
   return a;
 }
@@ -19498,37 +22077,112 @@ int v7_is_array(struct v7 *v7, val_t v) {
          is_prototype_of(v7, v, v7->vals.array_prototype);
 }
 
+V7_PRIVATE val_t v7_mk_dense_array(struct v7 *v7) {
+  return v7_mk_array(v7);
+}
+
+V7_PRIVATE int cstr_to_array_index(const char *s, size_t len,
+                                   unsigned long *res) {
+  unsigned long n = 0;
+  size_t i;
+
+  /* no leading zeros, and at most 4294967294 */
+  if (len == 0 || len > 10 || (s[0] == '0' && len > 1)) {
+    return 0;
+  }
+  for (i = 0; i < len; i++) {
+    if (s[i] < '0' || s[i] > '9') {
+      return 0;
+    }
+    n = n * 10 + (s[i] - '0');
+  }
+  if (n >= 4294967295UL) {
+    return 0;
+  }
+  *res = n;
+  return 1;
+}
+
+V7_PRIVATE int num_to_array_index(double d, unsigned long *res) {
+  if (d >= 0 && d < 4294967295.0 && d == (double) (unsigned long) d) {
+    *res = (unsigned long) d;
+    return 1;
+  }
+  return 0;
+}
+
 /*
- * Dense arrays are backed by mbuf. Currently the array can only grow by
- * appending (i.e. setting an element whose index == array.length)
+ * Dense arrays keep their elements in a contiguous vector of values, so that
+ * indexed access and `length` are O(1). The vector is an mbuf referenced by
+ * a foreign pointer from the hidden property with an empty name, and it is
+ * allocated on the first store. Array length is the length of the vector,
+ * and holes are marked with `V7_TAG_NOVALUE`. Properties with other names
+ * are ordinary properties of the array object.
  *
- * TODO(mkm): automatically promote dense arrays to normal objects
- *            when they are used as sparse arrays or to store arbitrary keys
- *            (perhaps a hybrid approach)
- * TODO(mkm): small sparsness doesn't have to promote the array,
- *            we can just fill empty slots with a tag. In JS missing array
- *            indices are subtly different from indices with an undefined value
- *            (key iteration).
- * TODO(mkm): change the interpreter so it can set elements in dense arrays
+ * Arrays which get too sparse, or elements with non-default attributes, are
+ * converted to ordinary objects with index-named properties, see
+ * `dense_array_to_sparse()`. They never get back to the dense representation.
  */
-V7_PRIVATE val_t v7_mk_dense_array(struct v7 *v7) {
-  val_t a = v7_mk_array(v7);
 #if V7_ENABLE_DENSE_ARRAYS
-  v7_own(v7, &a);
-  v7_def(v7, a, "", 0, _V7_DESC_HIDDEN(1), V7_NULL);
 
-  /*
-   * Before setting a `V7_OBJ_DENSE_ARRAY` flag, make sure we don't have
-   * `V7_OBJ_FUNCTION` flag set
-   */
-  assert(!(get_object_struct(a)->attributes & V7_OBJ_FUNCTION));
-  get_object_struct(a)->attributes |= V7_OBJ_DENSE_ARRAY;
+/* How many holes a single store may add to a dense array */
+#define DENSE_ARRAY_MAX_GAP 1024
 
-  v7_disown(v7, &a);
-#endif
-  return a;
+V7_PRIVATE struct mbuf *dense_array_buf(struct v7 *v7, val_t arr) {
+  struct v7_property *p = *obj_prop_list(get_object_struct(arr));
+  size_t len = 1;
+
+  /* the hidden property is normally the first one, see `obj_prop_link()` */
+  if (p != NULL && (p->attributes & _V7_PROPERTY_HIDDEN) &&
+      v7_is_string(p->name)) {
+    v7_get_string(v7, &p->name, &len);
+  }
+  if (len != 0) {
+    p = v7_get_own_property2(v7, arr, "", 0, _V7_PROPERTY_HIDDEN);
+  }
+  return p != NULL ? (struct mbuf *) v7_get_ptr(v7, p->value) : NULL;
+}
+
+V7_PRIVATE void dense_array_note_store(val_t arr, val_t v) {
+  if (!v7_is_number(v)) {
+    get_object_struct(arr)->attributes &= ~V7_OBJ_NUMBER_ELEMENTS;
+  }
+}
+
+V7_PRIVATE int dense_array_can_grow(unsigned long len, unsigned long new_len) {
+  return new_len <= len + DENSE_ARRAY_MAX_GAP || new_len / 2 <= len;
+}
+
+V7_PRIVATE void dense_array_set_length(struct v7 *v7, val_t arr,
+                                       unsigned long new_len) {
+  struct v7_property *p =
+      v7_get_own_property2(v7, arr, "", 0, _V7_PROPERTY_HIDDEN);
+  struct mbuf *abuf = (struct mbuf *) v7_get_ptr(v7, p->value);
+  size_t size = new_len * sizeof(val_t);
+
+  if (abuf == NULL) {
+    if (new_len == 0) return;
+    abuf = (struct mbuf *) malloc(sizeof(*abuf));
+    mbuf_init(abuf, size);
+    p->value = v7_mk_foreign(v7, abuf);
+  }
+
+  if (size > abuf->len) {
+    val_t *vp, *end;
+    if (size > abuf->size) {
+      size_t new_size = (size_t)(abuf->size * MBUF_SIZE_MULTIPLIER);
+      mbuf_resize(abuf, new_size > size ? new_size : size);
+    }
+    end = (val_t *) (abuf->buf + size);
+    for (vp = (val_t *) (abuf->buf + abuf->len); vp < end; vp++) {
+      *vp = V7_TAG_NOVALUE;
+    }
+  }
+  abuf->len = size;
 }
 
+#endif /* V7_ENABLE_DENSE_ARRAYS */
+
 /* TODO_V7_ERR */
 val_t v7_array_get(struct v7 *v7, val_t arr, unsigned long index) {
   return v7_array_get2(v7, arr, index, NULL);
@@ -19543,31 +22197,21 @@ val_t v7_array_get2(struct v7 *v7, val_t arr, unsigned long index, int *has) {
     *has = 0;
   }
   if (v7_is_object(arr)) {
+#if V7_ENABLE_DENSE_ARRAYS
     if (get_object_struct(arr)->attributes & V7_OBJ_DENSE_ARRAY) {
-      struct v7_property *p =
-          v7_get_own_property2(v7, arr, "", 0, _V7_PROPERTY_HIDDEN);
-      struct mbuf *abuf = NULL;
-      unsigned long len;
-      if (p != NULL) {
-        abuf = (struct mbuf *) v7_get_ptr(v7, p->value);
-      }
-      if (abuf == NULL) {
-        res = V7_UNDEFINED;
-        goto clean;
-      }
-      len = abuf->len / sizeof(val_t);
-      if (index >= len) {
-        res = V7_UNDEFINED;
-        goto clean;
-      } else {
-        memcpy(&res, abuf->buf + index * sizeof(val_t), sizeof(val_t));
-        if (has != NULL && res != V7_TAG_NOVALUE) *has = 1;
-        if (res == V7_TAG_NOVALUE) {
-          res = V7_UNDEFINED;
+      struct mbuf *abuf = dense_array_buf(v7, arr);
+      res = V7_UNDEFINED;
+      if (abuf != NULL && index < abuf->len / sizeof(val_t)) {
+        val_t v = ((val_t *) abuf->buf)[index];
+        if (v != V7_TAG_NOVALUE) {
+          res = v;
+          if (has != NULL) *has = 1;
         }
-        goto clean;
       }
-    } else {
+      goto clean;
+    } else
+#endif
+    {
       struct v7_property *p;
       char buf[20];
       int n = v_sprintf_s(buf, sizeof(buf), "%lu", index);
@@ -19587,100 +22231,47 @@ clean:
 }
 
 #if V7_ENABLE_DENSE_ARRAYS
-
-/* Create V7 strings for integers such as array indices */
-static val_t ulong_to_str(struct v7 *v7, unsigned long n) {
-  char buf[100];
-  int len;
-  len = c_snprintf(buf, sizeof(buf), "%lu", n);
-  return v7_mk_string(v7, buf, len, 1);
+V7_PRIVATE int dense_array_get_fast(struct v7 *v7, val_t arr, val_t name,
+                                    val_t *res) {
+  unsigned long index;
+  int has = 0;
+  if (v7_is_number(name) && v7_is_object(arr) &&
+      (get_object_struct(arr)->attributes & V7_OBJ_DENSE_ARRAY) &&
+      num_to_array_index(v7_get_double(v7, name), &index)) {
+    *res = v7_array_get2(v7, arr, index, &has);
+  }
+  return has;
 }
 
-/*
- * Pack 15-bit length and 15 bit index, leaving 2 bits for tag. the LSB has to
- * be set to distinguish it from a prop pointer.
- * In alternative we just fetch the length from obj at each call to v7_next_prop
- * and just stuff the index here (e.g. on 8/16-bit platforms).
- * TODO(mkm): conditional for 16-bit platforms
- */
-#define PACK_ITER(len, idx) \
-  ((struct v7_property *) ((len) << 17 | (idx) << 1 | 1))
-
-#define UNPACK_ITER_LEN(p) (((uintptr_t) p) >> 17)
-#define UNPACK_ITER_IDX(p) ((((uintptr_t) p) >> 1) & 0x7FFF)
-#define IS_PACKED_ITER(p) ((uintptr_t) p & 1)
+V7_PRIVATE int dense_array_set_fast(struct v7 *v7, val_t arr, val_t name,
+                                    val_t v) {
+  unsigned long index, len;
+  struct mbuf *abuf;
+  val_t *vp;
 
-void *v7_next_prop(struct v7 *v7, val_t obj, void *h, val_t *name, val_t *val,
-                   v7_prop_attr_t *attrs) {
-  struct v7_property *p = (struct v7_property *) h;
+  if (!v7_is_number(name) || !v7_is_object(arr) ||
+      !(get_object_struct(arr)->attributes & V7_OBJ_DENSE_ARRAY) ||
+      !num_to_array_index(v7_get_double(v7, name), &index) ||
+      (abuf = dense_array_buf(v7, arr)) == NULL) {
+    return 0;
+  }
 
-  if (get_object_struct(obj)->attributes & V7_OBJ_DENSE_ARRAY) {
-    /* This is a dense array. Find backing mbuf and fetch values from there */
-    struct v7_property *hp =
-        v7_get_own_property2(v7, obj, "", 0, _V7_PROPERTY_HIDDEN);
-    struct mbuf *abuf = NULL;
-    unsigned long len, idx;
-    if (hp != NULL) {
-      abuf = (struct mbuf *) v7_get_ptr(v7, hp->value);
-    }
-    if (abuf == NULL) return NULL;
-    len = abuf->len / sizeof(val_t);
-    if (len == 0) return NULL;
-    idx = (p == NULL) ? 0 : UNPACK_ITER_IDX(p) + 1;
-    p = (idx == len) ? get_object_struct(obj)->properties : PACK_ITER(len, idx);
-    if (val != NULL) *val = ((val_t *) abuf->buf)[idx];
-    if (attrs != NULL) *attrs = 0;
-    if (name != NULL) {
-      char buf[20];
-      int n = v_sprintf_s(buf, sizeof(buf), "%lu", index);
-      *name = v7_mk_string(v7, buf, n, 1);
+  len = abuf->len / sizeof(val_t);
+  if (index < len) {
+    vp = (val_t *) abuf->buf + index;
+    if (*vp == V7_TAG_NOVALUE &&
+        (get_object_struct(arr)->attributes & V7_OBJ_NOT_EXTENSIBLE)) {
+      return 0;
     }
+    *vp = v;
+  } else if (index == len &&
+             !(get_object_struct(arr)->attributes & V7_OBJ_NOT_EXTENSIBLE)) {
+    mbuf_append(abuf, (char *) &v, sizeof(v));
   } else {
-    /* Ordinary object */
-    p = (p == NULL) ? get_object_struct(obj)->properties : p->next;
-    if (p != NULL) {
-      if (name != NULL) *name = p->name;
-      if (val != NULL) *val = p->value;
-      if (attrs != NULL) *attrs = p->attributes;
-    }
-  }
-
-  return p;
-}
-
-V7_PRIVATE val_t
-v7_iter_get_value(struct v7 *v7, val_t obj, struct v7_property *p) {
-  return IS_PACKED_ITER(p) ? v7_array_get(v7, obj, UNPACK_ITER_IDX(p))
-                           : p->value;
-}
-
-V7_PRIVATE val_t v7_iter_get_name(struct v7 *v7, struct v7_property *p) {
-  return IS_PACKED_ITER(p) ? ulong_to_str(v7, UNPACK_ITER_IDX(p)) : p->name;
-}
-
-V7_PRIVATE uint8_t v7_iter_get_attrs(struct v7_property *p) {
-  return IS_PACKED_ITER(p) ? 0 : p->attributes;
-}
-
-/* return array index as number or undefined. works with iterators */
-V7_PRIVATE enum v7_err v7_iter_get_index(struct v7 *v7, struct v7_property *p,
-                                         val_t *res) {
-  enum v7_err rcode = V7_OK;
-  int ok;
-  unsigned long res;
-  if (IS_PACKED_ITER(p)) {
-    *res = v7_mk_number(v7, UNPACK_ITER_IDX(p));
-    goto clean;
-  }
-  V7_TRY(str_to_ulong(v7, p->name, &ok, &res));
-  if (!ok || res >= UINT32_MAX) {
-    goto clean;
+    return 0;
   }
-  *res = v7_mk_number(v7, res);
-  goto clean;
-
-clean:
-  return rcode;
+  dense_array_note_store(arr, v);
+  return 1;
 }
 #endif
 
@@ -19697,19 +22288,8 @@ unsigned long v7_array_length(struct v7 *v7, val_t v) {
 
 #if V7_ENABLE_DENSE_ARRAYS
   if (get_object_struct(v)->attributes & V7_OBJ_DENSE_ARRAY) {
-    struct v7_property *p =
-        v7_get_own_property2(v7, v, "", 0, _V7_PROPERTY_HIDDEN);
-    struct mbuf *abuf;
-    if (p == NULL) {
-      len = 0;
-      goto clean;
-    }
-    abuf = (struct mbuf *) v7_get_ptr(v7, p->value);
-    if (abuf == NULL) {
-      len = 0;
-      goto clean;
-    }
-    len = abuf->len / sizeof(val_t);
+    struct mbuf *abuf = dense_array_buf(v7, v);
+    len = abuf != NULL ? abuf->len / sizeof(val_t) : 0;
     goto clean;
   }
 #endif
@@ -19754,45 +22334,37 @@ enum v7_err v7_array_set_throwing(struct v7 *v7, val_t arr, unsigned long index,
   int ires = -1;
 
   if (v7_is_object(arr)) {
-    if (get_object_struct(arr)->attributes & V7_OBJ_DENSE_ARRAY) {
-      struct v7_property *p =
-          v7_get_own_property2(v7, arr, "", 0, _V7_PROPERTY_HIDDEN);
-      struct mbuf *abuf;
-      unsigned long len;
-      assert(p != NULL);
-      abuf = (struct mbuf *) v7_get_ptr(v7, p->value);
-
-      if (get_object_struct(arr)->attributes & V7_OBJ_NOT_EXTENSIBLE) {
+#if V7_ENABLE_DENSE_ARRAYS
+    struct v7_object *o = get_object_struct(arr);
+    if (o->attributes & V7_OBJ_DENSE_ARRAY) {
+      struct mbuf *abuf = dense_array_buf(v7, arr);
+      unsigned long len = abuf != NULL ? abuf->len / sizeof(val_t) : 0;
+
+      if ((index >= len || ((val_t *) abuf->buf)[index] == V7_TAG_NOVALUE) &&
+          (o->attributes & V7_OBJ_NOT_EXTENSIBLE)) {
+        /* new elements can't be added */
         if (is_strict_mode(v7)) {
           rcode = v7_throwf(v7, TYPE_ERROR, "Object is not extensible");
-          goto clean;
         }
-
         goto clean;
       }
 
-      if (abuf == NULL) {
-        abuf = (struct mbuf *) malloc(sizeof(*abuf));
-        mbuf_init(abuf, sizeof(val_t) * (index + 1));
-        p->value = v7_mk_foreign(v7, abuf);
-      }
-      len = abuf->len / sizeof(val_t);
-      /* TODO(mkm): possibly promote to sparse array */
-      if (index > len) {
-        unsigned long i;
-        val_t s = V7_TAG_NOVALUE;
-        for (i = len; i < index; i++) {
-          mbuf_append(abuf, (char *) &s, sizeof(val_t));
+      if (index >= len) {
+        if (!dense_array_can_grow(len, index + 1)) {
+          dense_array_to_sparse(v7, arr);
+          goto sparse;
         }
-        len = index;
+        dense_array_set_length(v7, arr, index + 1);
+        abuf = dense_array_buf(v7, arr);
       }
-
-      if (index == len) {
-        mbuf_append(abuf, (char *) &v, sizeof(val_t));
-      } else {
-        memcpy(abuf->buf + index * sizeof(val_t), &v, sizeof(val_t));
-      }
-    } else {
+      ((val_t *) abuf->buf)[index] = v;
+      dense_array_note_store(arr, v);
+      ires = 0;
+      goto clean;
+    }
+  sparse:
+#endif
+    {
       char buf[20];
       int n = v_sprintf_s(buf, sizeof(buf), "%lu", index);
       {
@@ -19817,6 +22389,22 @@ void v7_array_del(struct v7 *v7, val_t arr, unsigned long index) {
   char buf[20];
   int n = v_sprintf_s(buf, sizeof(buf), "%lu", index);
   v7_del(v7, arr, buf, n);
+
+#if V7_ENABLE_DENSE_ARRAYS
+  /*
+   * Like for sparse arrays, length of the array is defined by its last
+   * element, so that deleting the last element pops it.
+   */
+  if (v7_is_object(arr) &&
+      (get_object_struct(arr)->attributes & V7_OBJ_DENSE_ARRAY)) {
+    struct mbuf *abuf = dense_array_buf(v7, arr);
+    while (abuf != NULL && abuf->len > 0 &&
+           *(val_t *) (abuf->buf + abuf->len - sizeof(val_t)) ==
+               V7_TAG_NOVALUE) {
+      abuf->len -= sizeof(val_t);
+    }
+  }
+#endif
 }
 
 int v7_array_push(struct v7 *v7, v7_val_t arr, v7_val_t v) {
@@ -19944,13 +22532,345 @@ V7_PRIVATE struct v7_property *v7_mk_property(struct v7 *v7) {
   return p;
 }
 
+/*
+ * Whether the property name can only be equal to the same `val_t`, see
+ * `atom_intern()`.
+ */
+static int prop_name_is_canonical(val_t name) {
+  uint64_t tag = name & V7_TAG_MASK;
+#if V7_DISABLE_ATOMS
+  if (tag == V7_TAG_STRING_O) return 0;
+#endif
+  return tag != V7_TAG_STRING_F;
+}
+
+/*
+ * Property index {{{
+ *
+ * Property list is the only storage of object properties: GC, iteration,
+ * freezing and a lot of other code walk it directly. For large objects (global
+ * object, prototypes, big configuration objects) linear lookups get
+ * expensive though, so once an object gets `V7_PROP_INDEX_MIN` properties,
+ * an open-addressing hash table mapping property names to property cells is
+ * built for it.
+ *
+ * The table is kept in the value of a hidden property with the
+ * `_V7_PROPERTY_INDEX` attribute, which always sits at the head of the list.
+ * Its memory is released by the property arena destructor, together with the
+ * property itself.
+ */
+
+#if !V7_DISABLE_PROP_INDEX
+
+struct prop_index_slot {
+  uint32_t hash;
+  struct v7_property *p; /* NULL for empty slot */
+};
+
+struct prop_index {
+  uint32_t cap; /* power of 2 */
+  uint32_t cnt;
+  struct prop_index_slot slots[1];
+};
+
+static struct prop_index *obj_prop_index(struct v7 *v7, struct v7_object *o) {
+  if (o->properties != NULL &&
+      (o->properties->attributes & _V7_PROPERTY_INDEX)) {
+    return (struct prop_index *) v7_get_ptr(v7, o->properties->value);
+  }
+  return NULL;
+}
+
+static struct prop_index *prop_index_alloc(uint32_t cap) {
+  struct prop_index *idx = (struct prop_index *) calloc(
+      1, sizeof(*idx) + (cap - 1) * sizeof(struct prop_index_slot));
+  if (idx != NULL) {
+    idx->cap = cap;
+  }
+  return idx;
+}
+
+static void prop_index_put(struct prop_index *idx, uint32_t hash,
+                           struct v7_property *p) {
+  uint32_t mask = idx->cap - 1, i;
+  for (i = hash & mask; idx->slots[i].p != NULL; i = (i + 1) & mask) {
+  }
+  idx->slots[i].hash = hash;
+  idx->slots[i].p = p;
+  idx->cnt++;
+}
+
+/*
+ * Makes room for one more entry, keeping the load factor below 1/2. Returns
+ * the index which might have been reallocated, or NULL if out of memory.
+ */
+static struct prop_index *prop_index_reserve(struct v7 *v7,
+                                             struct v7_object *o,
+                                             struct prop_index *idx) {
+  struct prop_index *nidx;
+  uint32_t i;
+
+  if ((idx->cnt + 1) * 2 <= idx->cap) {
+    return idx;
+  }
+
+  nidx = prop_index_alloc(idx->cap * 2);
+  if (nidx == NULL) {
+    return NULL;
+  }
+  for (i = 0; i < idx->cap; i++) {
+    if (idx->slots[i].p != NULL) {
+      prop_index_put(nidx, idx->slots[i].hash, idx->slots[i].p);
+    }
+  }
+  free(idx);
+  o->properties->value = v7_mk_foreign(v7, nidx);
+  return nidx;
+}
+
+/* Creates the index property for the object */
+static void obj_prop_index_build(struct v7 *v7, struct v7_object *o) {
+  struct v7_property *ip, *p;
+  struct prop_index *idx;
+  uint32_t cap = 32;
+  size_t n = 0;
+
+  for (p = o->properties; p != NULL; p = p->next) {
+    n++;
+  }
+  while (cap < n * 2) {
+    cap *= 2;
+  }
+  if ((idx = prop_index_alloc(cap)) == NULL) {
+    return;
+  }
+
+  /* might invoke GC, but all the properties are reachable via `o` */
+  ip = v7_mk_property(v7);
+  ip->attributes = _V7_PROPERTY_INDEX | _V7_PROPERTY_HIDDEN;
+  ip->value = v7_mk_foreign(v7, idx);
+
+  for (p = o->properties; p != NULL; p = p->next) {
+    if (v7_is_string(p->name)) {
+      prop_index_put(idx, str_val_hash(v7, &p->name), p);
+    }
+  }
+
+  ip->next = o->properties;
+  o->properties = ip;
+}
+
+/* `ss` is the canonical name, if any, see `v7_get_own_property2()` */
+static struct v7_property *obj_prop_index_find(struct v7 *v7,
+                                               struct prop_index *idx,
+                                               const char *name, size_t len,
+                                               uint32_t hash, val_t ss) {
+  uint32_t mask = idx->cap - 1, i;
+
+  for (i = hash & mask; idx->slots[i].p != NULL; i = (i + 1) & mask) {
+    struct v7_property *p = idx->slots[i].p;
+    if (idx->slots[i].hash != hash) continue;
+    if (len <= 5) {
+      if (p->name == ss) return p;
+    } else if (ss != V7_UNDEFINED && p->name == ss) {
+      return p;
+    } else if (!prop_name_is_canonical(p->name)) {
+      size_t n;
+      const char *s = v7_get_string(v7, &p->name, &n);
+      if (n == len && strncmp(s, name, len) == 0) return p;
+    }
+  }
+  return NULL;
+}
+
+V7_PRIVATE void obj_prop_index_add(struct v7 *v7, struct v7_object *o,
+                                   struct v7_property *p) {
+  struct prop_index *idx = obj_prop_index(v7, o);
+
+  if (idx == NULL || !v7_is_string(p->name)) return;
+
+  if ((idx = prop_index_reserve(v7, o, idx)) != NULL) {
+    prop_index_put(idx, str_val_hash(v7, &p->name), p);
+  }
+}
+
+V7_PRIVATE void obj_prop_index_del(struct v7 *v7, struct v7_object *o,
+                                   struct v7_property *p) {
+  struct prop_index *idx = obj_prop_index(v7, o);
+  uint32_t mask, i, j, k;
+
+  if (idx == NULL || !v7_is_string(p->name)) return;
+
+  mask = idx->cap - 1;
+  for (i = str_val_hash(v7, &p->name) & mask; idx->slots[i].p != p;
+       i = (i + 1) & mask) {
+    if (idx->slots[i].p == NULL) return;
+  }
+
+  /*
+   * Backward shift deletion: move up the entries which would become
+   * unreachable after the slot `i` is emptied.
+   */
+  for (j = (i + 1) & mask; idx->slots[j].p != NULL; j = (j + 1) & mask) {
+    k = idx->slots[j].hash & mask;
+    if ((j > i && (k <= i || k > j)) || (j < i && k <= i && k > j)) {
+      idx->slots[i] = idx->slots[j];
+      i = j;
+    }
+  }
+  idx->slots[i].p = NULL;
+  idx->cnt--;
+}
+
+V7_PRIVATE void obj_prop_index_free(struct v7 *v7, struct v7_property *p) {
+  if (p->attributes & _V7_PROPERTY_INDEX) {
+    free(v7_get_ptr(v7, p->value));
+    p->value = V7_UNDEFINED;
+  }
+}
+
+V7_PRIVATE struct v7_property **obj_prop_list(struct v7_object *o) {
+  if (o->properties != NULL &&
+      (o->properties->attributes & _V7_PROPERTY_INDEX)) {
+    return &o->properties->next;
+  }
+  return &o->properties;
+}
+
+#else /* V7_DISABLE_PROP_INDEX */
+
+V7_PRIVATE void obj_prop_index_add(struct v7 *v7, struct v7_object *o,
+                                   struct v7_property *p) {
+  (void) v7;
+  (void) o;
+  (void) p;
+}
+
+V7_PRIVATE void obj_prop_index_del(struct v7 *v7, struct v7_object *o,
+                                   struct v7_property *p) {
+  (void) v7;
+  (void) o;
+  (void) p;
+}
+
+V7_PRIVATE void obj_prop_index_free(struct v7 *v7, struct v7_property *p) {
+  (void) v7;
+  (void) p;
+}
+
+V7_PRIVATE struct v7_property **obj_prop_list(struct v7_object *o) {
+  return &o->properties;
+}
+
+#endif /* V7_DISABLE_PROP_INDEX */
+
+/*
+ * Links a newly created property into the object's property list, and keeps
+ * the property index up to date.
+ */
+static void obj_prop_link(struct v7 *v7, struct v7_object *o,
+                          struct v7_property *p) {
+  struct v7_property **head = obj_prop_list(o);
+#if !V7_DISABLE_PROP_INDEX
+  int indexed = (head != &o->properties);
+#endif
+
+  /* lookups rely on owned names being atoms, see `v7_get_own_property2()` */
+  p->name = atom_intern(v7, p->name);
+
+#if V7_ENABLE_DENSE_ARRAYS
+  /* elements of dense arrays stay in front, see `dense_array_buf()` */
+  if ((o->attributes & V7_OBJ_DENSE_ARRAY) && *head != NULL &&
+      ((*head)->attributes & _V7_PROPERTY_HIDDEN)) {
+    head = &(*head)->next;
+  }
+#endif
+
+  p->next = *head;
+  *head = p;
+
+  if (o->attributes & (V7_OBJ_PROTOTYPE | V7_OBJ_OFF_HEAP)) {
+    /* might shadow some property cached further up the prototype chain */
+    bcode_ic_invalidate(v7);
+  }
+
+#if !V7_DISABLE_PROP_INDEX
+  if (indexed) {
+    obj_prop_index_add(v7, o, p);
+  } else if (!(o->attributes & V7_OBJ_OFF_HEAP)) {
+    size_t n = 0;
+    for (p = o->properties; p != NULL && n < V7_PROP_INDEX_MIN; p = p->next) {
+      n++;
+    }
+    if (n == V7_PROP_INDEX_MIN) {
+      obj_prop_index_build(v7, o);
+    }
+  }
+#endif
+}
+
+/* }}} Property index */
+
+#if V7_ENABLE_DENSE_ARRAYS
+V7_PRIVATE void dense_array_to_sparse(struct v7 *v7, val_t arr) {
+  struct v7_object *o = get_object_struct(arr);
+  struct mbuf *abuf;
+  val_t name = V7_UNDEFINED;
+  unsigned long i, len;
+
+  if (!(o->attributes & V7_OBJ_DENSE_ARRAY)) {
+    return;
+  }
+
+  v7_own(v7, &arr);
+  v7_own(v7, &name);
+
+  /*
+   * Elements are linked as properties while the array is still dense, so that
+   * the values stay reachable for the GC which can be invoked by allocations.
+   */
+  abuf = dense_array_buf(v7, arr);
+  len = abuf != NULL ? abuf->len / sizeof(val_t) : 0;
+  for (i = 0; i < len; i++) {
+    struct v7_property *p;
+    char buf[20];
+    int n;
+
+    if (((val_t *) abuf->buf)[i] == V7_TAG_NOVALUE) {
+      continue;
+    }
+    n = c_snprintf(buf, sizeof(buf), "%lu", i);
+    name = v7_mk_string(v7, buf, n, 1);
+    if ((p = v7_mk_property(v7)) == NULL) {
+      break; /* LCOV_EXCL_LINE */
+    }
+    p->name = name;
+    /* GC might have relocated the string value */
+    p->value = ((val_t *) abuf->buf)[i];
+    p->attributes = V7_DEFAULT_PROPERTY_ATTRS;
+    obj_prop_link(v7, o, p);
+  }
+
+  o->attributes &= ~(V7_OBJ_DENSE_ARRAY | V7_OBJ_NUMBER_ELEMENTS);
+  if (abuf != NULL) {
+    mbuf_free(abuf);
+    free(abuf);
+  }
+  v7_del(v7, arr, "", 0);
+
+  v7_disown(v7, &name);
+  v7_disown(v7, &arr);
+}
+#endif
+
 V7_PRIVATE struct v7_property *v7_get_own_property2(struct v7 *v7, val_t obj,
                                                     const char *name,
                                                     size_t len,
                                                     v7_prop_attr_t attrs) {
   struct v7_property *p;
   struct v7_object *o;
-  val_t ss;
+  val_t ss = V7_UNDEFINED;
+  uint32_t hash = 0;
   if (!v7_is_object(obj)) {
     return NULL;
   }
@@ -19965,16 +22885,36 @@ V7_PRIVATE struct v7_property *v7_get_own_property2(struct v7 *v7, val_t obj,
    * a zero length string anyway, so this will change.
    */
   if (o->attributes & V7_OBJ_DENSE_ARRAY && len > 0) {
-    int ok, has;
-    unsigned long i = cstr_to_ulong(name, len, &ok);
-    if (ok) {
+    int has;
+    unsigned long i;
+    if (cstr_to_array_index(name, len, &i)) {
       v7->cur_dense_prop->value = v7_array_get2(v7, obj, i, &has);
       return has ? v7->cur_dense_prop : NULL;
     }
   }
 
+  /*
+   * Most names are canonical (see `prop_name_is_canonical()`): short ones are
+   * inlined, and the longer ones are either dictionary strings or atoms.
+   */
   if (len <= 5) {
     ss = v7_mk_string(v7, name, len, 1);
+  } else {
+    hash = str_hash(name, len);
+    ss = atom_find(v7, name, len, hash);
+  }
+
+#if !V7_DISABLE_PROP_INDEX
+  if (attrs == 0) {
+    struct prop_index *idx = obj_prop_index(v7, o);
+    if (idx != NULL) {
+      if (len <= 5) hash = str_hash(name, len);
+      return obj_prop_index_find(v7, idx, name, len, hash, ss);
+    }
+  }
+#endif
+
+  if (len <= 5) {
     for (p = o->properties; p != NULL; p = p->next) {
 #if V7_ENABLE_ENTITY_IDS
       if (p->entity_id != V7_ENTITY_ID_PROP) {
@@ -19989,15 +22929,24 @@ V7_PRIVATE struct v7_property *v7_get_own_property2(struct v7 *v7, val_t obj,
   } else {
     for (p = o->properties; p != NULL; p = p->next) {
       size_t n;
-      const char *s = v7_get_string(v7, &p->name, &n);
+      const char *s;
 #if V7_ENABLE_ENTITY_IDS
       if (p->entity_id != V7_ENTITY_ID_PROP) {
         fprintf(stderr, "not a prop!=0x%x\n", p->entity_id);
         abort();
       }
 #endif
-      if (n == len && strncmp(s, name, len) == 0 &&
-          (attrs == 0 || (p->attributes & attrs))) {
+      if (attrs != 0 && !(p->attributes & attrs)) {
+        continue;
+      }
+      if (ss != V7_UNDEFINED && p->name == ss) {
+        return p;
+      }
+      if (prop_name_is_canonical(p->name)) {
+        continue;
+      }
+      s = v7_get_string(v7, &p->name, &n);
+      if (n == len && strncmp(s, name, len) == 0) {
         return p;
       }
     }
@@ -20025,6 +22974,7 @@ V7_PRIVATE struct v7_property *v7_get_property(struct v7 *v7, val_t obj,
   return NULL;
 }
 
+#if V7_DISABLE_INLINE_CACHE
 V7_PRIVATE enum v7_err v7_get_property_v(struct v7 *v7, val_t obj,
                                          v7_val_t name,
                                          struct v7_property **res) {
@@ -20055,6 +23005,7 @@ clean:
   }
   return rcode;
 }
+#endif
 
 WARN_UNUSED_RESULT
 enum v7_err v7_get_throwing(struct v7 *v7, val_t obj, const char *name,
@@ -20451,8 +23402,47 @@ V7_PRIVATE enum v7_err def_property_v(struct v7 *v7, val_t obj, val_t name,
   }
 #endif
 
+#if V7_ENABLE_DENSE_ARRAYS
+  if (get_object_struct(obj)->attributes & V7_OBJ_DENSE_ARRAY) {
+    unsigned long index;
+    if (cstr_to_array_index(n, len, &index)) {
+      if (apply_attrs_desc(attrs_desc, V7_DEFAULT_PROPERTY_ATTRS) != 0 ||
+          (get_object_struct(obj)->attributes & V7_OBJ_NOT_EXTENSIBLE)) {
+        /*
+         * Elements of dense arrays can only have default attributes, and
+         * frozen or sealed arrays are rare enough to not bother.
+         */
+        dense_array_to_sparse(v7, obj);
+        n = v7_get_string(v7, &name, &len);
+      } else {
+        int has = 0, ires = 0;
+        if (attrs_desc & V7_DESC_PRESERVE_VALUE) {
+          val = v7_array_get2(v7, obj, index, &has);
+        }
+        if (!has) {
+          V7_TRY(v7_array_set_throwing(v7, obj, index, val, &ires));
+        }
+        prop = NULL;
+        if (ires == 0) {
+          prop = v7->cur_dense_prop;
+          prop->value = val;
+        }
+        goto clean;
+      }
+    }
+  }
+#endif
+
   /* regular (non-proxy) property access */
   prop = v7_get_own_property(v7, obj, n, len);
+  if (prop == NULL && as_assign) {
+    /* assignment invokes the setter inherited from a prototype, if any */
+    struct v7_property *proto_prop = v7_get_property(v7, obj, n, len);
+    if (proto_prop != NULL && (proto_prop->attributes & V7_PROPERTY_SETTER)) {
+      V7_TRY(v7_invoke_setter(v7, proto_prop, obj, val));
+      goto clean;
+    }
+  }
   if (prop == NULL) {
     /*
      * The own property with given `name` doesn't exist yet: try to create it,
@@ -20481,8 +23471,7 @@ V7_PRIVATE enum v7_err def_property_v(struct v7 *v7, val_t obj, val_t name,
     prop->value = val;
     prop->attributes = apply_attrs_desc(attrs_desc, V7_DEFAULT_PROPERTY_ATTRS);
 
-    prop->next = get_object_struct(obj)->properties;
-    get_object_struct(obj)->properties = prop;
+    obj_prop_link(v7, get_object_struct(obj), prop);
     goto clean;
   } else {
     /* Property already exists */
@@ -20582,7 +23571,7 @@ V7_PRIVATE enum v7_err def_property(struct v7 *v7, val_t obj, const char *name,
     len = strlen(name);
   }
 
-  name_val = v7_mk_string(v7, name, len, 1);
+  name_val = atom_mk_string(v7, name, len);
   V7_TRY(def_property_v(v7, obj, name_val, attrs_desc, val, as_assign, res));
 
 clean:
@@ -20615,6 +23604,7 @@ V7_PRIVATE int set_cfunc_prop(struct v7 *v7, val_t o, const char *name,
  */
 int v7_del(struct v7 *v7, val_t obj, const char *name, size_t len) {
   struct v7_property *prop, *prev;
+  struct v7_object *o;
 
   if (!v7_is_object(obj)) {
     return -1;
@@ -20622,15 +23612,36 @@ int v7_del(struct v7 *v7, val_t obj, const char *name, size_t len) {
   if (len == (size_t) ~0) {
     len = strlen(name);
   }
-  for (prev = NULL, prop = get_object_struct(obj)->properties; prop != NULL;
+  o = get_object_struct(obj);
+
+#if V7_ENABLE_DENSE_ARRAYS
+  if (o->attributes & V7_OBJ_DENSE_ARRAY) {
+    unsigned long index;
+    if (cstr_to_array_index(name, len, &index)) {
+      struct mbuf *abuf = dense_array_buf(v7, obj);
+      val_t *vp;
+      if (abuf == NULL || index >= abuf->len / sizeof(val_t) ||
+          *(vp = (val_t *) abuf->buf + index) == V7_TAG_NOVALUE) {
+        return -1;
+      }
+      /* deleting an element leaves a hole, `length` doesn't change */
+      *vp = V7_TAG_NOVALUE;
+      return 0;
+    }
+  }
+#endif
+
+  for (prev = NULL, prop = *obj_prop_list(o); prop != NULL;
        prev = prop, prop = prop->next) {
     size_t n;
     const char *s = v7_get_string(v7, &prop->name, &n);
     if (n == len && strncmp(s, name, len) == 0) {
+      bcode_ic_invalidate(v7);
+      obj_prop_index_del(v7, o, prop);
       if (prev) {
         prev->next = prop->next;
       } else {
-        get_object_struct(obj)->properties = prop->next;
+        *obj_prop_list(o) = prop->next;
       }
       v7_destroy_property(&prop);
       return 0;
@@ -20788,6 +23799,13 @@ V7_PRIVATE enum v7_err init_prop_iter_ctx(struct v7 *v7, v7_val_t obj,
 
       /* Object is not a proxy: we'll iterate real properties */
       ctx->cur_prop = get_object_struct(obj)->properties;
+#if V7_ENABLE_DENSE_ARRAYS
+      ctx->dense_array = V7_UNDEFINED;
+      if (get_object_struct(obj)->attributes & V7_OBJ_DENSE_ARRAY) {
+        /* elements go first, then the rest of the properties */
+        ctx->dense_array = obj;
+      }
+#endif
 
 #if V7_ENABLE__Proxy
     }
@@ -20822,6 +23840,33 @@ void v7_destruct_prop_iter_ctx(struct v7 *v7, struct prop_iter_ctx *ctx) {
   }
 }
 
+#if V7_ENABLE_DENSE_ARRAYS
+V7_PRIVATE int next_dense_element(struct v7 *v7, struct prop_iter_ctx *ctx,
+                                  struct v7_property *p) {
+  struct mbuf *abuf;
+  char buf[20];
+  int n;
+
+  if (!v7_is_object(ctx->dense_array) ||
+      !(get_object_struct(ctx->dense_array)->attributes & V7_OBJ_DENSE_ARRAY)) {
+    return 0;
+  }
+
+  abuf = dense_array_buf(v7, ctx->dense_array);
+  for (; abuf != NULL && ctx->dense_idx < abuf->len / sizeof(val_t);
+       ctx->dense_idx++) {
+    if (((val_t *) abuf->buf)[ctx->dense_idx] != V7_TAG_NOVALUE) {
+      n = c_snprintf(buf, sizeof(buf), "%lu", ctx->dense_idx);
+      p->name = v7_mk_string(v7, buf, n, 1);
+      p->value = ((val_t *) abuf->buf)[ctx->dense_idx++];
+      p->attributes = V7_DEFAULT_PROPERTY_ATTRS;
+      return 1;
+    }
+  }
+  return 0;
+}
+#endif
+
 int v7_next_prop(struct v7 *v7, struct prop_iter_ctx *ctx, v7_val_t *name,
                  v7_val_t *value, v7_prop_attr_t *attrs) {
   int ok = 0;
@@ -20932,6 +23977,13 @@ V7_PRIVATE enum v7_err next_prop(struct v7 *v7, struct prop_iter_ctx *ctx,
 
   *ok = 0;
 
+#if V7_ENABLE_DENSE_ARRAYS
+  if (next_dense_element(v7, ctx, &p)) {
+    *ok = 1;
+    goto found;
+  }
+#endif
+
 #if V7_ENABLE__Proxy
   if (ctx->proxy_ctx == NULL || !ctx->proxy_ctx->has_own_keys) {
     /*
@@ -21016,6 +24068,9 @@ V7_PRIVATE enum v7_err next_prop(struct v7 *v7, struct prop_iter_ctx *ctx,
   }
 #endif
 
+#if V7_ENABLE_DENSE_ARRAYS
+found:
+#endif
   /* If we have a valid property descriptor, use data from it */
   if (*ok) {
     if (name != NULL) *name = p.name;
@@ -21038,12 +24093,18 @@ clean:
 V7_PRIVATE int obj_prototype_set(struct v7 *v7, struct v7_object *obj,
                                  struct v7_object *proto) {
   int ret = -1;
-  (void) v7;
 
   if (obj->attributes & V7_OBJ_FUNCTION) {
     ret = -1;
   } else {
-    ((struct v7_generic_object *) obj)->prototype = proto;
+    struct v7_generic_object *go = (struct v7_generic_object *) obj;
+    if (go->prototype != NULL && go->prototype != proto) {
+      bcode_ic_invalidate(v7);
+    }
+    if (proto != NULL && !(proto->attributes & V7_OBJ_OFF_HEAP)) {
+      proto->attributes |= V7_OBJ_PROTOTYPE;
+    }
+    go->prototype = proto;
     ret = 0;
   }
 
@@ -21139,12 +24200,11 @@ static struct v7_property *get_or_create_user_data_property(struct v7 *v7,
   o = get_object_struct(obj);
   v7_own(v7, &obj);
   p = v7_mk_property(v7);
-  v7_disown(v7, &obj);
 
   p->attributes |= _V7_PROPERTY_USER_DATA_AND_DESTRUCTOR | _V7_PROPERTY_HIDDEN;
 
-  p->next = o->properties;
-  o->properties = p;
+  obj_prop_link(v7, o, p);
+  v7_disown(v7, &obj);
 
   return p;
 }
@@ -21202,34 +24262,114 @@ void v7_set_destructor_cb(struct v7 *v7, v7_val_t obj, v7_destructor_cb_t *d) {
 /* Amalgamated: #include "v7/src/slre.h" */
 
 #if V7_ENABLE__RegExp
+/*
+ * Returns the compiled program of the given regexp, retained for the caller,
+ * or NULL if the regexp is invalid. Programs are looked up in the cache first,
+ * see `struct regexp_cache_entry`.
+ */
+static struct slre_prog *regexp_compile(struct v7 *v7, const char *re,
+                                        size_t re_len, const char *flags,
+                                        size_t flags_len) {
+  uint32_t hash = str_hash(re, re_len) * 31 + str_hash(flags, flags_len);
+  struct regexp_cache_entry **pe, *e;
+  struct slre_prog *p = NULL;
+
+  for (pe = &v7->regexp_cache; (e = *pe) != NULL; pe = &e->next) {
+    if (e->hash == hash && e->src_len == re_len &&
+        e->flags_len == flags_len && memcmp(e->src, re, re_len) == 0 &&
+        (flags_len == 0 || memcmp(e->src + re_len, flags, flags_len) == 0)) {
+      /* move to front */
+      *pe = e->next;
+      e->next = v7->regexp_cache;
+      v7->regexp_cache = e;
+      return slre_retain(e->prog);
+    }
+  }
+
+  if (slre_compile(re, re_len, flags, flags_len, &p, 1) != SLRE_OK) {
+    return NULL;
+  }
+
+  if (V7_REGEXP_CACHE_SIZE > 0 &&
+      (e = (struct regexp_cache_entry *) malloc(sizeof(*e) + re_len +
+                                                flags_len)) != NULL) {
+    memcpy(e->src, re, re_len);
+    if (flags_len > 0) {
+      memcpy(e->src + re_len, flags, flags_len);
+    }
+    e->src_len = re_len;
+    e->flags_len = flags_len;
+    e->hash = hash;
+    e->prog = slre_retain(p);
+    e->next = v7->regexp_cache;
+    v7->regexp_cache = e;
+
+    /* evict the least recently used entry */
+    if (++v7->regexp_cache_cnt > V7_REGEXP_CACHE_SIZE) {
+      for (pe = &v7->regexp_cache; (*pe)->next != NULL; pe = &(*pe)->next) {
+      }
+      e = *pe;
+      *pe = NULL;
+      slre_free(e->prog);
+      free(e);
+      v7->regexp_cache_cnt--;
+    }
+  }
+
+  return p;
+}
+
+V7_PRIVATE void regexp_cache_free(struct v7 *v7) {
+  struct regexp_cache_entry *e;
+  while ((e = v7->regexp_cache) != NULL) {
+    v7->regexp_cache = e->next;
+    slre_free(e->prog);
+    free(e);
+  }
+  v7->regexp_cache_cnt = 0;
+}
+
+/*
+ * Makes a `RegExp` object with the source `src`, taking over the reference to
+ * the compiled program `p`
+ */
+static val_t regexp_mk(struct v7 *v7, val_t src, struct slre_prog *p) {
+  val_t res = mk_object(v7, v7->vals.regexp_prototype);
+  struct v7_regexp *rp = (struct v7_regexp *) malloc(sizeof(*rp));
+  rp->regexp_string = src;
+  v7_own(v7, &rp->regexp_string);
+  rp->compiled_regexp = p;
+  rp->lastIndex = 0;
+
+  v7_def(v7, res, "", 0, _V7_DESC_HIDDEN(1),
+         pointer_to_value(rp) | V7_TAG_REGEXP);
+  return res;
+}
+
 enum v7_err v7_mk_regexp(struct v7 *v7, const char *re, size_t re_len,
                          const char *flags, size_t flags_len, v7_val_t *res) {
   enum v7_err rcode = V7_OK;
-  struct slre_prog *p = NULL;
-  struct v7_regexp *rp;
+  struct slre_prog *p;
 
   if (re_len == ~((size_t) 0)) re_len = strlen(re);
 
-  if (slre_compile(re, re_len, flags, flags_len, &p, 1) != SLRE_OK ||
-      p == NULL) {
+  p = regexp_compile(v7, re, re_len, flags, flags_len);
+  if (p == NULL) {
     rcode = v7_throwf(v7, TYPE_ERROR, "Invalid regex");
     goto clean;
   } else {
-    *res = mk_object(v7, v7->vals.regexp_prototype);
-    rp = (struct v7_regexp *) malloc(sizeof(*rp));
-    rp->regexp_string = v7_mk_string(v7, re, re_len, 1);
-    v7_own(v7, &rp->regexp_string);
-    rp->compiled_regexp = p;
-    rp->lastIndex = 0;
-
-    v7_def(v7, *res, "", 0, _V7_DESC_HIDDEN(1),
-           pointer_to_value(rp) | V7_TAG_REGEXP);
+    *res = regexp_mk(v7, v7_mk_string(v7, re, re_len, 1), p);
   }
 
 clean:
   return rcode;
 }
 
+V7_PRIVATE val_t regexp_clone(struct v7 *v7, val_t re) {
+  struct v7_regexp *rp = v7_get_regexp_struct(v7, re);
+  return regexp_mk(v7, rp->regexp_string, slre_retain(rp->compiled_regexp));
+}
+
 V7_PRIVATE struct v7_regexp *v7_get_regexp_struct(struct v7 *v7, val_t v) {
   struct v7_property *p;
   int is = v7_is_regexp(v7, v);
@@ -21828,24 +24968,60 @@ clean:
 }
 
 static const char *hex_digits = "0123456789abcdef";
-static char *append_hex(char *buf, char *limit, uint8_t c) {
-  if (buf < limit) *buf++ = 'u';
-  if (buf < limit) *buf++ = '0';
-  if (buf < limit) *buf++ = '0';
-  if (buf < limit) *buf++ = hex_digits[(int) ((c >> 4) % 0xf)];
-  if (buf < limit) *buf++ = hex_digits[(int) (c & 0xf)];
-  return buf;
+
+V7_PRIVATE void stringify_out_append(struct stringify_out *out, const char *p,
+                                     size_t len) {
+  if (out->cb != NULL) {
+    /* Pass full chunks to the callback */
+    while (out->len + len > out->size) {
+      size_t n = out->size - out->len;
+      memcpy(out->buf + out->len, p, n);
+      out->cb(out->buf, out->size, out->cb_data);
+      out->len = 0;
+      p += n;
+      len -= n;
+    }
+  } else if (out->len + len >= out->size) {
+    /* Grow the buffer, leaving room for the 0-terminator */
+    size_t size = out->size * 2;
+    char *buf;
+    if (size < out->len + len + 1) {
+      size = out->len + len + 1;
+    }
+    if (out->buf_owned) {
+      buf = (char *) realloc(out->buf, size);
+    } else {
+      buf = (char *) malloc(size);
+      if (buf != NULL) {
+        memcpy(buf, out->buf, out->len);
+      }
+    }
+    if (buf == NULL) {
+      /* Out of memory: truncate the output */
+      if (out->size == 0) return;
+      len = out->size - out->len - 1;
+    } else {
+      out->buf = buf;
+      out->size = size;
+      out->buf_owned = 1;
+    }
+  }
+
+  memcpy(out->buf + out->len, p, len);
+  out->len += len;
+  if (out->cb == NULL) {
+    out->buf[out->len] = '\0';
+  }
 }
 
 /*
- * Appends quoted s to buf. Any double quote contained in s will be escaped.
- * Returns the number of characters that would have been added,
- * like snprintf.
- * If size is zero it doesn't output anything but keeps counting.
+ * Appends quoted s to the output. Any double quote contained in s will be
+ * escaped.
  */
-static int snquote(char *buf, size_t size, const char *s, size_t len) {
-  char *limit = buf + size;
-  const char *end;
+static void stringify_out_quote(struct stringify_out *out, const char *s,
+                                size_t len) {
+  const char *end = s + len, *run = s;
+  char esc[6];
   /*
    * String single character escape sequence:
    * http://www.ecma-international.org/ecma-262/6.0/index.html#table-34
@@ -21858,43 +25034,59 @@ static int snquote(char *buf, size_t size, const char *s, size_t len) {
    * 0xd -> \r
    */
   const char *specials = "btnvfr";
-  size_t i = 0;
 
-  i++;
-  if (buf < limit) *buf++ = '"';
+  stringify_out_append(out, "\"", 1);
 
-  for (end = s + len; s < end; s++) {
+  for (; s < end; s++) {
+    size_t n;
     if (*s == '"' || *s == '\\') {
-      i++;
-      if (buf < limit) *buf++ = '\\';
+      esc[0] = '\\';
+      esc[1] = *s;
+      n = 2;
     } else if (*s >= '\b' && *s <= '\r') {
-      i += 2;
-      if (buf < limit) *buf++ = '\\';
-      if (buf < limit) *buf++ = specials[*s - '\b'];
-      continue;
+      esc[0] = '\\';
+      esc[1] = specials[*s - '\b'];
+      n = 2;
     } else if ((unsigned char) *s < '\b' || (*s > '\r' && *s < ' ')) {
-      i += 6 /* \uXXXX */;
-      if (buf < limit) *buf++ = '\\';
-      buf = append_hex(buf, limit, (uint8_t) *s);
+      memcpy(esc, "\\u00", 4);
+      esc[4] = hex_digits[(uint8_t) *s >> 4];
+      esc[5] = hex_digits[(uint8_t) *s & 0xf];
+      n = 6;
+    } else {
       continue;
     }
-    i++;
-    if (buf < limit) *buf++ = *s;
+    /* Copy unescaped characters in bulk */
+    stringify_out_append(out, run, s - run);
+    stringify_out_append(out, esc, n);
+    run = s + 1;
   }
 
-  i++;
-  if (buf < limit) *buf++ = '"';
+  stringify_out_append(out, run, s - run);
+  stringify_out_append(out, "\"", 1);
+}
 
-  if (buf < limit) {
-    *buf = '\0';
-  } else if (size != 0) {
-    /*
-     * There is no room for the NULL char, but the size wasn't zero, so we can
-     * safely put NULL in the previous byte
-     */
-    *(buf - 1) = '\0';
+/* Appends the string representation of a primitive value to the output */
+WARN_UNUSED_RESULT
+static enum v7_err stringify_out_primitive(struct v7 *v7, val_t v,
+                                           struct stringify_out *out) {
+  enum v7_err rcode = V7_OK;
+
+  if (v7_is_string(v)) {
+    size_t n;
+    const char *s = v7_get_string(v7, &v, &n);
+    stringify_out_append(out, s, n);
+  } else {
+    char buf[32];
+    size_t n = 0;
+    V7_TRY(primitive_to_str(v7, v, NULL, buf, sizeof(buf), &n));
+    if (n >= sizeof(buf)) {
+      n = sizeof(buf) - 1;
+    }
+    stringify_out_append(out, buf, n);
   }
-  return i;
+
+clean:
+  return rcode;
 }
 
 /*
@@ -21927,13 +25119,12 @@ static int should_skip_for_json(enum v7_type type) {
 }
 
 WARN_UNUSED_RESULT
-V7_PRIVATE enum v7_err to_json_or_debug(struct v7 *v7, val_t v, char *buf,
-                                        size_t size, size_t *res_len,
+V7_PRIVATE enum v7_err to_json_or_debug(struct v7 *v7, val_t v,
+                                        struct stringify_out *out,
                                         uint8_t is_debug) {
   val_t el;
   char *vp;
   enum v7_err rcode = V7_OK;
-  size_t len = 0;
   struct gc_tmp_frame tf = new_tmp_frame(v7);
 
   tmp_stack_push(&tf, &v);
@@ -21942,8 +25133,6 @@ V7_PRIVATE enum v7_err to_json_or_debug(struct v7 *v7, val_t v, char *buf,
    * TODO(dfrank) : also push all `v7_val_t`s that are declared below
    */
 
-  if (size > 0) *buf = '\0';
-
   if (!is_debug && should_skip_for_json(val_type(v7, v))) {
     goto clean;
   }
@@ -21952,8 +25141,7 @@ V7_PRIVATE enum v7_err to_json_or_debug(struct v7 *v7, val_t v, char *buf,
        vp < v7->json_visited_stack.buf + v7->json_visited_stack.len;
        vp += sizeof(val_t)) {
     if (*(val_t *) vp == v) {
-      strncpy(buf, "[Circular]", size);
-      len = 10;
+      stringify_out_append(out, "[Circular]", 10);
       goto clean;
     }
   }
@@ -21966,7 +25154,7 @@ V7_PRIVATE enum v7_err to_json_or_debug(struct v7 *v7, val_t v, char *buf,
     case V7_TYPE_CFUNCTION:
     case V7_TYPE_FOREIGN:
       /* For those types, regular `primitive_to_str()` works */
-      V7_TRY(primitive_to_str(v7, v, NULL, buf, size, &len));
+      V7_TRY(stringify_out_primitive(v7, v, out));
       goto clean;
 
     case V7_TYPE_STRING: {
@@ -21976,7 +25164,7 @@ V7_PRIVATE enum v7_err to_json_or_debug(struct v7 *v7, val_t v, char *buf,
        */
       size_t n;
       const char *str = v7_get_string(v7, &v, &n);
-      len = snquote(buf, size, str, n);
+      stringify_out_quote(out, str, n);
       goto clean;
     }
 
@@ -21989,7 +25177,7 @@ V7_PRIVATE enum v7_err to_json_or_debug(struct v7 *v7, val_t v, char *buf,
       }
 #endif
       V7_TRY(b_apply(v7, func, v, V7_UNDEFINED, 0, &val));
-      V7_TRY(to_json_or_debug(v7, val, buf, size, &len, is_debug));
+      V7_TRY(to_json_or_debug(v7, val, out, is_debug));
       goto clean;
     }
     case V7_TYPE_GENERIC_OBJECT:
@@ -21998,18 +25186,16 @@ V7_PRIVATE enum v7_err to_json_or_debug(struct v7 *v7, val_t v, char *buf,
     case V7_TYPE_NUMBER_OBJECT:
     case V7_TYPE_REGEXP_OBJECT:
     case V7_TYPE_ERROR_OBJECT: {
-      /* TODO(imax): make it return the desired size of the buffer */
-      char *b = buf;
       v7_val_t name = V7_UNDEFINED, val = V7_UNDEFINED;
       v7_prop_attr_t attrs = 0;
       const char *pname;
       size_t nlen;
-      int ok = 0;
+      int ok = 0, first = 1;
       struct prop_iter_ctx ctx;
       memset(&ctx, 0, sizeof(ctx));
 
       mbuf_append(&v7->json_visited_stack, (char *) &v, sizeof(v));
-      b += c_snprintf(b, BUF_LEFT(size, b - buf), "{");
+      stringify_out_append(out, "{", 1);
       V7_TRY2(init_prop_iter_ctx(v7, v, 1 /*proxy-transparent*/, &ctx),
               clean_iter);
       while (1) {
@@ -22022,65 +25208,60 @@ V7_PRIVATE enum v7_err to_json_or_debug(struct v7 *v7, val_t v, char *buf,
           continue;
         }
         pname = v7_get_string(v7, &name, &nlen);
-        V7_TRY(v7_get_throwing(v7, v, pname, nlen, &val));
+        V7_TRY2(v7_get_throwing(v7, v, pname, nlen, &val), clean_iter);
         if (!is_debug && should_skip_for_json(val_type(v7, val))) {
           continue;
         }
-        if (b - buf != 1) { /* Not the first property to be printed */
-          b += c_snprintf(b, BUF_LEFT(size, b - buf), ",");
+        if (!first) {
+          stringify_out_append(out, ",", 1);
         }
+        first = 0;
         s = v7_get_string(v7, &name, &n);
-        b += c_snprintf(b, BUF_LEFT(size, b - buf), "\"%.*s\":", (int) n, s);
-        {
-          size_t tmp = 0;
-          V7_TRY2(to_json_or_debug(v7, val, b, BUF_LEFT(size, b - buf), &tmp,
-                                   is_debug),
-                  clean_iter);
-          b += tmp;
-        }
+        stringify_out_append(out, "\"", 1);
+        stringify_out_append(out, s, n);
+        stringify_out_append(out, "\":", 2);
+        V7_TRY2(to_json_or_debug(v7, val, out, is_debug), clean_iter);
       }
-      b += c_snprintf(b, BUF_LEFT(size, b - buf), "}");
+      stringify_out_append(out, "}", 1);
       v7->json_visited_stack.len -= sizeof(v);
 
     clean_iter:
       v7_destruct_prop_iter_ctx(v7, &ctx);
-
-      len = b - buf;
       goto clean;
     }
     case V7_TYPE_ARRAY_OBJECT: {
       int has;
-      char *b = buf;
       size_t i, alen = v7_array_length(v7, v);
       mbuf_append(&v7->json_visited_stack, (char *) &v, sizeof(v));
-      b += c_snprintf(b, BUF_LEFT(size, b - buf), "[");
+      stringify_out_append(out, "[", 1);
       for (i = 0; i < alen; i++) {
         el = v7_array_get2(v7, v, i, &has);
         if (has) {
-          size_t tmp = 0;
           if (!is_debug && should_skip_for_json(val_type(v7, el))) {
-            b += c_snprintf(b, BUF_LEFT(size, b - buf), "null");
+            stringify_out_append(out, "null", 4);
           } else {
-            V7_TRY(to_json_or_debug(v7, el, b, BUF_LEFT(size, b - buf), &tmp,
-                                    is_debug));
+            V7_TRY(to_json_or_debug(v7, el, out, is_debug));
           }
-          b += tmp;
         }
         if (i != alen - 1) {
-          b += c_snprintf(b, BUF_LEFT(size, b - buf), ",");
+          stringify_out_append(out, ",", 1);
         }
       }
-      b += c_snprintf(b, BUF_LEFT(size, b - buf), "]");
+      stringify_out_append(out, "]", 1);
       v7->json_visited_stack.len -= sizeof(v);
-      len = b - buf;
       goto clean;
     }
-    case V7_TYPE_CFUNCTION_OBJECT:
+    case V7_TYPE_CFUNCTION_OBJECT: {
+      char buf[40];
+      int n;
       V7_TRY(obj_value_of(v7, v, &v));
-      len = c_snprintf(buf, size, "Function cfunc_%p", get_ptr(v));
+      n = c_snprintf(buf, sizeof(buf), "Function cfunc_%p", get_ptr(v));
+      stringify_out_append(out, buf, n < (int) sizeof(buf) ? n : 0);
       goto clean;
+    }
     case V7_TYPE_FUNCTION_OBJECT:
-      V7_TRY(to_string(v7, v, NULL, buf, size, &len));
+      V7_TRY(to_primitive(v7, v, V7_TO_PRIMITIVE_HINT_STRING, &v));
+      V7_TRY(stringify_out_primitive(v7, v, out));
       goto clean;
 
     case V7_TYPE_MAX_OBJECT_TYPE:
@@ -22090,16 +25271,9 @@ V7_PRIVATE enum v7_err to_json_or_debug(struct v7 *v7, val_t v, char *buf,
 
   abort();
 
-  len = 0; /* for compilers that don't know about abort() */
   goto clean;
 
 clean:
-  if (rcode != V7_OK) {
-    len = 0;
-  }
-  if (res_len != NULL) {
-    *res_len = len;
-  }
   tmp_frame_cleanup(&tf);
   return rcode;
 }
@@ -22145,50 +25319,87 @@ char *v7_stringify(struct v7 *v7, val_t v, char *buf, size_t size,
   return ret;
 }
 
-enum v7_err v7_stringify_throwing(struct v7 *v7, val_t v, char *buf,
-                                  size_t size, enum v7_stringify_mode mode,
-                                  char **res) {
+WARN_UNUSED_RESULT
+static enum v7_err stringify_to_out(struct v7 *v7, val_t v,
+                                    enum v7_stringify_mode mode,
+                                    struct stringify_out *out) {
   enum v7_err rcode = V7_OK;
-  char *p = buf;
-  size_t len;
 
   switch (mode) {
     case V7_STRINGIFY_DEFAULT:
-      V7_TRY(to_string(v7, v, NULL, buf, size, &len));
+      V7_TRY(to_primitive(v7, v, V7_TO_PRIMITIVE_HINT_STRING, &v));
+      V7_TRY(stringify_out_primitive(v7, v, out));
       break;
 
     case V7_STRINGIFY_JSON:
-      V7_TRY(to_json_or_debug(v7, v, buf, size, &len, 0));
+      V7_TRY(to_json_or_debug(v7, v, out, 0));
       break;
 
     case V7_STRINGIFY_DEBUG:
-      V7_TRY(to_json_or_debug(v7, v, buf, size, &len, 1));
+      V7_TRY(to_json_or_debug(v7, v, out, 1));
       break;
   }
 
-  /* fit null terminating byte */
-  if (len >= size) {
-    /* Buffer is not large enough. Allocate a bigger one */
-    p = (char *) malloc(len + 1);
-    V7_TRY(v7_stringify_throwing(v7, v, p, len + 1, mode, res));
-    assert(*res == p);
-    goto clean;
-  } else {
-    *res = p;
-    goto clean;
+clean:
+  return rcode;
+}
+
+enum v7_err v7_stringify_throwing(struct v7 *v7, val_t v, char *buf,
+                                  size_t size, enum v7_stringify_mode mode,
+                                  char **res) {
+  enum v7_err rcode = V7_OK;
+  struct stringify_out out;
+
+  memset(&out, 0, sizeof(out));
+  out.buf = buf;
+  out.size = size;
+  if (size > 0) {
+    buf[0] = '\0';
   }
 
+  /*
+   * The output moves to a heap buffer as soon as it doesn't fit into `buf`,
+   * so the value is stringified only once
+   */
+  V7_TRY(stringify_to_out(v7, v, mode, &out));
+
+  /* Make sure there is a null terminating byte even if `size` is zero */
+  stringify_out_append(&out, "", 0);
+  *res = out.buf;
+
 clean:
   /*
    * If we're going to throw, and we allocated a buffer, then free it.
    * But if we don't throw, then the caller will free it.
    */
-  if (rcode != V7_OK && p != buf) {
-    free(p);
+  if (rcode != V7_OK && out.buf_owned) {
+    free(out.buf);
   }
   return rcode;
 }
 
+enum v7_err v7_stringify_to_callback(struct v7 *v7, val_t v,
+                                     enum v7_stringify_mode mode,
+                                     v7_stringify_cb_t cb, void *user_data) {
+  enum v7_err rcode = V7_OK;
+  char buf[V7_STRINGIFY_CHUNK_SIZE];
+  struct stringify_out out;
+
+  memset(&out, 0, sizeof(out));
+  out.buf = buf;
+  out.size = sizeof(buf);
+  out.cb = cb;
+  out.cb_data = user_data;
+
+  V7_TRY(stringify_to_out(v7, v, mode, &out));
+  if (out.len > 0) {
+    cb(out.buf, out.len, user_data);
+  }
+
+clean:
+  return rcode;
+}
+
 int v7_is_truthy(struct v7 *v7, val_t v) {
   return v7_get_bool(v7, to_boolean_v(v7, v));
 }
@@ -22263,13 +25474,15 @@ V7_PRIVATE void *shdata_get_payload(struct shdata *p) {
 void *v7_sp_limit = NULL;
 #endif
 
-void gc_mark_string(struct v7 *, val_t *);
-
 static struct gc_block *gc_new_block(struct gc_arena *a, size_t size);
 static void gc_free_block(struct gc_block *b);
 static void gc_mark_mbuf_pt(struct v7 *v7, const struct mbuf *mbuf);
 static void gc_mark_mbuf_val(struct v7 *v7, const struct mbuf *mbuf);
 static void gc_mark_vec_val(struct v7 *v7, const struct v7_vec *vec);
+#ifndef V7_MALLOC_GC
+static void gc_sweep_until_free(struct v7 *v7, struct gc_arena *a);
+#endif
+static void gc_collect(struct v7 *v7, int full, int lazy);
 
 V7_PRIVATE struct v7_generic_object *new_generic_object(struct v7 *v7) {
   return (struct v7_generic_object *) gc_alloc_cell(v7,
@@ -22308,7 +25521,7 @@ V7_PRIVATE void tmp_stack_push(struct gc_tmp_frame *tf, val_t *vp) {
 V7_PRIVATE void gc_arena_init(struct gc_arena *a, size_t cell_size,
                               size_t initial_size, size_t size_increment,
                               const char *name) {
-  assert(cell_size >= sizeof(uintptr_t));
+  assert(cell_size >= sizeof(struct gc_cell));
 
   memset(a, 0, sizeof(*a));
   a->cell_size = cell_size;
@@ -22321,7 +25534,7 @@ V7_PRIVATE void gc_arena_destroy(struct v7 *v7, struct gc_arena *a) {
   struct gc_block *b;
 
   if (a->blocks != NULL) {
-    gc_sweep(v7, a, 0);
+    gc_sweep(v7, a);
     for (b = a->blocks; b != NULL;) {
       struct gc_block *tmp;
       tmp = b;
@@ -22336,8 +25549,12 @@ static void gc_free_block(struct gc_block *b) {
   free(b);
 }
 
+/*
+ * Allocates a new block and makes it the bump allocation region of the arena.
+ * Its cells are zeroed by `calloc()`, which is what `gc_alloc_cell()` expects
+ * from free cells.
+ */
 static struct gc_block *gc_new_block(struct gc_arena *a, size_t size) {
-  struct gc_cell *cur;
   struct gc_block *b;
 
   heapusage_dont_count(1);
@@ -22351,12 +25568,8 @@ static struct gc_block *gc_new_block(struct gc_arena *a, size_t size) {
   heapusage_dont_count(0);
   if (b->base == NULL) abort();
 
-  for (cur = GC_CELL_OP(a, b->base, +, 0);
-       cur < GC_CELL_OP(a, b->base, +, b->size);
-       cur = GC_CELL_OP(a, cur, +, 1)) {
-    cur->head.link = a->free;
-    a->free = cur;
-  }
+  a->top = b->base;
+  a->limit = GC_CELL_OP(a, b->base, +, b->size);
 
   return b;
 }
@@ -22372,34 +25585,60 @@ V7_PRIVATE void *gc_alloc_cell(struct v7 *v7, struct gc_arena *a) {
   return r;
 #else
   struct gc_cell *r;
-  if (a->free == NULL) {
-    if (!maybe_gc(v7)) {
-      /* GC is inhibited, so, schedule invocation for later */
-      v7->need_gc = 1;
+  if (a->free == NULL && a->top == a->limit) {
+    if (a->sweep != NULL && !v7->inhibit_gc) {
+      /* reclaim the garbage left by the last collection first */
+      gc_sweep_until_free(v7, a);
     }
 
-    if (a->free == NULL) {
-      struct gc_block *b = gc_new_block(a, a->size_increment);
+    if (a->free == NULL && v7->gc_allocated >= v7->gc_budget) {
+      if (!maybe_gc(v7)) {
+        /* GC is inhibited, so, schedule invocation for later */
+        v7->need_gc = 1;
+      }
+
+      if (a->free == NULL && a->sweep != NULL && !v7->inhibit_gc) {
+        gc_sweep_until_free(v7, a);
+      }
+    }
+
+    if (a->free == NULL && a->top == a->limit) {
+      /* grow by the rest of the allocation budget, within the policy limits */
+      size_t size = 0;
+      struct gc_block *b;
+      if (v7->gc_allocated < v7->gc_budget) {
+        size = (v7->gc_budget - v7->gc_allocated) / a->cell_size;
+      }
+      if (size > v7->gc_max_growth) size = v7->gc_max_growth;
+      if (size < a->size_increment) size = a->size_increment;
+
+      b = gc_new_block(a, size);
       b->next = a->blocks;
       a->blocks = b;
+      /* new blocks have nothing to sweep */
+      if (a->sweep == &a->blocks) {
+        a->sweep = &b->next;
+      }
     }
   }
-  r = a->free;
 
-  UNMARK(r);
-
-  a->free = r->head.link;
+  if (a->free != NULL) {
+    r = a->free;
+    a->free = r->head.link;
+    /* the sweep has zeroed the rest of the cell already */
+    r->head.link = NULL;
+    r->flags = 0;
+  } else {
+    r = a->top;
+    a->top = GC_CELL_OP(a, r, +, 1);
+  }
+  v7->gc_allocated += a->cell_size;
 
 #if V7_ENABLE__Memory__stats
   a->allocations++;
   a->alive++;
 #endif
 
-  /*
-   * TODO(mkm): minor opt possible since most of the fields
-   * are overwritten downstream, but not worth the yak shave time
-   * when fields are added to GC-able structures */
-  memset(r, 0, a->cell_size);
   return (void *) r;
 #endif
 }
@@ -22428,131 +25667,162 @@ void gc_sweep_malloc(struct v7 *v7) {
 #endif
 
 /*
- * Scans the arena and add all unmarked cells to the free list.
- *
- * Empty blocks get deallocated. The head of the free list will contais cells
- * from the last (oldest) block. Cells will thus be allocated in block order.
+ * Starts the sweep of the arena: the free list is rebuilt from scratch as the
+ * blocks get swept by `gc_sweep_block()`. The cells left in the bump
+ * allocation region are flagged as free, so that they get threaded as well.
  */
-void gc_sweep(struct v7 *v7, struct gc_arena *a, size_t start) {
-  struct gc_block *b;
+static void gc_sweep_begin(struct gc_arena *a) {
   struct gc_cell *cur;
-  struct gc_block **prevp = &a->blocks;
+
+  assert(a->sweep == NULL);
+  for (cur = a->top; cur < a->limit; cur = GC_CELL_OP(a, cur, +, 1)) {
+    MARK_FREE(cur);
+  }
+  a->top = a->limit = NULL;
+  a->free = NULL;
+  a->sweep = &a->blocks;
 #if V7_ENABLE__Memory__stats
   a->alive = 0;
 #endif
+}
 
+/*
+ * Sweeps the next block of the arena, adding all its unmarked cells to the
+ * free list. Returns the number of visited cells.
+ *
+ * Empty blocks get deallocated. The head of the free list will contais cells
+ * from the last (oldest) block. Cells will thus be allocated in block order.
+ */
+static size_t gc_sweep_block(struct v7 *v7, struct gc_arena *a) {
+  struct gc_block *b = *a->sweep;
+  struct gc_cell *cur;
+  size_t freed_in_block = 0, size = b->size;
   /*
-   * Before we sweep, we should mark all free cells in a way that is
-   * distinguishable from marked used cells.
-   */
-  {
-    struct gc_cell *next;
-    for (cur = a->free; cur != NULL; cur = next) {
-      next = cur->head.link;
-      MARK_FREE(cur);
-    }
-  }
-
-  /*
-   * We'll rebuild the whole `free` list, so initially we just reset it
+   * if it turns out that this block is 100% garbage
+   * we can release the whole block, but the addition
+   * of it's cells to the free list has to be undone.
    */
-  a->free = NULL;
+  struct gc_cell *prev_free = a->free;
 
-  for (b = a->blocks; b != NULL;) {
-    size_t freed_in_block = 0;
-    /*
-     * if it turns out that this block is 100% garbage
-     * we can release the whole block, but the addition
-     * of it's cells to the free list has to be undone.
-     */
-    struct gc_cell *prev_free = a->free;
-
-    for (cur = GC_CELL_OP(a, b->base, +, start);
-         cur < GC_CELL_OP(a, b->base, +, b->size);
-         cur = GC_CELL_OP(a, cur, +, 1)) {
-      if (MARKED(cur)) {
-        /* The cell is used and marked  */
-        UNMARK(cur);
+  for (cur = b->base; cur < GC_CELL_OP(a, b->base, +, b->size);
+       cur = GC_CELL_OP(a, cur, +, 1)) {
+    if (MARKED(cur)) {
+      /* The cell is used and marked  */
+      UNMARK(cur);
 #if V7_ENABLE__Memory__stats
-        a->alive++;
+      a->alive++;
 #endif
-      } else {
+    } else {
+      /*
+       * The cell is either:
+       * - free
+       * - garbage that's about to be freed
+       */
+
+      if (!MARKED_FREE(cur)) {
         /*
-         * The cell is either:
-         * - free
-         * - garbage that's about to be freed
+         * The cell is used and should be freed: call the destructor and
+         * reset the memory
          */
-
-        if (MARKED_FREE(cur)) {
-          /* The cell is free, so, just unmark it */
-          UNMARK_FREE(cur);
-        } else {
-          /*
-           * The cell is used and should be freed: call the destructor and
-           * reset the memory
-           */
-          if (a->destructor != NULL) {
-            a->destructor(v7, cur);
-          }
-          memset(cur, 0, a->cell_size);
+        if (a->destructor != NULL) {
+          a->destructor(v7, cur);
         }
+        memset(cur, 0, a->cell_size);
+        MARK_FREE(cur);
+      }
 
-        /* Add this cell to the `free` list */
-        cur->head.link = a->free;
-        a->free = cur;
-        freed_in_block++;
+      /* Add this cell to the `free` list */
+      cur->head.link = a->free;
+      a->free = cur;
+      freed_in_block++;
 #if V7_ENABLE__Memory__stats
-        a->garbage++;
+      a->garbage++;
 #endif
-      }
     }
+  }
 
-    /*
-     * don't free the initial block, which is at the tail
-     * because it has a special size aimed at reducing waste
-     * and simplifying initial startup. TODO(mkm): improve
-     * */
-    if (b->next != NULL && freed_in_block == b->size) {
-      *prevp = b->next;
-      gc_free_block(b);
-      b = *prevp;
-      a->free = prev_free;
-    } else {
-      prevp = &b->next;
-      b = b->next;
-    }
+  /*
+   * don't free the initial block, which is at the tail
+   * because it has a special size aimed at reducing waste
+   * and simplifying initial startup. TODO(mkm): improve
+   * */
+  if (b->next != NULL && freed_in_block == b->size) {
+    *a->sweep = b->next;
+    gc_free_block(b);
+    a->free = prev_free;
+  } else {
+    a->sweep = &b->next;
+  }
+
+  if (*a->sweep == NULL) {
+    a->sweep = NULL;
+  }
+
+  return size;
+}
+
+/* Completes the sweep of the arena, if any is in progress. */
+static void gc_sweep_finish(struct v7 *v7, struct gc_arena *a) {
+  while (a->sweep != NULL) {
+    gc_sweep_block(v7, a);
+  }
+}
+
+/*
+ * Sweeps the arena until its free list gets some cells. Destructors of
+ * objects and functions walk their property lists, so those arenas have to
+ * be swept completely before the properties.
+ */
+#ifndef V7_MALLOC_GC
+static void gc_sweep_until_free(struct v7 *v7, struct gc_arena *a) {
+  if (a == &v7->property_arena) {
+    gc_sweep_finish(v7, &v7->generic_object_arena);
+    gc_sweep_finish(v7, &v7->function_arena);
+  }
+
+  while (a->free == NULL && a->sweep != NULL) {
+    gc_sweep_block(v7, a);
   }
 }
+#endif
+
+/* Scans the whole arena and add all unmarked cells to the free list. */
+void gc_sweep(struct v7 *v7, struct gc_arena *a) {
+  gc_sweep_finish(v7, a);
+  gc_sweep_begin(a);
+  gc_sweep_finish(v7, a);
+}
 
+#if V7_ENABLE_DENSE_ARRAYS
 /*
- * dense arrays contain only one property pointing to an mbuf with array values.
+ * Elements of dense arrays live in an mbuf referenced by a hidden property.
  */
 V7_PRIVATE void gc_mark_dense_array(struct v7 *v7,
                                     struct v7_generic_object *obj) {
-  val_t v;
   struct mbuf *mbuf;
   val_t *vp;
 
-#if 0
-  /* TODO(mkm): use this when dense array promotion is implemented */
-  v = obj->properties->value;
-#else
-  v = v7_get(v7, v7_object_to_value(&obj->base), "", 0);
-#endif
-
-  mbuf = (struct mbuf *) v7_get_ptr(v7, v);
+  mbuf = dense_array_buf(v7, v7_object_to_value(&obj->base));
 
   /* function scope pointer is aliased to the object's prototype pointer */
   gc_mark(v7, v7_object_to_value(obj_prototype(v7, &obj->base)));
   MARK(obj);
 
   if (mbuf == NULL) return;
+  /* elements count towards the live data, see `gc_budget` */
+  v7->gc_live += mbuf->len;
+  if (obj->base.attributes & V7_OBJ_NUMBER_ELEMENTS) {
+    /* nothing to trace in there */
+    UNMARK(obj);
+    return;
+  }
   for (vp = (val_t *) mbuf->buf; (char *) vp < mbuf->buf + mbuf->len; vp++) {
     gc_mark(v7, *vp);
     gc_mark_string(v7, vp);
   }
   UNMARK(obj);
 }
+#endif
 
 V7_PRIVATE void gc_mark(struct v7 *v7, val_t v) {
   struct v7_object *obj_base;
@@ -22588,10 +25858,15 @@ V7_PRIVATE void gc_mark(struct v7 *v7, val_t v) {
   }
 #endif
 
+  v7->gc_live += is_js_function(v) ? sizeof(struct v7_js_function)
+                                   : sizeof(struct v7_generic_object);
+
+#if V7_ENABLE_DENSE_ARRAYS
   if (obj_base->attributes & V7_OBJ_DENSE_ARRAY) {
     struct v7_generic_object *obj = get_generic_object_struct(v);
     gc_mark_dense_array(v7, obj);
   }
+#endif
 
   /* mark object itself, and its properties */
   for ((prop = obj_base->properties), MARK(obj_base); prop != NULL;
@@ -22605,7 +25880,9 @@ V7_PRIVATE void gc_mark(struct v7 *v7, val_t v) {
     }
 
 #ifdef V7_FREEZE
-    if (v7->freeze_file != NULL) {
+    /* property index is not frozen, frozen objects can't grow anyway */
+    if (v7->freeze_file != NULL &&
+        !(prop->attributes & _V7_PROPERTY_INDEX)) {
       freeze_prop(v7, v7->freeze_file, prop);
     }
 #endif
@@ -22616,6 +25893,7 @@ V7_PRIVATE void gc_mark(struct v7 *v7, val_t v) {
 
     next = prop->next;
     MARK(prop);
+    v7->gc_live += sizeof(*prop);
   }
 
   /* mark object's prototype */
@@ -22694,10 +25972,55 @@ int v7_heap_stat(struct v7 *v7, enum v7_heap_stat_what what) {
       return v7->owned_values.len / sizeof(val_t *);
     case V7_HEAP_STAT_FUNC_OWNED_MAX:
       return v7->owned_values.size / sizeof(val_t *);
+#if !V7_DISABLE_INLINE_CACHE
+    case V7_HEAP_STAT_IC_HITS:
+      return v7->ic_hits;
+    case V7_HEAP_STAT_IC_MISSES:
+      return v7->ic_misses;
+#else
+    case V7_HEAP_STAT_IC_HITS:
+    case V7_HEAP_STAT_IC_MISSES:
+      return 0;
+#endif
+#if !V7_DISABLE_BCODE_CACHE
+    case V7_HEAP_STAT_BCODE_CACHE_HITS:
+      return v7->bcode_cache_hits;
+    case V7_HEAP_STAT_BCODE_CACHE_MISSES:
+      return v7->bcode_cache_misses;
+    case V7_HEAP_STAT_BCODE_CACHE_BYTES:
+      return v7->bcode_cache_bytes;
+#else
+    case V7_HEAP_STAT_BCODE_CACHE_HITS:
+    case V7_HEAP_STAT_BCODE_CACHE_MISSES:
+    case V7_HEAP_STAT_BCODE_CACHE_BYTES:
+      return 0;
+#endif
+    case V7_HEAP_STAT_GC_COUNT:
+      return v7->gc_count;
   }
 
   return -1;
 }
+
+int v7_func_ic_stat(struct v7 *v7, v7_val_t func, unsigned long *hits,
+                    unsigned long *misses) {
+  struct bcode *bcode;
+  *hits = *misses = 0;
+  if (!is_js_function(func)) {
+    return -1;
+  }
+  bcode = get_js_function_struct(func)->bcode;
+#if !V7_DISABLE_INLINE_CACHE
+  if (bcode->ic != NULL) {
+    *hits = bcode->ic->hits;
+    *misses = bcode->ic->misses;
+  }
+#else
+  (void) bcode;
+#endif
+  (void) v7;
+  return 0;
+}
 #endif
 
 V7_PRIVATE void gc_dump_arena_stats(const char *msg, struct gc_arena *a) {
@@ -22901,7 +26224,7 @@ void gc_compact_strings(struct v7 *v7) {
        * the actual string.
        */
       len = decode_varint((unsigned char *) &h, &llen);
-      len += llen + 1;
+      len += llen + STR_META_SIZE + 1;
 
       /*
        * restore the saved 6 bytes
@@ -22914,15 +26237,19 @@ void gc_compact_strings(struct v7 *v7) {
        */
       memmove(v7->owned_strings.buf + head, p, len);
       v7->owned_strings.buf[head - 1] = 0x0;
+#if V7_ENABLE_STR_BUILDER
+      str_buf_mark(v7->owned_strings.buf + head);
+#endif
 #if defined(V7_GC_VERBOSE) && !V7_DISABLE_STR_ALLOC_SEQ
-      fprintf(stderr, "GC updated ASN %d: \"%.*s\"\n", asn, len - llen - 1,
-              v7->owned_strings.buf + head + llen);
+      fprintf(stderr, "GC updated ASN %d: \"%.*s\"\n", asn,
+              len - llen - STR_META_SIZE - 1,
+              v7->owned_strings.buf + head + llen + STR_META_SIZE);
 #endif
       p += len;
       head += len;
     } else {
       len = decode_varint((unsigned char *) p, &llen);
-      len += llen + 1;
+      len += llen + STR_META_SIZE + 1;
 
       p += len;
     }
@@ -22934,6 +26261,10 @@ void gc_compact_strings(struct v7 *v7) {
 #endif
 
   v7->owned_strings.len = head;
+#if V7_ENABLE_STR_BUILDER
+  str_buf_sweep(v7, 0);
+#endif
+  str_rune_cache_flush(v7);
 }
 
 void gc_dump_owned_strings(struct v7 *v7) {
@@ -22958,17 +26289,38 @@ void gc_dump_owned_strings(struct v7 *v7) {
 #define offsetof(st, m) (((ptrdiff_t)(&((st *) 32)->m)) - 32)
 #endif
 
+#if !V7_DISABLE_STR_ALLOC_SEQ
+/*
+ * Sequence numbers of owned strings are 16 bits, and a string whose number is
+ * outside of [gc_min_asn, gc_next_asn) is considered stale. With the
+ * allocation budget, many more than 65536 strings may be allocated between
+ * two collections, so a collection is also requested once this many were,
+ * leaving room for the allocations made before it actually runs.
+ *
+ * String compaction renumbers live strings from `gc_min_asn`, so this must
+ * be well above the number of strings expected to be alive at once, or every
+ * string allocation would request a collection.
+ */
+#define GC_MAX_ASN_SPAN 0xF000
+#endif
+
 V7_PRIVATE void compute_need_gc(struct v7 *v7) {
   struct mbuf *m = &v7->owned_strings;
-  if ((double) m->len / (double) m->size > 0.9) {
+  if ((double) m->len / (double) m->size > 0.9 &&
+      v7->gc_allocated >= v7->gc_budget) {
+    v7->need_gc = 1;
+  }
+#if !V7_DISABLE_STR_ALLOC_SEQ
+  if ((uint16_t)(v7->gc_next_asn - v7->gc_min_asn) > GC_MAX_ASN_SPAN) {
     v7->need_gc = 1;
   }
+#endif
   /* TODO(mkm): check free heap */
 }
 
 V7_PRIVATE int maybe_gc(struct v7 *v7) {
   if (!v7->inhibit_gc) {
-    v7_gc(v7, 0);
+    gc_collect(v7, 0, !V7_DISABLE_LAZY_SWEEP);
     return 1;
   }
   return 0;
@@ -23040,6 +26392,7 @@ static void gc_mark_call_stack_bcode(struct v7 *v7,
                                      struct v7_call_frame_bcode *call_stack) {
   gc_mark_val_array(v7, (val_t *) &call_stack->vals,
                     sizeof(call_stack->vals) / sizeof(val_t));
+  gc_mark_val_array(v7, call_stack->slots, call_stack->slots_cnt);
 }
 
 /*
@@ -23065,11 +26418,15 @@ static void gc_mark_call_stack(struct v7 *v7,
   }
 }
 
-/* Perform garbage collection */
-void v7_gc(struct v7 *v7, int full) {
+/*
+ * Perform garbage collection. If `lazy` is non-zero, the arenas are left to
+ * be swept by allocations and `v7_gc_step()`.
+ */
+static void gc_collect(struct v7 *v7, int full, int lazy) {
 #if V7_DISABLE_GC
   (void) v7;
   (void) full;
+  (void) lazy;
   return;
 #else
 
@@ -23081,6 +26438,18 @@ void v7_gc(struct v7 *v7, int full) {
   gc_dump_arena_stats("Before GC functions", &v7->function_arena);
   gc_dump_arena_stats("Before GC properties", &v7->property_arena);
 
+#ifndef V7_MALLOC_GC
+  /* marks of the previous collection are cleared by its sweep */
+  gc_sweep_finish(v7, &v7->generic_object_arena);
+  gc_sweep_finish(v7, &v7->function_arena);
+  gc_sweep_finish(v7, &v7->property_arena);
+#endif
+
+  /* freed cells will be reused, and strings relocated */
+  bcode_ic_invalidate(v7);
+
+  v7->gc_live = 0;
+
   gc_mark_call_stack(v7, v7->call_stack);
 
   gc_mark_val_array(v7, (val_t *) &v7->vals, sizeof(v7->vals) / sizeof(val_t));
@@ -23090,17 +26459,47 @@ void v7_gc(struct v7 *v7, int full) {
   /* mark literals and names of all the active bcodes */
   gc_mark_mbuf_bcode_pt(v7, &v7->act_bcodes);
 
+#if !V7_DISABLE_BCODE_CACHE
+  /* and of the cached ones */
+  {
+    struct bcode_cache_entry *e;
+    for (e = v7->bcode_cache; e != NULL; e = e->next) {
+      gc_mark_vec_val(v7, &e->bcode->lit);
+    }
+  }
+#endif
+
   gc_mark_mbuf_pt(v7, &v7->tmp_stack);
   gc_mark_mbuf_pt(v7, &v7->owned_values);
 
+  /* atoms are weak, so they go after all the other roots */
+  atom_sweep(v7);
   gc_compact_strings(v7);
 
+  /* allow the heap to grow until live data make up `gc_live_ratio` of it */
+  v7->gc_budget = (v7->gc_live + v7->owned_strings.len) / v7->gc_live_ratio *
+                  (100 - v7->gc_live_ratio);
+  if (v7->gc_budget < v7->gc_alloc_budget) {
+    v7->gc_budget = v7->gc_alloc_budget;
+  }
+  v7->gc_allocated = 0;
+#if V7_ENABLE__Memory__stats
+  v7->gc_count++;
+#endif
+
 #ifdef V7_MALLOC_GC
+  (void) lazy;
   gc_sweep_malloc(v7);
 #else
-  gc_sweep(v7, &v7->generic_object_arena, 0);
-  gc_sweep(v7, &v7->function_arena, 0);
-  gc_sweep(v7, &v7->property_arena, 0);
+  gc_sweep_begin(&v7->generic_object_arena);
+  gc_sweep_begin(&v7->function_arena);
+  gc_sweep_begin(&v7->property_arena);
+
+  if (!lazy || full) {
+    gc_sweep_finish(v7, &v7->generic_object_arena);
+    gc_sweep_finish(v7, &v7->function_arena);
+    gc_sweep_finish(v7, &v7->property_arena);
+  }
 #endif
 
   gc_dump_arena_stats("After GC objects", &v7->generic_object_arena);
@@ -23123,6 +26522,34 @@ void v7_gc(struct v7 *v7, int full) {
 #endif /* V7_DISABLE_GC */
 }
 
+void v7_gc(struct v7 *v7, int full) {
+  gc_collect(v7, full, 0);
+}
+
+int v7_gc_step(struct v7 *v7, size_t max_cells) {
+#ifdef V7_MALLOC_GC
+  (void) v7;
+  (void) max_cells;
+  return 0;
+#else
+  struct gc_arena *arenas[3];
+  size_t i, n = 0;
+
+  /* properties go last, see `gc_sweep_until_free()` */
+  arenas[0] = &v7->generic_object_arena;
+  arenas[1] = &v7->function_arena;
+  arenas[2] = &v7->property_arena;
+
+  for (i = 0; i < sizeof(arenas) / sizeof(arenas[0]); i++) {
+    while (arenas[i]->sweep != NULL) {
+      if (n >= max_cells) return 1;
+      n += gc_sweep_block(v7, arenas[i]);
+    }
+  }
+  return 0;
+#endif
+}
+
 V7_PRIVATE int gc_check_val(struct v7 *v7, val_t v) {
   if (is_js_function(v)) {
     return gc_check_ptr(&v7->function_arena, get_js_function_struct(v));
@@ -23232,7 +26659,7 @@ V7_PRIVATE void freeze_obj(struct v7 *v7, FILE *f, v7_val_t v) {
 #endif
             "}\n",
             (void *) obj_base,
-            (void *) ((uintptr_t) obj_base->properties & ~0x1),
+            (void *) ((uintptr_t) *obj_prop_list(obj_base) & ~0x1),
             obj_base->attributes | attrs, (void *) func->scope, (void *) bcode
 #if V7_ENABLE_ENTITY_IDS
             ,
@@ -23275,7 +26702,7 @@ V7_PRIVATE void freeze_obj(struct v7 *v7, FILE *f, v7_val_t v) {
 #endif
             "}\n",
             (void *) obj_base,
-            (void *) ((uintptr_t) obj_base->properties & ~0x1),
+            (void *) ((uintptr_t) *obj_prop_list(obj_base) & ~0x1),
             obj_base->attributes | attrs, (void *) gob->prototype
 #if V7_ENABLE_ENTITY_IDS
             ,
@@ -26185,7 +29612,9 @@ static lit_t string_lit(struct bcode_builder *bbuilder, struct ast *a,
   (void) v;
   (void) m;
 #endif
-  return bcode_add_lit(bbuilder, v7_mk_string(bbuilder->v7, name, name_len, 1));
+  return bcode_add_lit(
+      bbuilder,
+      atom_intern(bbuilder->v7, atom_mk_string(bbuilder->v7, name, name_len)));
 }
 
 #if V7_ENABLE__RegExp
@@ -26244,6 +29673,54 @@ static enum ast_tag fetch_tag(struct v7 *v7, struct bcode_builder *bbuilder,
   return ret;
 }
 
+/*
+ * Returns index of the call frame slot holding the variable named by the
+ * AST node at `pos`, or -1 if the variable is not local or the function
+ * doesn't use slots. If the name is declared more than once, the last
+ * declaration wins, just like when a scope object is populated by `OP_CALL`.
+ */
+static int ident_slot(struct bcode_builder *bbuilder, struct ast *a,
+                      ast_off_t pos) {
+  char *ops = bbuilder->ops.buf, *name, *n;
+  size_t i, name_len, len;
+  int ret = -1;
+
+  if (!bbuilder->bcode->uses_slots) {
+    return -1;
+  }
+
+  name = ast_get_inlined_data(a, pos, &name_len);
+  for (i = 0; i < bbuilder->bcode->names_cnt; i++) {
+    ops = bcode_next_name(ops, &n, &len);
+    if (len == name_len && memcmp(n, name, len) == 0) {
+      ret = (int) i;
+    }
+  }
+  return ret;
+}
+
+static void bcode_op_slot(struct bcode_builder *bbuilder, enum opcode op,
+                          int slot) {
+  bcode_op(bbuilder, op);
+  bcode_add_varint(bbuilder, slot);
+}
+
+/*
+ * Emits an instruction which gets (`OP_GET_VAR`, `OP_SAFE_GET_VAR`) or sets
+ * (`OP_SET_VAR`) the variable named by the AST node at `pos`. Local variables
+ * are accessed by slot.
+ */
+static void compile_var_op(struct bcode_builder *bbuilder, enum opcode op,
+                           struct ast *a, ast_off_t pos) {
+  int slot = ident_slot(bbuilder, a, pos);
+  if (slot >= 0) {
+    bcode_op_slot(bbuilder, op == OP_SET_VAR ? OP_SET_LOCAL : OP_GET_LOCAL,
+                  slot);
+  } else {
+    bcode_op_lit(bbuilder, op, string_lit(bbuilder, a, pos));
+  }
+}
+
 /*
  * a++ and a-- need to ignore the updated value.
  *
@@ -26306,17 +29783,28 @@ static enum v7_err compile_assign(struct bcode_builder *bbuilder, struct ast *a,
   ntag = fetch_tag(v7, bbuilder, a, ppos, &pos_after_tag);
 
   switch (ntag) {
-    case AST_IDENT:
-      lit = string_lit(bbuilder, a, pos_after_tag);
-      if (tag != AST_ASSIGN) {
-        bcode_op_lit(bbuilder, OP_GET_VAR, lit);
-      }
+    case AST_IDENT: {
+      int slot = ident_slot(bbuilder, a, pos_after_tag);
+      if (slot >= 0) {
+        if (tag != AST_ASSIGN) {
+          bcode_op_slot(bbuilder, OP_GET_LOCAL, slot);
+        }
 
-      V7_TRY(eval_assign_rhs(bbuilder, a, ppos, tag));
-      bcode_op_lit(bbuilder, OP_SET_VAR, lit);
+        V7_TRY(eval_assign_rhs(bbuilder, a, ppos, tag));
+        bcode_op_slot(bbuilder, OP_SET_LOCAL, slot);
+      } else {
+        lit = string_lit(bbuilder, a, pos_after_tag);
+        if (tag != AST_ASSIGN) {
+          bcode_op_lit(bbuilder, OP_GET_VAR, lit);
+        }
+
+        V7_TRY(eval_assign_rhs(bbuilder, a, ppos, tag));
+        bcode_op_lit(bbuilder, OP_SET_VAR, lit);
+      }
 
       fixup_post_op(bbuilder, tag);
       break;
+    }
     case AST_MEMBER:
     case AST_INDEX:
       switch (ntag) {
@@ -26521,7 +30009,11 @@ V7_PRIVATE enum v7_err compile_delete(struct bcode_builder *bbuilder,
 
     case AST_IDENT:
       /* Delete the scope variable (or throw an error if strict mode) */
-      if (!bbuilder->bcode->strict_mode) {
+      if (!bbuilder->bcode->strict_mode &&
+          ident_slot(bbuilder, a, pos_after_tag) >= 0) {
+        /* arguments and locals are undeletable */
+        bcode_op(bbuilder, OP_PUSH_FALSE);
+      } else if (!bbuilder->bcode->strict_mode) {
         /* put a property name */
         bcode_push_lit(bbuilder, string_lit(bbuilder, a, pos_after_tag));
         bcode_op(bbuilder, OP_DELETE_VAR);
@@ -26604,8 +30096,7 @@ V7_PRIVATE enum v7_err compile_expr_builder(struct bcode_builder *bbuilder,
       bcode_op(bbuilder, OP_NEG);
       break;
     case AST_IDENT:
-      bcode_op_lit(bbuilder, OP_GET_VAR,
-                   string_lit(bbuilder, a, pos_after_tag));
+      compile_var_op(bbuilder, OP_GET_VAR, a, pos_after_tag);
       break;
     case AST_MEMBER:
     case AST_INDEX:
@@ -26630,8 +30121,7 @@ V7_PRIVATE enum v7_err compile_expr_builder(struct bcode_builder *bbuilder,
       tag = fetch_tag(v7, bbuilder, a, &lookahead, &pos_after_tag);
       if (tag == AST_IDENT) {
         *ppos = lookahead;
-        bcode_op_lit(bbuilder, OP_SAFE_GET_VAR,
-                     string_lit(bbuilder, a, pos_after_tag));
+        compile_var_op(bbuilder, OP_SAFE_GET_VAR, a, pos_after_tag);
       } else {
         V7_TRY(compile_expr_builder(bbuilder, a, ppos));
       }
@@ -27021,6 +30511,158 @@ clean:
   return rcode;
 }
 
+/*
+ * `switch` statements having at least this many `case` clauses, all labelled
+ * with string literals or all with integer literals, are compiled to
+ * `OP_SWITCH` instead of a chain of comparisons.
+ */
+#ifndef V7_SWITCH_TABLE_MIN_CASES
+#define V7_SWITCH_TABLE_MIN_CASES 4
+#endif
+
+/* Location of the target of a `case` shadowed by a previous one */
+#define SWITCH_CASE_SHADOWED ((bcode_off_t) ~0)
+
+/*
+ * Checks whether the `case` expression at `pos` (offset of its tag) is a
+ * literal `OP_SWITCH` can dispatch on, and if so, yields its kind and key.
+ */
+static int switch_case_key(struct ast *a, ast_off_t pos,
+                           enum bcode_switch_mode *mode, uint32_t *key) {
+  enum ast_tag tag = ast_fetch_tag(a, &pos);
+  if (tag == AST_STRING) {
+    size_t len;
+    char *s = ast_get_inlined_data(a, pos, &len);
+    *mode = BCODE_SWITCH_STR;
+    *key = str_hash(s, len);
+    return 1;
+  } else if (tag == AST_NUM) {
+    double d = ast_get_num(a, pos);
+    if (d >= INT32_MIN && d <= INT32_MAX && d == (int32_t) d) {
+      *mode = BCODE_SWITCH_INT;
+      *key = (uint32_t)(int32_t) d;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* Compares string literals at `pos1` and `pos2` (offsets of their tags) */
+static int switch_case_str_eq(struct ast *a, ast_off_t pos1, ast_off_t pos2) {
+  size_t len1, len2;
+  char *s1, *s2;
+  ast_fetch_tag(a, &pos1);
+  ast_fetch_tag(a, &pos2);
+  s1 = ast_get_inlined_data(a, pos1, &len1);
+  s2 = ast_get_inlined_data(a, pos2, &len2);
+  return len1 == len2 && memcmp(s1, s2, len1) == 0;
+}
+
+/*
+ * Returns the mode of `OP_SWITCH` which can dispatch among the clauses of
+ * a `switch` statement in [pos, end), or -1 if the statement should be
+ * compiled to a chain of comparisons. Number of `case` clauses is stored into
+ * `cases`.
+ */
+static int switch_table_mode(struct ast *a, ast_off_t pos, ast_off_t end,
+                             size_t *cases) {
+  enum bcode_switch_mode mode = BCODE_SWITCH_STR, m;
+  uint32_t key;
+
+  *cases = 0;
+  while (pos < end) {
+    enum ast_tag tag = ast_fetch_tag(a, &pos);
+    ast_off_t case_end = ast_get_skip(a, pos, AST_END_SKIP);
+    ast_move_to_children(a, &pos);
+    if (tag == AST_CASE) {
+      if (!switch_case_key(a, pos, &m, &key) || (*cases > 0 && m != mode)) {
+        return -1;
+      }
+      mode = m;
+      (*cases)++;
+    }
+    pos = case_end;
+  }
+  return *cases >= V7_SWITCH_TABLE_MIN_CASES ? (int) mode : -1;
+}
+
+/*
+ * Emits `OP_SWITCH` dispatching among `cases` clauses in [pos, end), followed
+ * by the string literals it compares with (see `struct bcode_switch_slot`).
+ *
+ * For each `case`, appends the location of its target to `case_labels`, or
+ * `SWITCH_CASE_SHADOWED` if a previous `case` has the same label. Returns the
+ * location of the default target.
+ */
+static bcode_off_t compile_switch_table(struct bcode_builder *bbuilder,
+                                        struct ast *a, ast_off_t pos,
+                                        ast_off_t end,
+                                        enum bcode_switch_mode mode,
+                                        size_t cases,
+                                        struct mbuf *case_labels) {
+  struct bcode_switch_slot slot;
+  /* AST offsets of the labels of occupied slots, 0 for empty ones */
+  ast_off_t *labels;
+  bcode_off_t dfl_label, table, label;
+  size_t mask = 1, i;
+  uint8_t m = (uint8_t) mode;
+  uint32_t key;
+
+  while (mask + 1 < cases * 2) {
+    mask = mask * 2 + 1;
+  }
+  labels = (ast_off_t *) calloc(mask + 1, sizeof(*labels));
+
+  bcode_op(bbuilder, OP_SWITCH);
+  bcode_ops_append(bbuilder, &m, 1);
+  bcode_add_varint(bbuilder, mask);
+  dfl_label = bcode_add_target(bbuilder);
+  table = bcode_pos(bbuilder);
+  bcode_ops_append(bbuilder, NULL, (mask + 1) * sizeof(slot));
+  memset(bbuilder->ops.buf + table, 0, (mask + 1) * sizeof(slot));
+
+  while (pos < end) {
+    enum ast_tag tag = ast_fetch_tag(a, &pos);
+    ast_off_t case_end = ast_get_skip(a, pos, AST_END_SKIP);
+    ast_move_to_children(a, &pos);
+    if (tag == AST_CASE) {
+      switch_case_key(a, pos, &mode, &key);
+      for (i = key & mask; labels[i] != 0; i = (i + 1) & mask) {
+        memcpy(&slot, bbuilder->ops.buf + table + i * sizeof(slot),
+               sizeof(slot));
+        if (slot.key == key && (mode == BCODE_SWITCH_INT ||
+                                switch_case_str_eq(a, labels[i], pos))) {
+          break;
+        }
+      }
+
+      if (labels[i] != 0) {
+        label = SWITCH_CASE_SHADOWED;
+      } else {
+        labels[i] = pos;
+        memset(&slot, 0, sizeof(slot));
+        slot.key = key;
+        if (mode == BCODE_SWITCH_STR) {
+          ast_off_t lit_pos = pos;
+          ast_fetch_tag(a, &lit_pos);
+          slot.lit = bcode_pos(bbuilder);
+          bcode_op_lit(bbuilder, OP_PUSH_LIT,
+                       string_lit(bbuilder, a, lit_pos));
+        }
+        memcpy(bbuilder->ops.buf + table + i * sizeof(slot), &slot,
+               sizeof(slot));
+        label = table + i * sizeof(slot) +
+                offsetof(struct bcode_switch_slot, target);
+      }
+      mbuf_append(case_labels, &label, sizeof(label));
+    }
+    pos = case_end;
+  }
+
+  free(labels);
+  return dfl_label;
+}
+
 V7_PRIVATE enum v7_err compile_stmt(struct bcode_builder *bbuilder,
                                     struct ast *a, ast_off_t *ppos);
 
@@ -27351,11 +30993,11 @@ V7_PRIVATE enum v7_err compile_stmt(struct bcode_builder *bbuilder,
      *   <E>
      *   DUP
      *   <C1>
-     *   EQ
+     *   EQ_EQ
      *   JMP_TRUE_DROP l1
      *   DUP
      *   <C2>
-     *   EQ
+     *   EQ_EQ
      *   JMP_TRUE_DROP l2
      *   DROP
      *   JMP dfl
@@ -27377,12 +31019,18 @@ V7_PRIVATE enum v7_err compile_stmt(struct bcode_builder *bbuilder,
      *
      * Before emitting a case/default block (except the first one) we have to
      * drop the TOS resulting from evaluating the last expression
+     *
+     * If all the case expressions are string literals, or all are integer
+     * literals, the DUP/EQ_EQ/JMP_TRUE_DROP chain, DROP and JMP are replaced
+     * with a single SWITCH carrying a hash table of l1, l2, ... and dfl, see
+     * `compile_switch_table()`.
      */
     case AST_SWITCH: {
-      bcode_off_t dfl_label, end_label;
+      bcode_off_t dfl_label = 0, end_label;
       ast_off_t case_end, case_start;
       enum ast_tag case_tag;
-      int i, has_default = 0, cases = 0;
+      int i, has_default = 0, cases = 0, table_mode;
+      size_t table_cases;
 
       end = ast_get_skip(a, pos_after_tag, AST_END_SKIP);
 
@@ -27391,6 +31039,14 @@ V7_PRIVATE enum v7_err compile_stmt(struct bcode_builder *bbuilder,
       V7_TRY(compile_expr_builder(bbuilder, a, ppos));
 
       case_start = *ppos;
+      table_mode = switch_table_mode(a, case_start, end, &table_cases);
+      if (table_mode >= 0) {
+        dfl_label = compile_switch_table(bbuilder, a, case_start, end,
+                                         (enum bcode_switch_mode) table_mode,
+                                         table_cases, &case_labels);
+        cases = (int) table_cases;
+        *ppos = end;
+      }
       /* first pass: evaluate case expression and generate jump table */
       while (*ppos < end) {
         case_tag = fetch_tag(v7, bbuilder, a, ppos, &pos_after_tag);
@@ -27406,7 +31062,7 @@ V7_PRIVATE enum v7_err compile_stmt(struct bcode_builder *bbuilder,
             bcode_off_t case_label;
             bcode_op(bbuilder, OP_DUP);
             V7_TRY(compile_expr_builder(bbuilder, a, ppos));
-            bcode_op(bbuilder, OP_EQ);
+            bcode_op(bbuilder, OP_EQ_EQ);
             case_label = bcode_op_target(bbuilder, OP_JMP_TRUE_DROP);
             cases++;
             mbuf_append(&case_labels, &case_label, sizeof(case_label));
@@ -27418,9 +31074,11 @@ V7_PRIVATE enum v7_err compile_stmt(struct bcode_builder *bbuilder,
         *ppos = case_end;
       }
 
-      /* jmp table epilogue: unconditional jump to default case */
-      bcode_op(bbuilder, OP_DROP);
-      dfl_label = bcode_op_target(bbuilder, OP_JMP);
+      if (table_mode < 0) {
+        /* jmp table epilogue: unconditional jump to default case */
+        bcode_op(bbuilder, OP_DROP);
+        dfl_label = bcode_op_target(bbuilder, OP_JMP);
+      }
 
       *ppos = case_start;
       /* second pass: emit case bodies and patch jump table */
@@ -27440,7 +31098,9 @@ V7_PRIVATE enum v7_err compile_stmt(struct bcode_builder *bbuilder,
             break;
           case AST_CASE: {
             bcode_off_t case_label = ((bcode_off_t *) case_labels.buf)[i++];
-            bcode_patch_target(bbuilder, case_label, bcode_pos(bbuilder));
+            if (case_label != SWITCH_CASE_SHADOWED) {
+              bcode_patch_target(bbuilder, case_label, bcode_pos(bbuilder));
+            }
             ast_skip_tree(a, ppos);
             V7_TRY(compile_stmts(bbuilder, a, ppos, case_end));
             break;
@@ -27500,7 +31160,7 @@ V7_PRIVATE enum v7_err compile_stmt(struct bcode_builder *bbuilder,
        */
       if (tag == AST_VAR) {
         ast_off_t fvar_end;
-        lit_t lit;
+        ast_off_t name_pos;
 
         *ppos = lookahead;
         fvar_end = ast_get_skip(a, pos_after_tag, AST_END_SKIP);
@@ -27513,11 +31173,11 @@ V7_PRIVATE enum v7_err compile_stmt(struct bcode_builder *bbuilder,
           tag = fetch_tag(v7, bbuilder, a, ppos, &pos_after_tag);
           /* Only var declarations are allowed (not function declarations) */
           V7_CHECK_INTERNAL(tag == AST_VAR_DECL);
-          lit = string_lit(bbuilder, a, pos_after_tag);
+          name_pos = pos_after_tag;
           V7_TRY(compile_expr_builder(bbuilder, a, ppos));
 
           /* Just like an assigment */
-          bcode_op_lit(bbuilder, OP_SET_VAR, lit);
+          compile_var_op(bbuilder, OP_SET_VAR, a, name_pos);
 
           /* INIT is stack-neutral */
           bcode_op(bbuilder, OP_DROP);
@@ -27610,7 +31270,7 @@ V7_PRIVATE enum v7_err compile_stmt(struct bcode_builder *bbuilder,
      *
      */
     case AST_FOR_IN: {
-      lit_t lit;
+      ast_off_t name_pos;
       bcode_off_t loop_label, loop_target, end_label, brend_label,
           continue_label, pop_label, continue_target;
       ast_off_t end = ast_get_skip(a, pos_after_tag, AST_END_SKIP);
@@ -27620,11 +31280,11 @@ V7_PRIVATE enum v7_err compile_stmt(struct bcode_builder *bbuilder,
       if (tag == AST_VAR) {
         tag = fetch_tag(v7, bbuilder, a, ppos, &pos_after_tag);
         V7_CHECK_INTERNAL(tag == AST_VAR_DECL);
-        lit = string_lit(bbuilder, a, pos_after_tag);
+        name_pos = pos_after_tag;
         ast_skip_tree(a, ppos);
       } else {
         V7_CHECK_INTERNAL(tag == AST_IDENT);
-        lit = string_lit(bbuilder, a, pos_after_tag);
+        name_pos = pos_after_tag;
       }
 
       /*
@@ -27663,7 +31323,7 @@ V7_PRIVATE enum v7_err compile_stmt(struct bcode_builder *bbuilder,
 
       bcode_op(bbuilder, OP_NEXT_PROP);
       end_label = bcode_op_target(bbuilder, OP_JMP_FALSE);
-      bcode_op_lit(bbuilder, OP_SET_VAR, lit);
+      compile_var_op(bbuilder, OP_SET_VAR, a, name_pos);
 
       /*
        * The stash register contains the value of the previous statement,
@@ -27763,7 +31423,7 @@ V7_PRIVATE enum v7_err compile_stmt(struct bcode_builder *bbuilder,
        * no new variables should be created in it. A var decl thus
        * behaves as a normal assignment at runtime.
        */
-      lit_t lit;
+      ast_off_t name_pos;
       end = ast_get_skip(a, pos_after_tag, AST_END_SKIP);
       while (*ppos < end) {
         tag = fetch_tag(v7, bbuilder, a, ppos, &pos_after_tag);
@@ -27784,9 +31444,9 @@ V7_PRIVATE enum v7_err compile_stmt(struct bcode_builder *bbuilder,
            * stack-neutral: `1; var a = 5;` yields `1`, not `5`.
            */
           V7_CHECK_INTERNAL(tag == AST_VAR_DECL);
-          lit = string_lit(bbuilder, a, pos_after_tag);
+          name_pos = pos_after_tag;
           V7_TRY(compile_expr_builder(bbuilder, a, ppos));
-          bcode_op_lit(bbuilder, OP_SET_VAR, lit);
+          compile_var_op(bbuilder, OP_SET_VAR, a, name_pos);
 
           /* `var` declaration is stack-neutral */
           bcode_op(bbuilder, OP_DROP);
@@ -27813,6 +31473,92 @@ clean:
   return rcode;
 }
 
+/*
+ * Checks whether the function body `[pos, end)` may refer to the `arguments`
+ * object: either directly, or via `eval`. Nested functions have their own
+ * `arguments`, so they are skipped.
+ */
+static int body_uses_arguments(struct ast *a, ast_off_t pos, ast_off_t end) {
+  while (pos < end) {
+    enum ast_tag tag = ast_fetch_tag(a, &pos);
+    char *name;
+    size_t name_len;
+
+    switch (tag) {
+      case AST_FUNC:
+        pos = ast_get_skip(a, pos, AST_END_SKIP);
+        continue;
+      case AST_IDENT:
+        name = ast_get_inlined_data(a, pos, &name_len);
+        if ((name_len == 4 && strncmp(name, "eval", 4) == 0) ||
+            (name_len == 9 && strncmp(name, "arguments", 9) == 0)) {
+          return 1;
+        }
+        break;
+      default:
+        break;
+    }
+
+    ast_move_to_children(a, &pos);
+  }
+
+  return 0;
+}
+
+#if !V7_DISABLE_LOCAL_SLOTS
+/*
+ * Checks whether arguments and locals of the function body `[pos, end)` can
+ * be kept in call frame slots: it's not the case if some code may need to
+ * look them up by name in a scope object, i.e. if there are nested functions
+ * (closures), `with`, `eval` or `arguments`, or a `catch` clause whose
+ * variable shadows a local one.
+ */
+static int can_use_slots(struct bcode_builder *bbuilder, struct ast *a,
+                         ast_off_t pos, ast_off_t end) {
+  int ret = 1;
+  uint8_t saved_uses_slots = bbuilder->bcode->uses_slots;
+  bbuilder->bcode->uses_slots = 1;
+
+  /* nodes are stored in pre-order, so we visit all of them one by one */
+  while (ret && pos < end) {
+    enum ast_tag tag = ast_fetch_tag(a, &pos);
+    ast_off_t pos_after_tag = pos;
+    char *name;
+    size_t name_len;
+
+    switch (tag) {
+      case AST_FUNC:
+      case AST_WITH:
+        ret = 0;
+        break;
+      case AST_IDENT:
+        name = ast_get_inlined_data(a, pos_after_tag, &name_len);
+        if ((name_len == 4 && strncmp(name, "eval", 4) == 0) ||
+            (name_len == 9 && strncmp(name, "arguments", 9) == 0)) {
+          ret = 0;
+        }
+        break;
+      case AST_TRY: {
+        ast_off_t acatch = ast_get_skip(a, pos_after_tag, AST_TRY_CATCH_SKIP);
+        if (acatch != ast_get_skip(a, pos_after_tag, AST_TRY_FINALLY_SKIP) &&
+            ast_fetch_tag(a, &acatch) == AST_IDENT &&
+            ident_slot(bbuilder, a, acatch) >= 0) {
+          ret = 0;
+        }
+        break;
+      }
+      default:
+        break;
+    }
+
+    ast_move_to_children(a, &pos);
+  }
+
+  bbuilder->bcode->uses_slots = saved_uses_slots;
+  return ret;
+}
+#endif
+
 static enum v7_err compile_body(struct bcode_builder *bbuilder, struct ast *a,
                                 ast_off_t start, ast_off_t end, ast_off_t body,
                                 ast_off_t fvar, ast_off_t *ppos) {
@@ -27842,6 +31588,14 @@ static enum v7_err compile_body(struct bcode_builder *bbuilder, struct ast *a,
    */
   V7_TRY(compile_local_vars(bbuilder, a, start, fvar));
 
+  if (bbuilder->bcode->func_name_present) {
+    bbuilder->bcode->uses_arguments = body_uses_arguments(a, body, end);
+#if !V7_DISABLE_LOCAL_SLOTS
+    /* functions might get by without a scope object */
+    bbuilder->bcode->uses_slots = can_use_slots(bbuilder, a, body, end);
+#endif
+  }
+
   /* compile body */
   *ppos = body;
   V7_TRY(compile_stmts(bbuilder, a, ppos, end));
@@ -28275,6 +32029,10 @@ V7_PRIVATE enum v7_err Std_exit(struct v7 *v7, v7_val_t *res) {
   v7->vals.function_prototype = v7_mk_object(v7);
   v7->vals.proxy_prototype = v7_mk_object(v7);
 
+  /* implicit prototype of all functions, see `obj_prototype()` */
+  get_object_struct(v7->vals.function_prototype)->attributes |=
+      V7_OBJ_PROTOTYPE;
+
   set_method(v7, v7->vals.global_object, "eval", Std_eval, 1);
   set_method(v7, v7->vals.global_object, "print", Std_print, 1);
 #ifndef NO_LIBC
@@ -28356,29 +32114,6 @@ static const char js_array_lastIndexOf[] = STRINGIFY(
         return r;
     }}););
 
-#if V7_ENABLE__Array__reduce
-static const char js_array_reduce[] = STRINGIFY(
-    Object.defineProperty(Array.prototype, "reduce", {
-      writable:true,
-      configurable: true,
-      value: function(a, b) {
-        var f = 0;
-        if (typeof(a) != "function") {
-          throw new TypeError(a + " is not a function");
-        }
-        for (var k in this) {
-          if (k > this.length) break;
-          if (f == 0 && b === undefined) {
-            b = this[k];
-            f = 1;
-          } else {
-            b = a(b, this[k], k, this);
-          }
-        }
-        return b;
-    }}););
-#endif
-
 static const char js_array_pop[] = STRINGIFY(
     Object.defineProperty(Array.prototype, "pop", {
       writable:true,
@@ -28436,9 +32171,6 @@ static const char * const js_functions[] = {
 #endif
 #if V7_ENABLE__Function__bind
   js_function_bind,
-#endif
-#if V7_ENABLE__Array__reduce
-  js_array_reduce,
 #endif
   js_array_indexOf,
   js_array_lastIndexOf,
@@ -28511,6 +32243,9 @@ static const char * const js_functions[] = {
 #define SLRE_MAX_RANGES 32
 #define SLRE_MAX_SETS 16
 #define SLRE_MAX_REP 0xFFFF
+/* Largest Pike VM working memory, bigger programs are run by backtracking */
+#define SLRE_MAX_PIKE_SIZE (256 * 1024)
+#define SLRE_MAX_PREFIX 16
 
 #define SLRE_MALLOC malloc
 #define SLRE_FREE free
@@ -28615,11 +32350,27 @@ struct slre_instruction {
   } par;
 };
 
+enum slre_scan {
+  SLRE_SCAN_NONE,     /* Any position can start a match */
+  SLRE_SCAN_ANCHORED, /* Only the first position can start a match */
+  SLRE_SCAN_PREFIX,   /* Matches start with `prefix` */
+  SLRE_SCAN_SET       /* Matches start with a byte from `first` */
+};
+
 struct slre_prog {
   struct slre_instruction *start, *end;
   unsigned int num_captures;
   int flags;
+  int refcnt;
+  int backtrack;          /* Program needs the backtracking matcher */
+  struct slre_pike *pike; /* Pike VM working memory, allocated on first use */
   struct slre_class charset[SLRE_MAX_SETS];
+
+  /* How to find positions a match can start at, see `re_scan()` */
+  enum slre_scan scan;
+  unsigned char first[32]; /* Bitmap of bytes a match can start with */
+  unsigned char prefix_len;
+  char prefix[SLRE_MAX_PREFIX]; /* Literal every match starts with */
 };
 
 struct slre_env {
@@ -28653,6 +32404,27 @@ struct slre_thread {
   struct slre_loot loot;
 };
 
+/*
+ * Pike VM state: threads are kept in two lists (the current input position
+ * and the next one), in priority order. Captures of the thread `i` of a list
+ * live at `caps + i * 2 * num_captures`. Instructions already reached at the
+ * current position carry the current `gen` in `marks`.
+ */
+struct slre_pike_frame {
+  struct slre_instruction *pc; /* NULL: restore `caps[slot]` to `old` */
+  unsigned int slot;
+  const char *old;
+};
+
+struct slre_pike {
+  struct slre_instruction **clist, **nlist;
+  const char **ccaps, **ncaps;
+  const char **caps; /* Captures of the thread being added */
+  struct slre_pike_frame *stack;
+  unsigned int *marks;
+  unsigned int cnt, ncnt, gen;
+};
+
 enum slre_opcode {
   I_END = 10, /* Terminate: match found */
   I_ANY,
@@ -29589,6 +33361,156 @@ static void program_print(struct slre_prog *prog) {
 }
 #endif
 
+static size_t re_pike_size(struct slre_prog *prog) {
+  size_t n = prog->end - prog->start, nslots = 2 * prog->num_captures;
+  return sizeof(struct slre_pike) + (n + 1) * sizeof(struct slre_pike_frame) +
+         (2 * n + (2 * n + 1) * nslots) * sizeof(void *) +
+         n * sizeof(unsigned int);
+}
+
+/*
+ * Backreferences, lookaheads and counted repetitions (which keep their
+ * counters in the program) are only supported by the backtracking matcher.
+ */
+static int re_needs_backtrack(struct slre_prog *prog) {
+  struct slre_instruction *pc;
+  for (pc = prog->start; pc < prog->end; pc++) {
+    switch (pc->opcode) {
+      case I_LA:
+      case I_LA_N:
+      case I_REF:
+      case I_REP:
+      case I_REP_INI:
+        return 1;
+    }
+  }
+  return re_pike_size(prog) > SLRE_MAX_PIKE_SIZE;
+}
+
+/*
+ * Adds the leading bytes of runes `lo` to `hi` to the bitmap of bytes a match
+ * can start with. Returns 0 if they can't be told by their first byte.
+ */
+static int re_first_add(struct slre_prog *prog, Rune lo, Rune hi) {
+  Rune c, l;
+  if (lo == 0) lo = 1; /* NUL never matches */
+  for (c = lo; c <= hi && c < 0x80; c++) {
+    prog->first[c >> 3] |= 1 << (c & 7);
+    if (prog->flags & SLRE_FLAG_I) {
+      l = tolowerrune(c);
+      prog->first[l >> 3] |= 1 << (l & 7);
+      l = toupperrune(c);
+      prog->first[l >> 3] |= 1 << (l & 7);
+    }
+  }
+  if (hi >= 0x80 || (prog->flags & SLRE_FLAG_I)) {
+#if CS_ENABLE_UTF8
+    if (hi >= 0x80 && ((prog->flags & SLRE_FLAG_I) ||
+                       (lo <= Runeerror && Runeerror <= hi))) {
+      return 0;
+    }
+    /* Any multibyte rune, including ones folding to ASCII with `i` */
+    for (c = 0xC0; c <= 0xFF; c++) prog->first[c >> 3] |= 1 << (c & 7);
+#else
+    for (c = 0x80; c <= 0xFF; c++) prog->first[c >> 3] |= 1 << (c & 7);
+#endif
+  }
+  return 1;
+}
+
+/*
+ * Finds out what matches of the program can start with: a literal prefix, or
+ * a set of bytes. Walks all the paths from the start of the pattern up to the
+ * first instruction consuming input; a path starting with `^` (when not
+ * multiline) only matches at the beginning and adds nothing.
+ */
+static void re_scan_init(struct slre_prog *prog) {
+  size_t n = prog->end - prog->start, sp = 0, i, cnt = 0;
+  struct slre_instruction **stack, *pc;
+  struct slre_range *r;
+  unsigned char *seen;
+  Rune c;
+
+  prog->scan = SLRE_SCAN_NONE;
+  prog->prefix_len = 0;
+  memset(prog->first, 0, sizeof(prog->first));
+
+  if (!(prog->flags & SLRE_FLAG_I)) {
+    for (pc = prog->start->par.xy.x; pc < prog->end; pc++) {
+      if (pc->opcode == I_LBRA || pc->opcode == I_RBRA) continue;
+      if (pc->opcode != I_CH || pc->par.c == 0 || pc->par.c == Runeerror ||
+          (size_t) prog->prefix_len + UTFmax > sizeof(prog->prefix)) {
+        break;
+      }
+      c = pc->par.c;
+      prog->prefix_len += runetochar(prog->prefix + prog->prefix_len, &c);
+    }
+    if (prog->prefix_len > 0) {
+      prog->scan = SLRE_SCAN_PREFIX;
+      return;
+    }
+  }
+
+  stack = (struct slre_instruction **) SLRE_MALLOC(
+      (2 * n + 1) * sizeof(*stack) + n);
+  if (stack == NULL) return;
+  seen = (unsigned char *) (stack + 2 * n + 1);
+  memset(seen, 0, n);
+  stack[sp++] = prog->start->par.xy.x;
+  while (sp > 0) {
+    pc = stack[--sp];
+    if (seen[pc - prog->start]++) continue;
+    switch (pc->opcode) {
+      case I_JUMP:
+        stack[sp++] = pc->par.xy.x;
+        continue;
+      case I_SPLIT:
+        stack[sp++] = pc->par.xy.x;
+        stack[sp++] = pc->par.xy.y.y;
+        continue;
+      case I_BOL:
+        if (!(prog->flags & SLRE_FLAG_M)) continue;
+      /* fall through */
+      case I_LBRA:
+      case I_RBRA:
+      case I_EOL:
+      case I_EOS:
+      case I_WORD:
+      case I_WORD_N:
+        stack[sp++] = pc + 1;
+        continue;
+      case I_CH:
+        if (re_first_add(prog, pc->par.c, pc->par.c)) continue;
+        break;
+      case I_SET:
+        for (r = pc->par.cp->spans; r < pc->par.cp->end; r++) {
+          if (!re_first_add(prog, r->s, r->e)) break;
+        }
+        if (r == pc->par.cp->end) continue;
+        break;
+    }
+    /* Empty match, or a match starting with any character */
+    SLRE_FREE(stack);
+    return;
+  }
+  SLRE_FREE(stack);
+
+  for (i = 0; i < 256; i++) {
+    if (prog->first[i >> 3] & (1 << (i & 7))) {
+      prog->prefix[0] = (char) i;
+      cnt++;
+    }
+  }
+  if (cnt == 0) {
+    prog->scan = SLRE_SCAN_ANCHORED;
+  } else if (cnt == 1) {
+    prog->prefix_len = 1;
+    prog->scan = SLRE_SCAN_PREFIX;
+  } else {
+    prog->scan = SLRE_SCAN_SET;
+  }
+}
+
 int slre_compile(const char *pat, size_t pat_len, const char *flags,
                  volatile size_t fl_len, struct slre_prog **pr, int is_regex) {
   struct slre_env e;
@@ -29601,6 +33523,7 @@ int slre_compile(const char *pat, size_t pat_len, const char *flags,
   e.pstart = e.pend =
       (struct slre_node *) SLRE_MALLOC(sizeof(struct slre_node) * pat_len * 2);
   e.prog->flags = is_regex ? SLRE_FLAG_RE : 0;
+  e.prog->refcnt = 1;
 
   if ((err_code = setjmp(e.jmp_buf)) != SLRE_OK) {
     SLRE_FREE(e.pstart);
@@ -29652,6 +33575,9 @@ int slre_compile(const char *pat, size_t pat_len, const char *flags,
   re_compile(&e, nd);
   re_newinst(e.prog, I_RBRA);
   re_newinst(e.prog, I_END);
+  e.prog->backtrack = re_needs_backtrack(e.prog);
+  e.prog->pike = NULL;
+  re_scan_init(e.prog);
 
 #ifdef RE_TEST
   node_print(nd);
@@ -29670,8 +33596,14 @@ int slre_compile(const char *pat, size_t pat_len, const char *flags,
   return err_code;
 }
 
+struct slre_prog *slre_retain(struct slre_prog *prog) {
+  prog->refcnt++;
+  return prog;
+}
+
 void slre_free(struct slre_prog *prog) {
-  if (prog) {
+  if (prog && --prog->refcnt == 0) {
+    SLRE_FREE(prog->pike);
     SLRE_FREE(prog->start);
     SLRE_FREE(prog);
   }
@@ -29700,12 +33632,27 @@ static void free_threads(struct slre_thread *t) {
   while (t->prev != NULL) t = get_prev_thread(t);
 }
 
+/* Tests `c` against the class of an `I_SET` or `I_SET_N` instruction */
+static int re_inset(struct slre_instruction *pc, Rune c, unsigned int flags) {
+  struct slre_range *p;
+  Rune r;
+  for (p = pc->par.cp->spans; p < pc->par.cp->end; p++) {
+    if (flags & SLRE_FLAG_I) {
+      for (r = p->s; r <= p->e; ++r) {
+        if (tolowerrune(c) == tolowerrune(r)) return pc->opcode == I_SET;
+      }
+    } else if (p->s <= c && c <= p->e) {
+      return pc->opcode == I_SET;
+    }
+  }
+  return pc->opcode == I_SET_N;
+}
+
 static unsigned char re_match(struct slre_instruction *pc, const char *current,
                               const char *end, const char *bol,
                               unsigned int flags, struct slre_loot *loot) {
   struct slre_loot sub, tmpsub;
   Rune c, r;
-  struct slre_range *p;
   size_t i;
   struct slre_thread thread, *curr_thread, *tmp_thr;
 
@@ -29817,21 +33764,7 @@ static unsigned char re_match(struct slre_instruction *pc, const char *current,
         case I_SET_N:
           if (current >= end) goto no_match;
           current += chartorune(&c, current);
-          if (!c) goto no_match;
-
-          i = 1;
-          for (p = pc->par.cp->spans; i && p < pc->par.cp->end; p++)
-            if (flags & SLRE_FLAG_I) {
-              for (r = p->s; r <= p->e; ++r)
-                if (tolowerrune(c) == tolowerrune(r)) {
-                  i = 0;
-                  break;
-                }
-            } else if (p->s <= c && c <= p->e)
-              i = 0;
-
-          if (pc->opcode == I_SET) i = !i;
-          if (i) break;
+          if (c && re_inset(pc, c, flags)) break;
           goto no_match;
 
         case I_SPLIT:
@@ -29865,6 +33798,266 @@ static unsigned char re_match(struct slre_instruction *pc, const char *current,
   return 0;
 }
 
+/*
+ * Pike VM: runs all the threads of the program in lockstep over the input,
+ * so matching is linear in the input length and never allocates. Threads
+ * are kept in priority order and the ones below a thread that reached
+ * `I_END` are dropped, which gives the same leftmost-first result as
+ * `re_match()`.
+ */
+static struct slre_pike *re_pike_new(struct slre_prog *prog) {
+  size_t n = prog->end - prog->start, nslots = 2 * prog->num_captures;
+  struct slre_pike *w = (struct slre_pike *) SLRE_MALLOC(re_pike_size(prog));
+  if (w == NULL) return NULL;
+  w->stack = (struct slre_pike_frame *) (w + 1);
+  w->clist = (struct slre_instruction **) (w->stack + n + 1);
+  w->nlist = w->clist + n;
+  w->ccaps = (const char **) (w->nlist + n);
+  w->ncaps = w->ccaps + n * nslots;
+  w->caps = w->ncaps + n * nslots;
+  w->marks = (unsigned int *) (w->caps + nslots);
+  memset(w->marks, 0, n * sizeof(unsigned int));
+  w->gen = 0;
+  return w;
+}
+
+static void re_pike_step(struct slre_prog *prog, struct slre_pike *w) {
+  if (++w->gen == 0) {
+    memset(w->marks, 0, (prog->end - prog->start) * sizeof(unsigned int));
+    w->gen = 1;
+  }
+}
+
+/*
+ * Adds the thread starting at `pc` with captures `w->caps` to the next list,
+ * following jumps, splits, brackets and assertions in priority order.
+ */
+static void re_pike_add(struct slre_prog *prog, struct slre_pike *w,
+                        struct slre_instruction *pc, const char *current,
+                        const char *end, const char *bol) {
+  struct slre_pike_frame *sp = w->stack;
+  unsigned int nslots = 2 * prog->num_captures, i;
+  int flags = prog->flags;
+
+  sp->pc = pc;
+  sp++;
+  while (sp > w->stack) {
+    sp--;
+    if (sp->pc == NULL) {
+      w->caps[sp->slot] = sp->old;
+      continue;
+    }
+    for (pc = sp->pc; w->marks[pc - prog->start] != w->gen;) {
+      w->marks[pc - prog->start] = w->gen;
+      switch (pc->opcode) {
+        case I_JUMP:
+          pc = pc->par.xy.x;
+          continue;
+        case I_SPLIT:
+          sp->pc = pc->par.xy.y.y;
+          sp++;
+          pc = pc->par.xy.x;
+          continue;
+        case I_LBRA:
+        case I_RBRA:
+          i = 2 * pc->par.n + (pc->opcode == I_RBRA);
+          sp->pc = NULL;
+          sp->slot = i;
+          sp->old = w->caps[i];
+          sp++;
+          w->caps[i] = current;
+          pc++;
+          continue;
+        case I_BOL:
+          if (current == bol ||
+              ((flags & SLRE_FLAG_M) && isnewline(current[-1]))) {
+            pc++;
+            continue;
+          }
+          break;
+        case I_EOL:
+          if (current >= end || ((flags & SLRE_FLAG_M) && isnewline(*current))) {
+            pc++;
+            continue;
+          }
+          break;
+        case I_EOS:
+          if (current >= end) {
+            pc++;
+            continue;
+          }
+          break;
+        case I_WORD:
+        case I_WORD_N:
+          i = (current > bol && iswordchar(current[-1]));
+          if (iswordchar(current[0])) i = !i;
+          if (pc->opcode == I_WORD_N) i = !i;
+          if (i) {
+            pc++;
+            continue;
+          }
+          break;
+        default:
+          i = w->ncnt++;
+          w->nlist[i] = pc;
+          memcpy(w->ncaps + i * nslots, w->caps, nslots * sizeof(*w->caps));
+          break;
+      }
+      break;
+    }
+  }
+}
+
+/*
+ * Returns the first position from `p` on where a match can start, or NULL if
+ * there is none. Like `I_ANYNL`, never looks past a NUL character.
+ */
+static const char *re_scan(struct slre_prog *prog, const char *p,
+                           const char *end) {
+  const char *q;
+  unsigned char b;
+
+  switch (prog->scan) {
+    case SLRE_SCAN_PREFIX:
+      for (; p < end; p = q + 1) {
+        q = (const char *) memchr(p, prog->prefix[0], end - p);
+        if (q == NULL || memchr(p, '\0', q - p) != NULL ||
+            (size_t)(end - q) < prog->prefix_len) {
+          break;
+        }
+        if (!memcmp(q, prog->prefix, prog->prefix_len)) return q;
+      }
+      return NULL;
+    case SLRE_SCAN_SET:
+      for (; p < end && (b = (unsigned char) *p) != 0; p++) {
+        if (prog->first[b >> 3] & (1 << (b & 7))) return p;
+      }
+      return NULL;
+    case SLRE_SCAN_NONE:
+      return p;
+    default:
+      return NULL;
+  }
+}
+
+static unsigned char re_pike_match(struct slre_prog *prog, const char *current,
+                                   const char *end, const char *bol,
+                                   struct slre_loot *loot) {
+  struct slre_pike *w = prog->pike;
+  struct slre_instruction *pc, **tl, *search = prog->start->par.xy.y.y;
+  const char **caps, **search_caps = NULL, *next;
+  unsigned int nslots = 2 * prog->num_captures, i, j;
+  unsigned char matched = 0;
+  int flags = prog->flags, ok, live;
+  Rune c;
+
+  for (i = 0; i < prog->num_captures; i++) {
+    w->caps[2 * i] = loot->caps[i].start;
+    w->caps[2 * i + 1] = loot->caps[i].end;
+  }
+  re_pike_step(prog, w);
+  w->ncnt = 0;
+  re_pike_add(prog, w, prog->start, current, end, bol);
+
+  while (w->ncnt > 0) {
+    tl = w->clist, w->clist = w->nlist, w->nlist = tl;
+    caps = w->ccaps, w->ccaps = w->ncaps, w->ncaps = caps;
+    w->cnt = w->ncnt;
+    w->ncnt = 0;
+    re_pike_step(prog, w);
+
+    c = 0;
+    next = current;
+    if (current < end) next += chartorune(&c, current);
+
+    live = -1;
+    for (i = 0; i < w->cnt; i++) {
+      pc = w->clist[i];
+      caps = w->ccaps + i * nslots;
+      switch (pc->opcode) {
+        case I_END:
+          for (j = 0; j < prog->num_captures; j++) {
+            loot->caps[j].start = caps[2 * j];
+            loot->caps[j].end = caps[2 * j + 1];
+          }
+          matched = 1;
+          ok = -1;
+          break;
+        case I_ANY:
+          ok = c && !isnewline(c);
+          break;
+        case I_ANYNL:
+          ok = c != 0;
+          break;
+        case I_CH:
+          ok = c && (c == pc->par.c ||
+                     ((flags & SLRE_FLAG_I) &&
+                      tolowerrune(c) == tolowerrune(pc->par.c)));
+          break;
+        case I_SET:
+        case I_SET_N:
+          ok = c && re_inset(pc, c, flags);
+          break;
+        default:
+          ok = 0;
+          break;
+      }
+      /* Lower priority threads can not win over a match */
+      if (ok < 0) break;
+      if (ok) {
+        if (pc == search) {
+          live = w->ncnt;
+          search_caps = caps;
+        }
+        memcpy(w->caps, caps, nslots * sizeof(*caps));
+        re_pike_add(prog, w, pc + 1, next, end, bol);
+      }
+    }
+    current = next;
+
+    /* No match is in progress: skip to where the next one can start */
+    if (live == 0 && prog->scan != SLRE_SCAN_NONE) {
+      if ((next = re_scan(prog, current, end)) == NULL) break;
+      if (next != current) {
+        current = next;
+        memcpy(w->caps, search_caps, nslots * sizeof(*search_caps));
+        re_pike_step(prog, w);
+        w->ncnt = 0;
+        re_pike_add(prog, w, prog->start, current, end, bol);
+      }
+    }
+  }
+  return matched;
+}
+
+static unsigned char re_exec(struct slre_prog *prog, const char *current,
+                             const char *end, const char *bol,
+                             struct slre_loot *loot) {
+  const char *p;
+  Rune c;
+
+  if (!prog->backtrack && prog->pike == NULL) {
+    prog->pike = re_pike_new(prog);
+  }
+  if (prog->pike != NULL) {
+    return re_pike_match(prog, current, end, bol, loot);
+  }
+  if (prog->scan == SLRE_SCAN_NONE) {
+    return re_match(prog->start, current, end, bol, prog->flags, loot);
+  }
+
+  /* Try the pattern itself only where a match can start */
+  for (p = current; p != NULL; p = re_scan(prog, p, end)) {
+    if (re_match(prog->start->par.xy.x, p, end, bol, prog->flags, loot)) {
+      return 1;
+    }
+    if (p >= end) break;
+    p += chartorune(&c, p);
+    if (c == 0) break;
+  }
+  return 0;
+}
+
 int slre_exec(struct slre_prog *prog, int flag_g, const char *start,
               const char *end, struct slre_loot *loot) {
   struct slre_loot tmpsub;
@@ -29875,10 +34068,11 @@ int slre_exec(struct slre_prog *prog, int flag_g, const char *start,
 
   if (!flag_g) {
     loot->num_captures = prog->num_captures;
-    return !re_match(prog->start, start, end, start, prog->flags, loot);
+    return !re_exec(prog, start, end, start, loot);
   }
 
-  while (re_match(prog->start, st, end, start, prog->flags, &tmpsub)) {
+  memset(&tmpsub, 0, sizeof(tmpsub));
+  while (re_exec(prog, st, end, start, &tmpsub)) {
     unsigned int i;
     st = tmpsub.caps[0].end;
     for (i = 0; i < prog->num_captures; i++) {
@@ -30513,6 +34707,336 @@ int v7_stack_track_end(struct v7 *v7, struct stack_track_ctx *ctx) {
 #endif /* V7_ENABLE_STACK_TRACKING */
 #endif /* V7_CYG_PROFILE_ON */
 #ifdef V7_MODULE_LINES
+#line 1 "v7/src/profiler.c"
+#endif
+/*
+ * Copyright (c) 2014 Cesanta Software Limited
+ * All rights reserved
+ */
+
+/*
+ * Instruction-level profiler of the bcode. `eval_bcode()` counts down the
+ * executed instructions, and every `period`-th one is handed to
+ * `prof_sample()`, which attributes `period` instructions and the wall time
+ * elapsed since the previous sample to the previously sampled site; in the
+ * counting mode (period 1) this is exactly the time each instruction took.
+ */
+
+/* Amalgamated: #include "v7/src/internal.h" */
+/* Amalgamated: #include "v7/src/profiler.h" */
+/* Amalgamated: #include "v7/src/core.h" */
+/* Amalgamated: #include "v7/src/bcode.h" */
+/* Amalgamated: #include "v7/src/shdata.h" */
+
+#if V7_ENABLE_PROFILER
+
+/* Deeper call stacks get their outermost frames cut off */
+#define PROF_MAX_DEPTH 64
+
+static double prof_now(void) {
+#ifndef _WIN32
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (double) tv.tv_sec * 1000000 + tv.tv_usec;
+#else
+  return (double) clock() * 1000000 / CLOCKS_PER_SEC;
+#endif
+}
+
+/*
+ * Returns the filename of the bcode. Non-ROM filenames are retained by the
+ * profiler, so that they outlive the bcode.
+ */
+static const char *prof_filename(struct prof *p, struct bcode *bcode) {
+#if !V7_DISABLE_FILENAMES
+  const void *key = bcode->filename;
+  if (key == NULL) {
+    return "<no filename>";
+  }
+  if (key != p->last_file_key) {
+    if (!bcode->filename_in_rom) {
+      struct shdata **files = (struct shdata **) p->files.buf;
+      size_t i, n = p->files.len / sizeof(*files);
+      for (i = 0; i < n && files[i] != key; i++) {
+      }
+      if (i == n) {
+        shdata_retain((struct shdata *) key);
+        mbuf_append(&p->files, &key, sizeof(key));
+      }
+    }
+    p->last_file_key = key;
+    p->last_file = bcode_get_filename(bcode);
+  }
+  return p->last_file;
+#else
+  (void) p;
+  (void) bcode;
+  return "<no filename>";
+#endif
+}
+
+static struct prof_site *prof_site_get(struct prof *p, const char *filename,
+                                       int line_no, uint8_t op) {
+  size_t h = (((uintptr_t) filename >> 3) ^ (line_no * 31) ^ (op * 7919)) %
+             PROF_HASH_SIZE;
+  struct prof_site *s;
+
+  for (s = p->sites[h]; s != NULL; s = s->next) {
+    if (s->filename == filename && s->line_no == line_no && s->op == op) {
+      return s;
+    }
+  }
+
+  s = (struct prof_site *) calloc(1, sizeof(*s));
+  if (s != NULL) {
+    s->filename = filename;
+    s->line_no = line_no;
+    s->op = op;
+    s->next = p->sites[h];
+    p->sites[h] = s;
+  }
+  return s;
+}
+
+static void prof_append_frame(struct prof *p, struct bcode *bcode,
+                              int line_no) {
+  char lbuf[16];
+  const char *fn = prof_filename(p, bcode);
+
+  if (p->stack_buf.len > 0) {
+    mbuf_append(&p->stack_buf, ";", 1);
+  }
+  if (bcode->func_name_present) {
+    char *funcname;
+    bcode_next_name(bcode->ops.p, &funcname, NULL);
+    if (funcname[0] == '\0') {
+      funcname = (char *) "<anonymous>";
+    }
+    mbuf_append(&p->stack_buf, funcname, strlen(funcname));
+    mbuf_append(&p->stack_buf, " ", 1);
+  }
+  mbuf_append(&p->stack_buf, fn, strlen(fn));
+  snprintf(lbuf, sizeof(lbuf), ":%d", line_no);
+  mbuf_append(&p->stack_buf, lbuf, strlen(lbuf));
+}
+
+/*
+ * Adds a sample to the current call stack, which is labelled outermost first
+ * as `[function] file:line` for each JS frame, and `<cfunc>` for each C one.
+ */
+static void prof_stack_add(struct v7 *v7, struct prof *p,
+                           unsigned long count) {
+  struct v7_call_frame_base *frames[PROF_MAX_DEPTH];
+  int lines[PROF_MAX_DEPTH];
+  struct v7_call_frame_base *f;
+  struct prof_stack *s;
+  int n = 0, line_no = -1;
+  size_t h = 5381, i;
+
+  for (f = v7->call_stack; f != NULL && n < PROF_MAX_DEPTH; f = f->prev) {
+    if (f->type_mask & V7_CALL_FRAME_MASK_BCODE) {
+      /* Current line of the bcode is kept by the innermost `catch` frame */
+      lines[n] = line_no >= 0 ? line_no : (int) f->line_no;
+      frames[n++] = f;
+      line_no = -1;
+    } else if (f->type_mask & V7_CALL_FRAME_MASK_CFUNC) {
+      frames[n++] = f;
+    } else if (line_no < 0) {
+      line_no = f->line_no;
+    }
+  }
+
+  p->stack_buf.len = 0;
+  while (n-- > 0) {
+    f = frames[n];
+    if (f->type_mask & V7_CALL_FRAME_MASK_BCODE) {
+      prof_append_frame(p, ((struct v7_call_frame_bcode *) f)->bcode, lines[n]);
+    } else {
+      if (p->stack_buf.len > 0) {
+        mbuf_append(&p->stack_buf, ";", 1);
+      }
+      mbuf_append(&p->stack_buf, "<cfunc>", 7);
+    }
+  }
+
+  for (i = 0; i < p->stack_buf.len; i++) {
+    h = h * 33 + (unsigned char) p->stack_buf.buf[i];
+  }
+
+  for (s = p->stacks[h % PROF_HASH_SIZE]; s != NULL; s = s->next) {
+    if (s->hash == h && strlen(s->stack) == p->stack_buf.len &&
+        memcmp(s->stack, p->stack_buf.buf, p->stack_buf.len) == 0) {
+      break;
+    }
+  }
+
+  if (s == NULL) {
+    s = (struct prof_stack *) calloc(1, sizeof(*s) + p->stack_buf.len);
+    if (s == NULL) {
+      return;
+    }
+    memcpy(s->stack, p->stack_buf.buf, p->stack_buf.len);
+    s->hash = h;
+    s->next = p->stacks[h % PROF_HASH_SIZE];
+    p->stacks[h % PROF_HASH_SIZE] = s;
+  }
+  s->count += count;
+}
+
+V7_PRIVATE void prof_sample(struct v7 *v7, struct bcode *bcode, uint8_t op) {
+  struct prof *p = v7->prof;
+  struct prof_site *s;
+
+  p->countdown = p->period;
+  if (p->last_site != NULL) {
+    p->last_site->usec += prof_now() - p->last_time;
+  }
+
+  s = prof_site_get(p, prof_filename(p, bcode), v7->call_stack->line_no, op);
+  if (s != NULL) {
+    s->count += p->period;
+  }
+  prof_stack_add(v7, p, p->period);
+
+  /* Don't let the bookkeeping above be attributed to the profiled code */
+  p->last_site = s;
+  p->last_time = prof_now();
+}
+
+static void prof_reset(struct prof *p) {
+  size_t i;
+
+  for (i = 0; i < PROF_HASH_SIZE; i++) {
+    while (p->sites[i] != NULL) {
+      struct prof_site *next = p->sites[i]->next;
+      free(p->sites[i]);
+      p->sites[i] = next;
+    }
+    while (p->stacks[i] != NULL) {
+      struct prof_stack *next = p->stacks[i]->next;
+      free(p->stacks[i]);
+      p->stacks[i] = next;
+    }
+  }
+
+#if !V7_DISABLE_FILENAMES
+  for (i = 0; i < p->files.len / sizeof(struct shdata *); i++) {
+    shdata_release(((struct shdata **) p->files.buf)[i]);
+  }
+#endif
+  p->files.len = 0;
+  p->last_file_key = NULL;
+  p->last_file = NULL;
+  p->last_site = NULL;
+}
+
+V7_PRIVATE void prof_free(struct v7 *v7) {
+  struct prof *p = v7->prof;
+  if (p != NULL) {
+    prof_reset(p);
+    mbuf_free(&p->files);
+    mbuf_free(&p->stack_buf);
+    free(p);
+    v7->prof = NULL;
+  }
+}
+
+void v7_prof_start(struct v7 *v7, unsigned int period) {
+  struct prof *p = v7->prof;
+
+  if (p == NULL) {
+    p = (struct prof *) calloc(1, sizeof(*p));
+    if (p == NULL) {
+      return;
+    }
+    mbuf_init(&p->files, 0);
+    mbuf_init(&p->stack_buf, 0);
+    v7->prof = p;
+  } else {
+    prof_reset(p);
+  }
+
+  p->period = period > 0 ? period : 1;
+  p->countdown = p->period;
+  p->running = 1;
+}
+
+void v7_prof_stop(struct v7 *v7) {
+  struct prof *p = v7->prof;
+  if (p == NULL) return;
+
+  if (p->running && p->last_site != NULL) {
+    p->last_site->usec += prof_now() - p->last_time;
+  }
+  p->last_site = NULL;
+  p->running = 0;
+}
+
+static int prof_site_cmp(const void *a, const void *b) {
+  const struct prof_site *sa = *(const struct prof_site **) a;
+  const struct prof_site *sb = *(const struct prof_site **) b;
+  if (sa->count != sb->count) {
+    return sa->count < sb->count ? 1 : -1;
+  }
+  return sa->usec < sb->usec ? 1 : (sa->usec > sb->usec ? -1 : 0);
+}
+
+void v7_prof_dump(struct v7 *v7, FILE *fp) {
+  struct prof *p = v7->prof;
+  struct prof_site **sites, *s;
+  unsigned long total = 0;
+  double total_usec = 0;
+  size_t i, n = 0;
+
+  if (p == NULL) return;
+
+  for (i = 0; i < PROF_HASH_SIZE; i++) {
+    for (s = p->sites[i]; s != NULL; s = s->next) {
+      total += s->count;
+      total_usec += s->usec;
+      n++;
+    }
+  }
+
+  sites = (struct prof_site **) malloc(n * sizeof(*sites) + 1);
+  if (sites == NULL) return;
+  for (n = 0, i = 0; i < PROF_HASH_SIZE; i++) {
+    for (s = p->sites[i]; s != NULL; s = s->next) {
+      sites[n++] = s;
+    }
+  }
+  qsort(sites, n, sizeof(*sites), prof_site_cmp);
+
+  fprintf(fp, "%12s %7s %12s %7s  %s\n", "instrs", "%", "usec", "%",
+          "location");
+  for (i = 0; i < n; i++) {
+    s = sites[i];
+    fprintf(fp, "%12lu %6.2f%% %12.0f %6.2f%%  %s:%d %s\n", s->count,
+            total > 0 ? s->count * 100.0 / total : 0.0, s->usec,
+            total_usec > 0 ? s->usec * 100.0 / total_usec : 0.0, s->filename,
+            s->line_no, opcode_name(s->op));
+  }
+  fprintf(fp, "%12lu %7s %12.0f %7s  total\n", total, "", total_usec, "");
+
+  free(sites);
+}
+
+void v7_prof_dump_folded(struct v7 *v7, FILE *fp) {
+  struct prof *p = v7->prof;
+  struct prof_stack *s;
+  size_t i;
+
+  if (p == NULL) return;
+
+  for (i = 0; i < PROF_HASH_SIZE; i++) {
+    for (s = p->stacks[i]; s != NULL; s = s->next) {
+      fprintf(fp, "%s %lu\n", s->stack, s->count);
+    }
+  }
+}
+
+#endif /* V7_ENABLE_PROFILER */
+#ifdef V7_MODULE_LINES
 #line 1 "v7/src/std_object.c"
 #endif
 /*
@@ -30593,8 +35117,22 @@ static enum v7_err _Obj_ownKeys(struct v7 *v7, unsigned int ignore_flags,
     goto clean;
   }
 
-  _Obj_append_reverse(v7, get_object_struct(obj)->properties, *res, 0,
-                      ignore_flags);
+  {
+    int i = 0;
+#if V7_ENABLE_DENSE_ARRAYS
+    struct prop_iter_ctx ctx;
+    struct v7_property p;
+    memset(&p, 0, sizeof(p));
+    V7_TRY(init_prop_iter_ctx(v7, obj, 0, &ctx));
+    /* array elements go first, in ascending order */
+    while (next_dense_element(v7, &ctx, &p)) {
+      v7_array_set(v7, *res, i++, p.name);
+    }
+    v7_destruct_prop_iter_ctx(v7, &ctx);
+#endif
+    _Obj_append_reverse(v7, get_object_struct(obj)->properties, *res, i,
+                        ignore_flags);
+  }
 
 clean:
   return rcode;
@@ -31658,6 +36196,519 @@ extern enum v7_err v7_alt_json_parse(struct v7 *v7, v7_val_t json_string,
                                      v7_val_t *res);
 #endif
 
+/*
+ * JSON reader: builds values right from the input bytes, without going
+ * through the JS parser and compiler.
+ *
+ * It is a push parser driven by the `state` of the grammar, so that input
+ * may be fed in arbitrary chunks: a token which is not complete yet is
+ * accumulated in `tok`. Containers being populated are kept in `stack`, a JS
+ * array, so they are reachable by GC.
+ */
+
+enum json_state {
+  JSON_VALUE,        /* a value is expected */
+  JSON_VALUE_OR_END, /* a value or `]` (just after `[`) */
+  JSON_KEY,          /* a key is expected (after `,` in an object) */
+  JSON_KEY_OR_END,   /* a key or `}` (just after `{`) */
+  JSON_COLON,
+  JSON_COMMA_OR_END,
+  JSON_DONE,
+  JSON_ERROR
+};
+
+enum json_token {
+  JSON_TOK_NONE,
+  JSON_TOK_STRING,
+  JSON_TOK_NUMBER,
+  JSON_TOK_WORD /* true, false or null */
+};
+
+/* Number of the recently seen object keys which are reused */
+#define JSON_KEY_CACHE_SIZE 64
+
+struct v7_json_parser {
+  struct v7 *v7;
+  enum json_state state;
+  enum json_token token;
+  unsigned cur_is_array : 1;
+  unsigned tok_escaped : 1; /* last char of a string token is a backslash */
+  unsigned tok_has_escapes : 1;
+  struct mbuf tok;
+  unsigned long depth;
+
+  /* for error messages */
+  unsigned long pos;
+  unsigned long line;
+  unsigned long line_start;
+
+  /* GC roots */
+  val_t cur;    /* container being populated */
+  val_t key;    /* pending key, if `cur` is an object */
+  val_t stack;  /* `cur` and `key` of the outer containers */
+  val_t keys;   /* recently seen keys, see `json_mk_key()` */
+  val_t tmp;    /* value being added */
+  val_t result; /* top-level value */
+};
+
+static enum v7_err json_error(struct v7_json_parser *p, const char *msg) {
+  enum v7_err ignore = v7_throwf(p->v7, SYNTAX_ERROR,
+                                 "Invalid JSON at line %lu col %lu: %s",
+                                 p->line, p->pos - p->line_start + 1, msg);
+  (void) ignore;
+  p->state = JSON_ERROR;
+  return V7_SYNTAX_ERROR;
+}
+
+static int json_is_value_expected(struct v7_json_parser *p) {
+  return p->state == JSON_VALUE || p->state == JSON_VALUE_OR_END;
+}
+
+/*
+ * Object keys tend to repeat (think of an array of records), so the recently
+ * seen ones are reused instead of allocating a new string for each of them.
+ */
+static val_t json_mk_key(struct v7_json_parser *p, const char *s, size_t len) {
+  struct v7 *v7 = p->v7;
+  uint32_t h = str_hash(s, len) % JSON_KEY_CACHE_SIZE;
+  size_t key_len;
+  val_t key;
+  const char *key_str;
+
+  key = v7_array_get(v7, p->keys, h);
+  if (v7_is_string(key)) {
+    key_str = v7_get_string(v7, &key, &key_len);
+    if (key_len == len && memcmp(key_str, s, len) == 0) {
+      return key;
+    }
+  }
+
+  key = atom_intern(v7, atom_mk_string(v7, s, len));
+  v7_array_set(v7, p->keys, h, key);
+  return key;
+}
+
+static enum v7_err json_add_value(struct v7_json_parser *p, val_t v) {
+  enum v7_err rcode = V7_OK;
+  struct v7 *v7 = p->v7;
+
+  p->tmp = v;
+  if (p->depth == 0) {
+    p->result = v;
+    p->state = JSON_DONE;
+  } else if (p->cur_is_array) {
+    V7_TRY(v7_array_push_throwing(v7, p->cur, p->tmp, NULL));
+    p->state = JSON_COMMA_OR_END;
+  } else {
+    V7_TRY(set_property_v(v7, p->cur, p->key, p->tmp, NULL));
+    p->state = JSON_COMMA_OR_END;
+  }
+
+clean:
+  p->tmp = V7_UNDEFINED;
+  return rcode;
+}
+
+/* Adds a new object or array to the current container and descends into it */
+static enum v7_err json_open(struct v7_json_parser *p, int is_array) {
+  enum v7_err rcode = V7_OK;
+  struct v7 *v7 = p->v7;
+  val_t v = is_array ? v7_mk_dense_array(v7) : v7_mk_object(v7);
+
+  V7_TRY(json_add_value(p, v));
+  if (p->depth > 0) {
+    v7_array_set(v7, p->stack, 2 * (p->depth - 1), p->cur);
+    v7_array_set(v7, p->stack, 2 * (p->depth - 1) + 1, p->key);
+  }
+  p->depth++;
+  p->cur = v;
+  p->key = V7_UNDEFINED;
+  p->cur_is_array = is_array;
+  p->state = is_array ? JSON_VALUE_OR_END : JSON_KEY_OR_END;
+
+clean:
+  return rcode;
+}
+
+static void json_close(struct v7_json_parser *p) {
+  struct v7 *v7 = p->v7;
+
+  p->depth--;
+  if (p->depth == 0) {
+    p->cur = p->key = V7_UNDEFINED;
+    p->state = JSON_DONE;
+  } else {
+    p->cur = v7_array_get(v7, p->stack, 2 * (p->depth - 1));
+    p->key = v7_array_get(v7, p->stack, 2 * (p->depth - 1) + 1);
+    p->cur_is_array = v7_is_array(v7, p->cur);
+    p->state = JSON_COMMA_OR_END;
+  }
+}
+
+static int json_hex(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+/*
+ * Unescapes the string token `s` of length `*len` in place: the result is
+ * never longer than the source. Returns 0 if there is an invalid escape.
+ */
+static int json_unescape(char *s, size_t *len) {
+  const char *src = s, *end = s + *len;
+  char *dst = s;
+
+  while (src < end) {
+    if (*src != '\\') {
+      *dst++ = *src++;
+      continue;
+    }
+    if (++src == end) return 0;
+    switch (*src++) {
+      case '"':
+        *dst++ = '"';
+        break;
+      case '\\':
+        *dst++ = '\\';
+        break;
+      case '/':
+        *dst++ = '/';
+        break;
+      case 'b':
+        *dst++ = '\b';
+        break;
+      case 'f':
+        *dst++ = '\f';
+        break;
+      case 'n':
+        *dst++ = '\n';
+        break;
+      case 'r':
+        *dst++ = '\r';
+        break;
+      case 't':
+        *dst++ = '\t';
+        break;
+      case 'u': {
+        Rune r = 0;
+        int i, d;
+        for (i = 0; i < 4; i++) {
+          if (src == end || (d = json_hex(*src++)) < 0) return 0;
+          r = (r << 4) | d;
+        }
+        dst += runetochar(dst, &r);
+        break;
+      }
+      default:
+        return 0;
+    }
+  }
+
+  *len = dst - s;
+  return 1;
+}
+
+/* Checks `-?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?` */
+static int json_is_number(const char *s, const char *end) {
+  const char *start;
+  if (s < end && *s == '-') s++;
+  if (s < end && *s == '0') {
+    s++;
+  } else {
+    for (start = s; s < end && isdigit((unsigned char) *s); s++) {
+    }
+    if (s == start) return 0;
+  }
+  if (s < end && *s == '.') {
+    for (start = ++s; s < end && isdigit((unsigned char) *s); s++) {
+    }
+    if (s == start) return 0;
+  }
+  if (s < end && (*s == 'e' || *s == 'E')) {
+    s++;
+    if (s < end && (*s == '+' || *s == '-')) s++;
+    for (start = s; s < end && isdigit((unsigned char) *s); s++) {
+    }
+    if (s == start) return 0;
+  }
+  return s == end;
+}
+
+/* Turns the complete token accumulated in `tok` into a value or a key */
+static enum v7_err json_end_token(struct v7_json_parser *p) {
+  enum v7_err rcode = V7_OK;
+  struct v7 *v7 = p->v7;
+  struct mbuf *tok = &p->tok;
+  enum json_token token = p->token;
+  val_t v = V7_UNDEFINED;
+
+  p->token = JSON_TOK_NONE;
+
+  switch (token) {
+    case JSON_TOK_STRING: {
+      const char *s = tok->buf != NULL ? tok->buf : "";
+      size_t len = tok->len;
+      if (p->tok_has_escapes && !json_unescape(tok->buf, &len)) {
+        V7_THROW(json_error(p, "bad escape sequence"));
+      }
+      if (p->state == JSON_KEY || p->state == JSON_KEY_OR_END) {
+        p->key = json_mk_key(p, s, len);
+        p->state = JSON_COLON;
+        goto clean;
+      }
+      v = v7_mk_string(v7, s, len, 1);
+      break;
+    }
+    case JSON_TOK_NUMBER:
+      if (!json_is_number(tok->buf, tok->buf + tok->len)) {
+        V7_THROW(json_error(p, "bad number"));
+      }
+      mbuf_append(tok, "", 1);
+      v = v7_mk_number(v7, cs_strtod(tok->buf, NULL));
+      break;
+    case JSON_TOK_WORD:
+      if (tok->len == 4 && memcmp(tok->buf, "true", 4) == 0) {
+        v = v7_mk_boolean(v7, 1);
+      } else if (tok->len == 5 && memcmp(tok->buf, "false", 5) == 0) {
+        v = v7_mk_boolean(v7, 0);
+      } else if (tok->len == 4 && memcmp(tok->buf, "null", 4) == 0) {
+        v = V7_NULL;
+      } else {
+        V7_THROW(json_error(p, "unexpected word"));
+      }
+      break;
+    case JSON_TOK_NONE:
+      goto clean;
+  }
+
+  V7_TRY(json_add_value(p, v));
+
+clean:
+  tok->len = 0;
+  return rcode;
+}
+
+static int json_is_word_char(char c) {
+  return c >= 'a' && c <= 'z';
+}
+
+static int json_is_number_char(char c) {
+  return isdigit((unsigned char) c) || c == '-' || c == '+' || c == '.' ||
+         c == 'e' || c == 'E';
+}
+
+static enum v7_err json_feed(struct v7_json_parser *p, const char *buf,
+                             size_t len) {
+  enum v7_err rcode = V7_OK;
+  struct v7 *v7 = p->v7;
+  const char *s = buf, *end = buf + len, *run;
+
+  if (p->state == JSON_ERROR) {
+    return V7_SYNTAX_ERROR;
+  }
+
+  while (s < end) {
+    /* continue the current token, if any */
+    switch (p->token) {
+      case JSON_TOK_STRING:
+        for (run = s; s < end; s++) {
+          if (p->tok_escaped) {
+            p->tok_escaped = 0;
+          } else if (*s == '\\') {
+            p->tok_escaped = p->tok_has_escapes = 1;
+          } else if (*s == '"') {
+            break;
+          } else if ((unsigned char) *s < 0x20) {
+            p->pos += s - run;
+            V7_THROW(json_error(p, "control character in string"));
+          }
+        }
+        if (s > run) {
+          mbuf_append(&p->tok, run, s - run);
+        }
+        p->pos += s - run;
+        if (s == end) goto clean;
+        /* skip closing quote */
+        s++;
+        p->pos++;
+        V7_TRY(json_end_token(p));
+        continue;
+      case JSON_TOK_NUMBER:
+      case JSON_TOK_WORD:
+        for (run = s; s < end && (p->token == JSON_TOK_NUMBER
+                                      ? json_is_number_char(*s)
+                                      : json_is_word_char(*s));
+             s++) {
+        }
+        if (s > run) {
+          mbuf_append(&p->tok, run, s - run);
+        }
+        p->pos += s - run;
+        if (s == end) goto clean;
+        V7_TRY(json_end_token(p));
+        continue;
+      case JSON_TOK_NONE:
+        break;
+    }
+
+    switch (*s) {
+      case '\n':
+        p->line++;
+        p->line_start = p->pos + 1;
+      /* fallthrough */
+      case ' ':
+      case '\t':
+      case '\r':
+        break;
+      case '"':
+        if (!json_is_value_expected(p) && p->state != JSON_KEY &&
+            p->state != JSON_KEY_OR_END) {
+          V7_THROW(json_error(p, "unexpected string"));
+        }
+        p->token = JSON_TOK_STRING;
+        p->tok_escaped = p->tok_has_escapes = 0;
+        break;
+      case '{':
+      case '[':
+        if (!json_is_value_expected(p)) {
+          V7_THROW(json_error(p, "unexpected bracket"));
+        }
+        V7_TRY(json_open(p, *s == '['));
+        break;
+      case '}':
+      case ']':
+        if (p->depth == 0 || p->cur_is_array != (*s == ']') ||
+            (p->state != JSON_COMMA_OR_END &&
+             p->state != (p->cur_is_array ? JSON_VALUE_OR_END
+                                          : JSON_KEY_OR_END))) {
+          V7_THROW(json_error(p, "unexpected bracket"));
+        }
+        json_close(p);
+        break;
+      case ':':
+        if (p->state != JSON_COLON) {
+          V7_THROW(json_error(p, "unexpected colon"));
+        }
+        p->state = JSON_VALUE;
+        break;
+      case ',':
+        if (p->state != JSON_COMMA_OR_END) {
+          V7_THROW(json_error(p, "unexpected comma"));
+        }
+        p->state = p->cur_is_array ? JSON_VALUE : JSON_KEY;
+        break;
+      default:
+        if (!json_is_value_expected(p)) {
+          V7_THROW(json_error(p, "unexpected character"));
+        } else if (*s == '-' || isdigit((unsigned char) *s)) {
+          p->token = JSON_TOK_NUMBER;
+          /* the char will be added to the token in the next iteration */
+          continue;
+        } else if (json_is_word_char(*s)) {
+          p->token = JSON_TOK_WORD;
+          continue;
+        } else {
+          V7_THROW(json_error(p, "unexpected character"));
+        }
+    }
+    s++;
+    p->pos++;
+  }
+
+clean:
+  if (rcode != V7_OK) {
+    p->state = JSON_ERROR;
+  }
+  return rcode;
+}
+
+struct v7_json_parser *v7_json_parser_create(struct v7 *v7) {
+  struct v7_json_parser *p =
+      (struct v7_json_parser *) calloc(1, sizeof(*p));
+  if (p == NULL) return NULL;
+
+  p->v7 = v7;
+  p->state = JSON_VALUE;
+  p->token = JSON_TOK_NONE;
+  p->line = 1;
+  mbuf_init(&p->tok, 0);
+
+  p->cur = p->key = p->tmp = p->result = V7_UNDEFINED;
+  v7_own(v7, &p->cur);
+  v7_own(v7, &p->key);
+  v7_own(v7, &p->tmp);
+  v7_own(v7, &p->result);
+  p->stack = v7_mk_dense_array(v7);
+  v7_own(v7, &p->stack);
+  p->keys = v7_mk_dense_array(v7);
+  v7_own(v7, &p->keys);
+
+  return p;
+}
+
+enum v7_err v7_json_parser_feed(struct v7_json_parser *p, const char *buf,
+                                size_t len) {
+  return json_feed(p, buf, len);
+}
+
+enum v7_err v7_json_parser_end(struct v7_json_parser *p, v7_val_t *res) {
+  enum v7_err rcode = V7_OK;
+  struct v7 *v7 = p->v7;
+
+  *res = V7_UNDEFINED;
+  if (p->state == JSON_ERROR) {
+    return V7_SYNTAX_ERROR;
+  }
+
+  /* a number or a word at the very end is complete now */
+  if (p->token != JSON_TOK_STRING) {
+    V7_TRY(json_end_token(p));
+  }
+  if (p->state != JSON_DONE) {
+    V7_THROW(json_error(p, "unexpected end of input"));
+  }
+
+  *res = p->result;
+
+clean:
+  return rcode;
+}
+
+void v7_json_parser_destroy(struct v7_json_parser *p) {
+  struct v7 *v7;
+  if (p == NULL) return;
+
+  v7 = p->v7;
+  v7_disown(v7, &p->keys);
+  v7_disown(v7, &p->stack);
+  v7_disown(v7, &p->result);
+  v7_disown(v7, &p->tmp);
+  v7_disown(v7, &p->key);
+  v7_disown(v7, &p->cur);
+  mbuf_free(&p->tok);
+  free(p);
+}
+
+V7_PRIVATE enum v7_err json_parse(struct v7 *v7, const char *buf, size_t len,
+                                  val_t *res) {
+  enum v7_err rcode = V7_OK;
+  struct v7_json_parser *p = v7_json_parser_create(v7);
+
+  if (p == NULL) {
+    rcode = v7_throwf(v7, INTERNAL_ERROR, "out of memory");
+    goto clean;
+  }
+
+  V7_TRY(v7_json_parser_feed(p, buf, len));
+  V7_TRY(v7_json_parser_end(p, res));
+
+clean:
+  v7_json_parser_destroy(p);
+  return rcode;
+}
+
 WARN_UNUSED_RESULT
 V7_PRIVATE enum v7_err Json_stringify(struct v7 *v7, v7_val_t *res) {
   val_t arg0 = v7_arg(v7, 0);
@@ -31675,7 +36726,26 @@ V7_PRIVATE enum v7_err Json_parse(struct v7 *v7, v7_val_t *res) {
 #if defined(V7_ALT_JSON_PARSE)
   rcode = v7_alt_json_parse(v7, arg, res);
 #else
-  rcode = std_eval(v7, arg, V7_UNDEFINED, 1, res);
+  char buf[100], *p = buf;
+  size_t len;
+
+  /* text is copied, since the string may be relocated by GC while parsing */
+  V7_TRY(to_string(v7, arg, NULL, buf, sizeof(buf), &len));
+  if (len >= sizeof(buf)) {
+    p = (char *) malloc(len + 1);
+    if (p == NULL) {
+      rcode = v7_throwf(v7, INTERNAL_ERROR, "out of memory");
+      V7_THROW(V7_INTERNAL_ERROR);
+    }
+    V7_TRY(to_string(v7, arg, NULL, p, len + 1, NULL));
+  }
+
+  V7_TRY(json_parse(v7, p, len, res));
+
+clean:
+  if (p != buf) {
+    free(p);
+  }
 #endif
   return rcode;
 }
@@ -31709,28 +36779,77 @@ V7_PRIVATE void init_json(struct v7 *v7) {
 /* Amalgamated: #include "v7/src/array.h" */
 /* Amalgamated: #include "v7/src/object.h" */
 /* Amalgamated: #include "v7/src/exceptions.h" */
+/* Amalgamated: #include "v7/src/bcode.h" */
 
 #if defined(__cplusplus)
 extern "C" {
 #endif /* __cplusplus */
 
-struct a_sort_data {
-  val_t sort_func;
-};
+/*
+ * Sets the length of the array `arr`, removing elements beyond `new_len`.
+ */
+WARN_UNUSED_RESULT
+static enum v7_err a_set_length(struct v7 *v7, val_t arr,
+                                unsigned long new_len) {
+  struct v7_object *o = get_object_struct(arr);
+  struct v7_property **p, **next;
+  long index, max_index = -1;
+
+#if V7_ENABLE_DENSE_ARRAYS
+  if (o->attributes & V7_OBJ_DENSE_ARRAY) {
+    unsigned long len = v7_array_length(v7, arr);
+    if (new_len <= len || dense_array_can_grow(len, new_len)) {
+      dense_array_set_length(v7, arr, new_len);
+      return V7_OK;
+    }
+    dense_array_to_sparse(v7, arr);
+  }
+#endif
+
+  /* Remove all items with an index higher than new_len */
+  for (p = obj_prop_list(o); *p != NULL; p = next) {
+    size_t n;
+    const char *s = v7_get_string(v7, &p[0]->name, &n);
+    next = &p[0]->next;
+    index = strtol(s, NULL, 10);
+    if (index >= (long) new_len) {
+      bcode_ic_invalidate(v7);
+      obj_prop_index_del(v7, o, *p);
+      v7_destroy_property(p);
+      *p = *next;
+      next = p;
+    } else if (index > max_index) {
+      max_index = index;
+    }
+  }
+
+  /* If we have to expand, insert an item with appropriate index */
+  if (new_len > 0 && max_index < (long) new_len - 1) {
+    char buf[40];
+    c_snprintf(buf, sizeof(buf), "%lu", new_len - 1);
+    return set_property(v7, arr, buf, strlen(buf), V7_UNDEFINED, NULL);
+  }
+  return V7_OK;
+}
 
 WARN_UNUSED_RESULT
 V7_PRIVATE enum v7_err Array_ctor(struct v7 *v7, v7_val_t *res) {
   enum v7_err rcode = V7_OK;
   unsigned long i, len;
 
-  (void) v7;
   *res = v7_mk_array(v7);
-  /*
-   * The interpreter passes dense array to C functions.
-   * However dense array implementation is not yet complete
-   * so we don't want to propagate them at each call to Array()
-   */
   len = v7_argc(v7);
+
+  if (len == 1 && v7_is_number(v7_arg(v7, 0))) {
+    /* `new Array(len)` creates an array of `len` holes */
+    if (!num_to_array_index(v7_get_double(v7, v7_arg(v7, 0)), &len)) {
+      rcode = v7_throwf(v7, RANGE_ERROR, "Invalid array length");
+      goto clean;
+    }
+    rcode = a_set_length(v7, *res, len);
+    goto clean;
+  }
+
   for (i = 0; i < len; i++) {
     rcode = v7_array_set_throwing(v7, *res, i, v7_arg(v7, i), NULL);
     if (rcode != V7_OK) {
@@ -31802,30 +36921,7 @@ V7_PRIVATE enum v7_err Array_set_length(struct v7 *v7, v7_val_t *res) {
     rcode = v7_throwf(v7, RANGE_ERROR, "Invalid array length");
     goto clean;
   } else {
-    struct v7_property **p, **next;
-    long index, max_index = -1;
-
-    /* Remove all items with an index higher than new_len */
-    for (p = &get_object_struct(this_obj)->properties; *p != NULL; p = next) {
-      size_t n;
-      const char *s = v7_get_string(v7, &p[0]->name, &n);
-      next = &p[0]->next;
-      index = strtol(s, NULL, 10);
-      if (index >= new_len) {
-        v7_destroy_property(p);
-        *p = *next;
-        next = p;
-      } else if (index > max_index) {
-        max_index = index;
-      }
-    }
-
-    /* If we have to expand, insert an item with appropriate index */
-    if (new_len > 0 && max_index < new_len - 1) {
-      char buf[40];
-      c_snprintf(buf, sizeof(buf), "%ld", new_len - 1);
-      v7_set(v7, this_obj, buf, strlen(buf), V7_UNDEFINED);
-    }
+    V7_TRY(a_set_length(v7, this_obj, new_len));
   }
 
   *res = v7_mk_number(v7, new_len);
@@ -31834,180 +36930,258 @@ clean:
   return rcode;
 }
 
-WARN_UNUSED_RESULT
-static enum v7_err a_cmp(struct v7 *v7, void *user_data, const void *pa,
-                         const void *pb, int *res) {
-  enum v7_err rcode = V7_OK;
-  struct a_sort_data *sort_data = (struct a_sort_data *) user_data;
-  val_t a = *(val_t *) pa, b = *(val_t *) pb, func = sort_data->sort_func;
+/*
+ * Element of an array being sorted: the value, and, when sorting without a
+ * comparator function, its string form.
+ */
+struct a_sort_item {
+  val_t v;
+  val_t key;
+};
 
-  if (v7_is_callable(v7, func)) {
-    int saved_inhibit_gc = v7->inhibit_gc;
-    val_t vres = V7_UNDEFINED, args = v7_mk_dense_array(v7);
-    v7_array_push(v7, args, a);
-    v7_array_push(v7, args, b);
-    v7->inhibit_gc = 0;
-    rcode = b_apply(v7, func, V7_UNDEFINED, args, 0, &vres);
-    if (rcode != V7_OK) {
-      goto clean;
-    }
-    v7->inhibit_gc = saved_inhibit_gc;
-    *res = (int) -v7_get_double(v7, vres);
-    goto clean;
-  } else {
-    char sa[100], sb[100];
+struct a_sort_ctx {
+  val_t func; /* comparator function, or undefined */
+  val_t args; /* arguments array reused by all comparator calls */
+  int num_sign; /* non-zero if `func` is `(a, b) => a - b` or `b - a` */
+};
 
-    rcode = to_string(v7, a, NULL, sa, sizeof(sa), NULL);
-    if (rcode != V7_OK) {
-      goto clean;
-    }
+/*
+ * Returns 1 if `func` is `function(a, b) { return a - b; }`, -1 if it's
+ * `function(a, b) { return b - a; }`, and 0 otherwise. Names of the arguments
+ * don't matter. For numbers, such comparators can be applied without calls.
+ */
+static int a_numeric_cmp_sign(val_t func) {
+  struct bcode *bcode;
+  const uint8_t *p, *end;
 
-    rcode = to_string(v7, b, NULL, sb, sizeof(sb), NULL);
-    if (rcode != V7_OK) {
-      goto clean;
-    }
+  if (!is_js_function(func)) return 0;
+  bcode = get_js_function_struct(func)->bcode;
+  if (!bcode->uses_slots || bcode->args_cnt != 2) return 0;
 
-    sa[sizeof(sa) - 1] = sb[sizeof(sb) - 1] = '\0';
-    *res = strcmp(sb, sa);
-    goto clean;
-  }
+  p = (const uint8_t *) bcode_end_names(bcode->ops.p, bcode->names_cnt);
+  end = (const uint8_t *) bcode->ops.p + bcode->ops.len;
 
-clean:
-  return rcode;
+  /* arguments are kept in slots 1 and 2, see `OP_GET_LOCAL` */
+  if (end - p < 7 || p[0] != OP_PUSH_UNDEFINED || p[1] != OP_GET_LOCAL ||
+      p[3] != OP_GET_LOCAL || p[5] != OP_SUB || p[6] != OP_RET) {
+    return 0;
+  }
+  if (p[2] == 1 && p[4] == 2) return 1;
+  if (p[2] == 2 && p[4] == 1) return -1;
+  return 0;
 }
 
+/*
+ * Compares two elements, `*res` is negative, zero or positive if `a` should
+ * go before `b`, the order doesn't matter, or `a` should go after `b`.
+ */
 WARN_UNUSED_RESULT
-static enum v7_err a_partition(struct v7 *v7, val_t *a, int l, int r,
-                               void *user_data, int *res) {
+static enum v7_err a_cmp(struct v7 *v7, struct a_sort_ctx *ctx,
+                         const struct a_sort_item *a,
+                         const struct a_sort_item *b, int *res) {
   enum v7_err rcode = V7_OK;
-  val_t t, pivot = a[l];
-  int i = l, j = r + 1;
-
-  for (;;) {
-    while (1) {
-      ++i;
-
-      if (i <= r) {
-        int tmp = 0;
-        rcode = a_cmp(v7, user_data, &a[i], &pivot, &tmp);
-        if (rcode != V7_OK) {
-          goto clean;
-        }
+  val_t vres = V7_UNDEFINED;
+  double d;
 
-        if (tmp > 0) {
-          break;
-        }
-      } else {
-        break;
-      }
+  if (!v7_is_callable(v7, ctx->func)) {
+    size_t a_len, b_len;
+    const char *a_ptr = v7_get_string(v7, (val_t *) &a->key, &a_len);
+    const char *b_ptr = v7_get_string(v7, (val_t *) &b->key, &b_len);
+    *res = memcmp(a_ptr, b_ptr, a_len < b_len ? a_len : b_len);
+    if (*res == 0) {
+      *res = a_len < b_len ? -1 : a_len > b_len;
     }
-    while (1) {
-      int tmp = 0;
-      --j;
-
-      rcode = a_cmp(v7, user_data, &a[j], &pivot, &tmp);
-      if (rcode != V7_OK) {
-        goto clean;
-      }
+    goto clean;
+  }
 
-      if (tmp <= 0) {
-        break;
-      }
+  if (ctx->num_sign != 0 && v7_is_number(a->v) && v7_is_number(b->v)) {
+    d = v7_get_double(v7, a->v) - v7_get_double(v7, b->v);
+    d *= ctx->num_sign;
+  } else {
+    int saved_inhibit_gc = v7->inhibit_gc;
+    v7_array_set(v7, ctx->args, 0, a->v);
+    v7_array_set(v7, ctx->args, 1, b->v);
+    v7->inhibit_gc = 0;
+    rcode = b_apply(v7, ctx->func, V7_UNDEFINED, ctx->args, 0, &vres);
+    v7->inhibit_gc = saved_inhibit_gc;
+    if (rcode != V7_OK) {
+      goto clean;
     }
-    if (i >= j) break;
-    t = a[i];
-    a[i] = a[j];
-    a[j] = t;
+    V7_TRY(to_number_v(v7, vres, &vres));
+    d = v7_get_double(v7, vres);
   }
-  t = a[l];
-  a[l] = a[j];
-  a[j] = t;
+  /* NaN means that the order doesn't matter */
+  *res = d < 0 ? -1 : d > 0 ? 1 : 0;
 
-  *res = j;
 clean:
   return rcode;
 }
 
+/*
+ * Stable merge sort of `items[lo, hi)`, with `aux` as a scratch space of the
+ * same size as `items`. Short runs are sorted by insertion.
+ */
 WARN_UNUSED_RESULT
-static enum v7_err a_qsort(struct v7 *v7, val_t *a, int l, int r,
-                           void *user_data) {
+static enum v7_err a_merge_sort(struct v7 *v7, struct a_sort_ctx *ctx,
+                                struct a_sort_item *items,
+                                struct a_sort_item *aux, size_t lo,
+                                size_t hi) {
   enum v7_err rcode = V7_OK;
-  if (l < r) {
-    int j = 0;
-    rcode = a_partition(v7, a, l, r, user_data, &j);
-    if (rcode != V7_OK) {
-      goto clean;
+  size_t i, j, k, mid;
+  int cmp = 0;
+
+  if (hi - lo <= 8) {
+    for (i = lo + 1; i < hi; i++) {
+      struct a_sort_item tmp = items[i];
+      for (j = i; j > lo; j--) {
+        V7_TRY(a_cmp(v7, ctx, &items[j - 1], &tmp, &cmp));
+        if (cmp <= 0) break;
+        items[j] = items[j - 1];
+      }
+      items[j] = tmp;
     }
+    goto clean;
+  }
 
-    rcode = a_qsort(v7, a, l, j - 1, user_data);
-    if (rcode != V7_OK) {
-      goto clean;
-    }
+  mid = lo + (hi - lo) / 2;
+  V7_TRY(a_merge_sort(v7, ctx, items, aux, lo, mid));
+  V7_TRY(a_merge_sort(v7, ctx, items, aux, mid, hi));
 
-    rcode = a_qsort(v7, a, j + 1, r, user_data);
-    if (rcode != V7_OK) {
-      goto clean;
-    }
+  /* already in order: nothing to merge */
+  V7_TRY(a_cmp(v7, ctx, &items[mid - 1], &items[mid], &cmp));
+  if (cmp <= 0) {
+    goto clean;
   }
+
+  memcpy(aux + lo, items + lo, (hi - lo) * sizeof(*items));
+  for (i = lo, j = mid, k = lo; i < mid && j < hi; k++) {
+    V7_TRY(a_cmp(v7, ctx, &aux[j], &aux[i], &cmp));
+    items[k] = cmp < 0 ? aux[j++] : aux[i++];
+  }
+  /* the rest of the right half is already in place */
+  memcpy(items + k, aux + i, (mid - i) * sizeof(*items));
+
 clean:
   return rcode;
 }
 
 WARN_UNUSED_RESULT
-static enum v7_err a_sort(struct v7 *v7,
-                          enum v7_err (*sorting_func)(struct v7 *v7, void *,
-                                                      const void *,
-                                                      const void *, int *res),
-                          v7_val_t *res) {
+V7_PRIVATE enum v7_err Array_sort(struct v7 *v7, v7_val_t *res) {
   enum v7_err rcode = V7_OK;
-  int i = 0, len = 0;
-  val_t *arr = NULL;
-  val_t arg0 = v7_arg(v7, 0);
+  struct gc_tmp_frame tf = new_tmp_frame(v7);
+  struct a_sort_item *items = NULL, *aux = NULL;
+  struct a_sort_ctx ctx;
+  unsigned long len, i, n = 0, num_undefined = 0;
+  char buf[20];
+  int has;
 
   *res = v7_get_this(v7);
-  len = v7_array_length(v7, *res);
-
   if (!v7_is_object(*res)) {
     goto clean;
   }
 
-  arr = (val_t *) malloc(len * sizeof(arr[0]));
+  ctx.func = v7_arg(v7, 0);
+  ctx.args = V7_UNDEFINED;
+  ctx.num_sign = 0;
+  tmp_stack_push(&tf, &ctx.func);
+  tmp_stack_push(&tf, &ctx.args);
 
-  assert(*res != v7->vals.global_object);
+  if (!v7_is_undefined(ctx.func) && !v7_is_callable(v7, ctx.func)) {
+    rcode = v7_throwf(v7, TYPE_ERROR, "Comparator should be a function");
+    goto clean;
+  }
+
+  len = v7_array_length(v7, *res);
+  items = (struct a_sort_item *) malloc((len + 1) * sizeof(*items));
+  aux = (struct a_sort_item *) malloc((len + 1) * sizeof(*aux));
+  if (items == NULL || aux == NULL) {
+    rcode = v7_throwf(v7, RANGE_ERROR, "Array is too large to sort");
+    goto clean;
+  }
 
+  /* holes and undefined values go last, without comparing them */
   for (i = 0; i < len; i++) {
-    arr[i] = v7_array_get(v7, *res, i);
+    val_t v = v7_array_get2(v7, *res, i, &has);
+    if (!has) continue;
+    if (v7_is_undefined(v)) {
+      num_undefined++;
+    } else {
+      items[n].v = aux[n].v = v;
+      items[n].key = aux[n].key = V7_UNDEFINED;
+      n++;
+    }
   }
 
-  /* TODO(dfrank): sorting_func isn't actually used! something is wrong here */
-  if (sorting_func != NULL) {
-    struct a_sort_data sort_data;
-    sort_data.sort_func = arg0;
-    rcode = a_qsort(v7, arr, 0, len - 1, &sort_data);
-    if (rcode != V7_OK) {
-      goto clean;
+  if (v7_is_callable(v7, ctx.func)) {
+    ctx.args = v7_mk_dense_array(v7);
+    ctx.num_sign = a_numeric_cmp_sign(ctx.func);
+    /* GC can be invoked from the comparator: values have to be reachable */
+    for (i = 0; i < n; i++) {
+      tmp_stack_push(&tf, &items[i].v);
+      tmp_stack_push(&tf, &aux[i].v);
     }
+  } else {
+    /* GC is inhibited in cfunctions, so string keys stay in place */
+    for (i = 0; i < n; i++) {
+      V7_TRY(to_string(v7, items[i].v, &items[i].key, NULL, 0, NULL));
+    }
+  }
+
+  if (n > 1) {
+    V7_TRY(a_merge_sort(v7, &ctx, items, aux, 0, n));
   }
 
   for (i = 0; i < len; i++) {
-    v7_array_set(v7, *res, i, arr[len - (i + 1)]);
+    if (i < n + num_undefined) {
+      V7_TRY(v7_array_set_throwing(v7, *res, i,
+                                   i < n ? items[i].v : V7_UNDEFINED, NULL));
+    } else {
+      int l = c_snprintf(buf, sizeof(buf), "%lu", i);
+      v7_del(v7, *res, buf, l);
+    }
   }
 
 clean:
-  if (arr != NULL) {
-    free(arr);
-  }
+  tmp_frame_cleanup(&tf);
+  free(items);
+  free(aux);
   return rcode;
 }
 
-WARN_UNUSED_RESULT
-V7_PRIVATE enum v7_err Array_sort(struct v7 *v7, v7_val_t *res) {
-  return a_sort(v7, a_cmp, res);
-}
-
 WARN_UNUSED_RESULT
 V7_PRIVATE enum v7_err Array_reverse(struct v7 *v7, v7_val_t *res) {
-  return a_sort(v7, NULL, res);
+  enum v7_err rcode = V7_OK;
+  unsigned long lo, hi;
+  char buf[20];
+  int i, n;
+
+  *res = v7_get_this(v7);
+  if (!v7_is_object(*res) || (hi = v7_array_length(v7, *res)) == 0) {
+    goto clean;
+  }
+
+  for (lo = 0, hi--; lo < hi; lo++, hi--) {
+    int has[2];
+    val_t v[2];
+    unsigned long idx[2];
+    idx[0] = lo;
+    idx[1] = hi;
+    v[0] = v7_array_get2(v7, *res, hi, &has[0]);
+    v[1] = v7_array_get2(v7, *res, lo, &has[1]);
+
+    /* elements are swapped, and so are holes */
+    for (i = 0; i < 2; i++) {
+      if (has[i]) {
+        V7_TRY(v7_array_set_throwing(v7, *res, idx[i], v[i], NULL));
+      } else {
+        n = c_snprintf(buf, sizeof(buf), "%lu", idx[i]);
+        v7_del(v7, *res, buf, n);
+      }
+    }
+  }
+
+clean:
+  return rcode;
 }
 
 WARN_UNUSED_RESULT
@@ -32129,38 +37303,49 @@ static enum v7_err a_splice(struct v7 *v7, int mutate, v7_val_t *res) {
     }
   }
 
+#if V7_ENABLE_DENSE_ARRAYS
   if (mutate && get_object_struct(this_obj)->attributes & V7_OBJ_DENSE_ARRAY) {
     /*
      * dense arrays are spliced by memmoving leaving the trailing
      * space allocated for future appends.
-     * TODO(mkm): figure out if trimming is better
      */
-    struct v7_property *p =
-        v7_get_own_property2(v7, this_obj, "", 0, _V7_PROPERTY_HIDDEN);
+    long new_len;
     struct mbuf *abuf;
-    if (p == NULL) {
-      goto clean;
+
+    if (arg1 > len) arg1 = len;
+    new_len = len - (arg1 - arg0) + elems_to_insert;
+    if (new_len > len) {
+      dense_array_set_length(v7, this_obj, new_len);
+    }
+    if ((abuf = dense_array_buf(v7, this_obj)) != NULL) {
+      val_t *elems = (val_t *) abuf->buf;
+      memmove(elems + arg0 + elems_to_insert, elems + arg1,
+              (len - arg1) * sizeof(val_t));
+      for (i = 0; i < elems_to_insert; i++) {
+        elems[arg0 + i] = v7_arg(v7, i + 2);
+        dense_array_note_store(this_obj, elems[arg0 + i]);
+      }
     }
-    abuf = (struct mbuf *) v7_get_ptr(v7, p->value);
-    if (abuf == NULL) {
-      goto clean;
+    if (new_len < len) {
+      dense_array_set_length(v7, this_obj, new_len);
     }
-
-    memmove(abuf->buf + arg0 * sizeof(val_t), abuf->buf + arg1 * sizeof(val_t),
-            (len - arg1) * sizeof(val_t));
-    abuf->len -= (arg1 - arg0) * sizeof(val_t);
-  } else if (mutate) {
+  } else
+#endif
+      if (mutate) {
     /* If splicing, modify this_obj array: remove spliced sub-array */
+    struct v7_object *o = get_object_struct(this_obj);
     struct v7_property **p, **next;
     long i;
 
-    for (p = &get_object_struct(this_obj)->properties; *p != NULL; p = next) {
+    for (p = obj_prop_list(o); *p != NULL; p = next) {
       size_t n;
       const char *s = v7_get_string(v7, &p[0]->name, &n);
       next = &p[0]->next;
       i = strtol(s, NULL, 10);
       if (i >= arg0 && i < arg1) {
         /* Remove items from spliced sub-array */
+        bcode_ic_invalidate(v7);
+        obj_prop_index_del(v7, o, *p);
         v7_destroy_property(p);
         *p = *next;
         next = p;
@@ -32169,7 +37354,10 @@ static enum v7_err a_splice(struct v7 *v7, int mutate, v7_val_t *res) {
         char key[20];
         size_t n = c_snprintf(key, sizeof(key), "%ld",
                               i - (arg1 - arg0) + elems_to_insert);
-        p[0]->name = v7_mk_string(v7, key, n, 1);
+        bcode_ic_invalidate(v7);
+        obj_prop_index_del(v7, o, *p);
+        p[0]->name = atom_intern(v7, v7_mk_string(v7, key, n, 1));
+        obj_prop_index_add(v7, o, *p);
       }
     }
 
@@ -32212,31 +37400,26 @@ static void a_prep1(struct v7 *v7, val_t t, val_t *a0, val_t *a1) {
  *
  *   cb(v, n, this_obj);
  *
+ * The arguments array `*args` is created by the first call and reused by the
+ * subsequent ones: the caller should initialize it to `undefined` and keep
+ * it on the tmp stack.
  */
 WARN_UNUSED_RESULT
 static enum v7_err a_prep2(struct v7 *v7, val_t cb, val_t v, val_t n,
-                           val_t this_obj, val_t *res) {
+                           val_t this_obj, val_t *args, val_t *res) {
   enum v7_err rcode = V7_OK;
   int saved_inhibit_gc = v7->inhibit_gc;
-  val_t args = v7_mk_dense_array(v7);
-
-  *res = v7_mk_dense_array(v7);
 
-  v7_own(v7, &args);
-
-  v7_array_push(v7, args, v);
-  v7_array_push(v7, args, n);
-  v7_array_push(v7, args, this_obj);
-
-  v7->inhibit_gc = 0;
-  rcode = b_apply(v7, cb, this_obj, args, 0, res);
-  if (rcode != V7_OK) {
-    goto clean;
+  if (!v7_is_object(*args)) {
+    *args = v7_mk_dense_array(v7);
   }
+  v7_array_set(v7, *args, 0, v);
+  v7_array_set(v7, *args, 1, n);
+  v7_array_set(v7, *args, 2, this_obj);
 
-clean:
+  v7->inhibit_gc = 0;
+  rcode = b_apply(v7, cb, this_obj, *args, 0, res);
   v7->inhibit_gc = saved_inhibit_gc;
-  v7_disown(v7, &args);
 
   return rcode;
 }
@@ -32245,7 +37428,7 @@ WARN_UNUSED_RESULT
 V7_PRIVATE enum v7_err Array_forEach(struct v7 *v7, v7_val_t *res) {
   enum v7_err rcode = V7_OK;
   val_t this_obj = v7_get_this(v7);
-  val_t v = V7_UNDEFINED, cb = v7_arg(v7, 0);
+  val_t v = V7_UNDEFINED, cb = v7_arg(v7, 0), args = V7_UNDEFINED;
   unsigned long len, i;
   int has;
   /* a_prep2 uninhibits GC when calling cb */
@@ -32262,13 +37445,14 @@ V7_PRIVATE enum v7_err Array_forEach(struct v7 *v7, v7_val_t *res) {
   }
 
   tmp_stack_push(&vf, &v);
+  tmp_stack_push(&vf, &args);
 
   len = v7_array_length(v7, this_obj);
   for (i = 0; i < len; i++) {
     v = v7_array_get2(v7, this_obj, i, &has);
     if (!has) continue;
 
-    rcode = a_prep2(v7, cb, v, v7_mk_number(v7, i), this_obj, res);
+    rcode = a_prep2(v7, cb, v, v7_mk_number(v7, i), this_obj, &args, res);
     if (rcode != V7_OK) {
       goto clean;
     }
@@ -32283,7 +37467,7 @@ WARN_UNUSED_RESULT
 V7_PRIVATE enum v7_err Array_map(struct v7 *v7, v7_val_t *res) {
   enum v7_err rcode = V7_OK;
   val_t this_obj = v7_get_this(v7);
-  val_t arg0, arg1, el, v;
+  val_t arg0, arg1, el, v, args = V7_UNDEFINED;
   unsigned long len, i;
   int has;
   /* a_prep2 uninhibits GC when calling cb */
@@ -32300,11 +37484,12 @@ V7_PRIVATE enum v7_err Array_map(struct v7 *v7, v7_val_t *res) {
     tmp_stack_push(&vf, &arg0);
     tmp_stack_push(&vf, &arg1);
     tmp_stack_push(&vf, &v);
+    tmp_stack_push(&vf, &args);
 
     for (i = 0; i < len; i++) {
       v = v7_array_get2(v7, this_obj, i, &has);
       if (!has) continue;
-      rcode = a_prep2(v7, arg0, v, v7_mk_number(v7, i), arg1, &el);
+      rcode = a_prep2(v7, arg0, v, v7_mk_number(v7, i), arg1, &args, &el);
       if (rcode != V7_OK) {
         goto clean;
       }
@@ -32325,7 +37510,7 @@ WARN_UNUSED_RESULT
 V7_PRIVATE enum v7_err Array_every(struct v7 *v7, v7_val_t *res) {
   enum v7_err rcode = V7_OK;
   val_t this_obj = v7_get_this(v7);
-  val_t arg0, arg1, el, v;
+  val_t arg0, arg1, el, v, args = V7_UNDEFINED;
   unsigned long i, len;
   int has;
   /* a_prep2 uninhibits GC when calling cb */
@@ -32342,12 +37527,13 @@ V7_PRIVATE enum v7_err Array_every(struct v7 *v7, v7_val_t *res) {
     tmp_stack_push(&vf, &arg0);
     tmp_stack_push(&vf, &arg1);
     tmp_stack_push(&vf, &v);
+    tmp_stack_push(&vf, &args);
 
     len = v7_array_length(v7, this_obj);
     for (i = 0; i < len; i++) {
       v = v7_array_get2(v7, this_obj, i, &has);
       if (!has) continue;
-      rcode = a_prep2(v7, arg0, v, v7_mk_number(v7, i), arg1, &el);
+      rcode = a_prep2(v7, arg0, v, v7_mk_number(v7, i), arg1, &args, &el);
       if (rcode != V7_OK) {
         goto clean;
       }
@@ -32369,7 +37555,7 @@ WARN_UNUSED_RESULT
 V7_PRIVATE enum v7_err Array_some(struct v7 *v7, v7_val_t *res) {
   enum v7_err rcode = V7_OK;
   val_t this_obj = v7_get_this(v7);
-  val_t arg0, arg1, el, v;
+  val_t arg0, arg1, el, v, args = V7_UNDEFINED;
   unsigned long i, len;
   int has;
   /* a_prep2 uninhibits GC when calling cb */
@@ -32386,12 +37572,13 @@ V7_PRIVATE enum v7_err Array_some(struct v7 *v7, v7_val_t *res) {
     tmp_stack_push(&vf, &arg0);
     tmp_stack_push(&vf, &arg1);
     tmp_stack_push(&vf, &v);
+    tmp_stack_push(&vf, &args);
 
     len = v7_array_length(v7, this_obj);
     for (i = 0; i < len; i++) {
       v = v7_array_get2(v7, this_obj, i, &has);
       if (!has) continue;
-      rcode = a_prep2(v7, arg0, v, v7_mk_number(v7, i), arg1, &el);
+      rcode = a_prep2(v7, arg0, v, v7_mk_number(v7, i), arg1, &args, &el);
       if (rcode != V7_OK) {
         goto clean;
       }
@@ -32413,7 +37600,7 @@ WARN_UNUSED_RESULT
 V7_PRIVATE enum v7_err Array_filter(struct v7 *v7, v7_val_t *res) {
   enum v7_err rcode = V7_OK;
   val_t this_obj = v7_get_this(v7);
-  val_t arg0, arg1, el, v;
+  val_t arg0, arg1, el, v, args = V7_UNDEFINED;
   unsigned long len, i;
   int has;
   /* a_prep2 uninhibits GC when calling cb */
@@ -32430,11 +37617,12 @@ V7_PRIVATE enum v7_err Array_filter(struct v7 *v7, v7_val_t *res) {
     tmp_stack_push(&vf, &arg0);
     tmp_stack_push(&vf, &arg1);
     tmp_stack_push(&vf, &v);
+    tmp_stack_push(&vf, &args);
 
     for (i = 0; i < len; i++) {
       v = v7_array_get2(v7, this_obj, i, &has);
       if (!has) continue;
-      rcode = a_prep2(v7, arg0, v, v7_mk_number(v7, i), arg1, &el);
+      rcode = a_prep2(v7, arg0, v, v7_mk_number(v7, i), arg1, &args, &el);
       if (rcode != V7_OK) {
         goto clean;
       }
@@ -32452,6 +37640,65 @@ clean:
   return rcode;
 }
 
+#if V7_ENABLE__Array__reduce
+WARN_UNUSED_RESULT
+V7_PRIVATE enum v7_err Array_reduce(struct v7 *v7, v7_val_t *res) {
+  enum v7_err rcode = V7_OK;
+  val_t this_obj = v7_get_this(v7);
+  val_t cb = v7_arg(v7, 0), v = V7_UNDEFINED, args = V7_UNDEFINED;
+  unsigned long len, i = 0;
+  int has = 0, saved_inhibit_gc = v7->inhibit_gc;
+  struct gc_tmp_frame vf = new_tmp_frame(v7);
+
+  tmp_stack_push(&vf, &v);
+  tmp_stack_push(&vf, &args);
+  tmp_stack_push(&vf, res);
+
+  if (!v7_is_callable(v7, cb)) {
+    rcode = v7_throwf(v7, TYPE_ERROR, "Function expected");
+    goto clean;
+  }
+
+  len = v7_array_length(v7, this_obj);
+  if (v7_argc(v7) > 1) {
+    *res = v7_arg(v7, 1);
+  } else {
+    /* the first element is the initial value */
+    while (!has && i < len) {
+      *res = v7_array_get2(v7, this_obj, i++, &has);
+    }
+    if (!has) {
+      rcode = v7_throwf(v7, TYPE_ERROR,
+                        "Reduce of empty array with no initial value");
+      goto clean;
+    }
+  }
+
+  args = v7_mk_dense_array(v7);
+  for (; i < len; i++) {
+    v = v7_array_get2(v7, this_obj, i, &has);
+    if (!has) continue;
+
+    /* cb(acc, v, i, this_obj) */
+    v7_array_set(v7, args, 0, *res);
+    v7_array_set(v7, args, 1, v);
+    v7_array_set(v7, args, 2, v7_mk_number(v7, i));
+    v7_array_set(v7, args, 3, this_obj);
+
+    v7->inhibit_gc = 0;
+    rcode = b_apply(v7, cb, V7_UNDEFINED, args, 0, res);
+    v7->inhibit_gc = saved_inhibit_gc;
+    if (rcode != V7_OK) {
+      goto clean;
+    }
+  }
+
+clean:
+  tmp_frame_cleanup(&vf);
+  return rcode;
+}
+#endif
+
 WARN_UNUSED_RESULT
 V7_PRIVATE enum v7_err Array_concat(struct v7 *v7, v7_val_t *res) {
   enum v7_err rcode = V7_OK;
@@ -32528,6 +37775,9 @@ V7_PRIVATE void init_array(struct v7 *v7) {
   set_method(v7, v7->vals.array_prototype, "join", Array_join, 1);
   set_method(v7, v7->vals.array_prototype, "map", Array_map, 1);
   set_method(v7, v7->vals.array_prototype, "push", Array_push, 1);
+#if V7_ENABLE__Array__reduce
+  set_method(v7, v7->vals.array_prototype, "reduce", Array_reduce, 1);
+#endif
   set_method(v7, v7->vals.array_prototype, "reverse", Array_reverse, 0);
   set_method(v7, v7->vals.array_prototype, "slice", Array_slice, 2);
   set_method(v7, v7->vals.array_prototype, "some", Array_some, 1);
@@ -33232,8 +38482,8 @@ static enum v7_err s_index_of(struct v7 *v7, int last, val_t *res) {
 
     if (bytecnt2 <= bytecnt1) {
       end = p1 + bytecnt1;
-      len1 = utfnlen(p1, bytecnt1);
-      len2 = utfnlen(p2, bytecnt2);
+      len1 = str_val_runes(v7, &this_obj);
+      len2 = str_val_runes(v7, &sub);
 
       if (v7_argc(v7) > 1) {
         /* `fromIndex` was provided. Normalize it */
@@ -33255,10 +38505,9 @@ static enum v7_err s_index_of(struct v7 *v7, int last, val_t *res) {
 
         /* adjust pointers accordingly to `fromIndex` */
         if (last) {
-          const char *end_tmp = utfnshift(p1, fromIndex + len2);
-          end = (end_tmp < end) ? end_tmp : end;
+          end = str_val_rune_ptr(v7, &this_obj, fromIndex + len2);
         } else {
-          p1 = utfnshift(p1, fromIndex);
+          p1 = str_val_rune_ptr(v7, &this_obj, fromIndex);
         }
       }
 
@@ -33553,7 +38802,8 @@ V7_PRIVATE enum v7_err Str_replace(struct v7 *v7, v7_val_t *res) {
           }
         }
         rcode = v7_array_push_throwing(
-            v7, arr, v7_mk_number(v7, utfnlen(s, loot.caps[0].start - s)),
+            v7, arr, v7_mk_number(v7, str_val_rune_idx(
+                             v7, &this_obj, loot.caps[0].start - s)),
             NULL);
         if (rcode != V7_OK) {
           goto clean;
@@ -33669,7 +38919,7 @@ V7_PRIVATE enum v7_err Str_search(struct v7 *v7, v7_val_t *res) {
 
     if (!slre_exec(v7_get_regexp_struct(v7, ro)->compiled_regexp, 0, s,
                    s + s_len, &sub))
-      utf_shift = utfnlen(s, sub.caps[0].start - s); /* calc shift for UTF-8 */
+      utf_shift = str_val_rune_idx(v7, &so, sub.caps[0].start - s);
   } else {
     utf_shift = 0;
   }
@@ -33697,9 +38947,7 @@ V7_PRIVATE enum v7_err Str_slice(struct v7 *v7, v7_val_t *res) {
     goto clean;
   }
 
-  begin = v7_get_string(v7, &so, &len);
-
-  to = len = utfnlen(begin, len);
+  to = len = str_val_runes(v7, &so);
   if (num_args > 0) {
     rcode = to_long(v7, v7_arg(v7, 0), 0, &from);
     if (rcode != V7_OK) {
@@ -33726,8 +38974,8 @@ V7_PRIVATE enum v7_err Str_slice(struct v7 *v7, v7_val_t *res) {
   }
 
   if (from > to) to = from;
-  end = utfnshift(begin, to);
-  begin = utfnshift(begin, from);
+  end = str_val_rune_ptr(v7, &so, to);
+  begin = str_val_rune_ptr(v7, &so, from);
 
   *res = v7_mk_string(v7, begin, end - begin, 1);
 
@@ -33826,8 +39074,7 @@ V7_PRIVATE enum v7_err Str_length(struct v7 *v7, v7_val_t *res) {
   }
 
   if (v7_is_string(s)) {
-    const char *p = v7_get_string(v7, &s, &len);
-    len = utfnlen(p, len);
+    len = str_val_runes(v7, &s);
   }
 
   *res = v7_mk_number(v7, len);
@@ -33894,15 +39141,14 @@ static enum v7_err s_substr(struct v7 *v7, val_t s, long start, long len,
                             val_t *res) {
   enum v7_err rcode = V7_OK;
   size_t n;
-  const char *p;
+  const char *p, *end;
 
   rcode = to_string(v7, s, &s, NULL, 0, NULL);
   if (rcode != V7_OK) {
     goto clean;
   }
 
-  p = v7_get_string(v7, &s, &n);
-  n = utfnlen(p, n);
+  n = str_val_runes(v7, &s);
 
   if (start < (long) n && len > 0) {
     if (start < 0) start = (long) n + start;
@@ -33911,12 +39157,13 @@ static enum v7_err s_substr(struct v7 *v7, val_t s, long start, long len,
     if (start > (long) n) start = n;
     if (len < 0) len = 0;
     if (len > (long) n - start) len = n - start;
-    p = utfnshift(p, start);
+    p = str_val_rune_ptr(v7, &s, start);
+    end = str_val_rune_ptr(v7, &s, start + len);
   } else {
-    len = 0;
+    p = end = NULL;
   }
 
-  *res = v7_mk_string(v7, p, len, 1);
+  *res = v7_mk_string(v7, p, end - p, 1);
 
 clean:
   return rcode;
@@ -35812,7 +41059,7 @@ V7_PRIVATE enum v7_err rx_exec(struct v7 *v7, val_t rx, val_t vstr, int lind,
     begin = str;
 
     if (rp->lastIndex < 0) rp->lastIndex = 0;
-    if (flag_g || lind) begin = utfnshift(str, rp->lastIndex);
+    if (flag_g || lind) begin = str_val_rune_ptr(v7, &s, rp->lastIndex);
 
     if (!slre_exec(rp->compiled_regexp, 0, begin, end, &sub)) {
       int i;
@@ -35825,9 +41072,12 @@ V7_PRIVATE enum v7_err rx_exec(struct v7 *v7, val_t rx, val_t vstr, int lind,
         v7_array_push(v7, arr, v7_mk_string(v7, ptok->start + rel,
                                             ptok->end - ptok->start, 1));
       }
-      if (flag_g) rp->lastIndex = utfnlen(str, sub.caps->end + rel - str);
+      if (flag_g) {
+        rp->lastIndex = str_val_rune_idx(v7, &s, sub.caps->end - str);
+      }
       v7_def(v7, arr, "index", 5, V7_DESC_WRITABLE(0),
-             v7_mk_number(v7, utfnlen(str + rel, sub.caps->start - str)));
+             v7_mk_number(v7, str_val_rune_idx(v7, &s,
+                                               sub.caps->start - str)));
       *res = arr;
       goto clean;
     } else {
@@ -36077,6 +41327,10 @@ static void show_usage(char *argv[]) {
   fprintf(stderr, "%s\n", "  -vo <n>              object arena size");
   fprintf(stderr, "%s\n", "  -vf <n>              function arena size");
   fprintf(stderr, "%s\n", "  -vp <n>              property arena size");
+#if V7_ENABLE_PROFILER
+  fprintf(stderr, "%s\n", "  -prof <file>         write bcode profile into a file");
+  fprintf(stderr, "%s\n", "  -prof-period <n>     profile every n-th instruction");
+#endif
 #ifdef V7_FREEZE
   fprintf(stderr, "%s\n", "  -freeze filename     dump JS heap into a file");
 #endif
@@ -36106,6 +41360,39 @@ static void dump_mm_stats(struct v7 *v7) {
                  v7->generic_object_arena.cell_size +
              gc_arena_size(&v7->function_arena) * v7->function_arena.cell_size +
              gc_arena_size(&v7->property_arena) * v7->property_arena.cell_size);
+#if !V7_DISABLE_INLINE_CACHE
+  printf("inline cache: hits %lu, misses %lu\n", v7->ic_hits, v7->ic_misses);
+#endif
+#if !V7_DISABLE_BCODE_CACHE
+  printf("bcode cache: hits %lu, misses %lu, bytes %" SIZE_T_FMT "\n",
+         v7->bcode_cache_hits, v7->bcode_cache_misses, v7->bcode_cache_bytes);
+#endif
+}
+#endif
+
+#if V7_ENABLE_PROFILER
+/*
+ * Writes the flat profile into `filename`, and the folded stacks, suitable
+ * for flame graph tools, into `filename.folded`
+ */
+static void write_profile(struct v7 *v7, const char *filename) {
+  char folded[1024];
+  FILE *fp;
+
+  if ((fp = fopen(filename, "w")) == NULL) {
+    fprintf(stderr, "Cannot write [%s]\n", filename);
+    return;
+  }
+  v7_prof_dump(v7, fp);
+  fclose(fp);
+
+  snprintf(folded, sizeof(folded), "%s.folded", filename);
+  if ((fp = fopen(folded, "w")) == NULL) {
+    fprintf(stderr, "Cannot write [%s]\n", folded);
+    return;
+  }
+  v7_prof_dump_folded(v7, fp);
+  fclose(fp);
 }
 #endif
 
@@ -36119,6 +41406,10 @@ int v7_main(int argc, char *argv[], void (*pre_freeze_init)(struct v7 *),
   val_t res;
   int nexprs = 0;
   const char *exprs[16];
+#if V7_ENABLE_PROFILER
+  const char *prof_file = NULL;
+  unsigned int prof_period = 1;
+#endif
 
   memset(&opts, 0, sizeof(opts));
 
@@ -36157,6 +41448,15 @@ int v7_main(int argc, char *argv[], void (*pre_freeze_init)(struct v7 *),
       opts.property_arena_size = atoi(argv[i + 1]);
       i++;
     }
+#if V7_ENABLE_PROFILER
+    else if (strcmp(argv[i], "-prof") == 0 && i + 1 < argc) {
+      prof_file = argv[i + 1];
+      i++;
+    } else if (strcmp(argv[i], "-prof-period") == 0 && i + 1 < argc) {
+      prof_period = atoi(argv[i + 1]);
+      i++;
+    }
+#endif
 #ifdef V7_FREEZE
     else if (strcmp(argv[i], "-freeze") == 0 && i + 1 < argc) {
       opts.freeze_file = argv[i + 1];
@@ -36206,6 +41506,12 @@ int v7_main(int argc, char *argv[], void (*pre_freeze_init)(struct v7 *),
   (void) dump_stats;
 #endif
 
+#if V7_ENABLE_PROFILER
+  if (prof_file != NULL) {
+    v7_prof_start(v7, prof_period);
+  }
+#endif
+
   /* Execute inline expressions */
   for (j = 0; j < nexprs; j++) {
     enum v7_err (*exec)(struct v7 *, const char *, v7_val_t *);
@@ -36256,6 +41562,13 @@ int v7_main(int argc, char *argv[], void (*pre_freeze_init)(struct v7 *),
     }
   }
 
+#if V7_ENABLE_PROFILER
+  if (prof_file != NULL) {
+    v7_prof_stop(v7);
+    write_profile(v7, prof_file);
+  }
+#endif
+
 #ifdef V7_FREEZE
   if (opts.freeze_file != NULL) {
     freeze(v7, opts.freeze_file);
@@ -435,6 +435,22 @@
 #define V7_DISABLE_GC 0
 #endif
 
+#ifndef V7_DISABLE_LAZY_SWEEP
+#define V7_DISABLE_LAZY_SWEEP 0
+#endif
+
+#ifndef V7_DISABLE_INLINE_CACHE
+#define V7_DISABLE_INLINE_CACHE 0
+#endif
+
+#ifndef V7_DISABLE_LOCAL_SLOTS
+#define V7_DISABLE_LOCAL_SLOTS 0
+#endif
+
+#ifndef V7_DISABLE_BCODE_CACHE
+#define V7_DISABLE_BCODE_CACHE 0
+#endif
+
 #ifndef V7_DISABLE_CALL_ERROR_CONTEXT
 #define V7_DISABLE_CALL_ERROR_CONTEXT 0
 #endif
@@ -451,6 +467,18 @@
 #define V7_DISABLE_STR_ALLOC_SEQ 0
 #endif
 
+#ifndef V7_DISABLE_STR_META
+#define V7_DISABLE_STR_META 0
+#endif
+
+#ifndef V7_DISABLE_PROP_INDEX
+#define V7_DISABLE_PROP_INDEX 0
+#endif
+
+#ifndef V7_DISABLE_ATOMS
+#define V7_DISABLE_ATOMS 0
+#endif
+
 #ifndef V7_ENABLE_CALL_TRACE
 #define V7_ENABLE_CALL_TRACE 0
 #endif
@@ -460,7 +488,7 @@
 #endif
 
 #ifndef V7_ENABLE_DENSE_ARRAYS
-#define V7_ENABLE_DENSE_ARRAYS 0
+#define V7_ENABLE_DENSE_ARRAYS 1
 #endif
 
 #ifndef V7_ENABLE_ENTITY_IDS
@@ -487,6 +515,10 @@
 #define V7_ENABLE_JS_SETTERS 0
 #endif
 
+#ifndef V7_ENABLE_PROFILER
+#define V7_ENABLE_PROFILER 0
+#endif
+
 #ifndef V7_ENABLE_STACK_TRACKING
 #define V7_ENABLE_STACK_TRACKING 0
 #endif
@@ -495,6 +527,10 @@
 #define V7_ENABLE_SOCKET 0
 #endif
 
+#ifndef V7_ENABLE_STR_BUILDER
+#define V7_ENABLE_STR_BUILDER 1
+#endif
+
 #ifndef V7_AST_FORCE_LINE_NUMBERS
 #define V7_AST_FORCE_LINE_NUMBERS 0
 #endif
@@ -623,6 +659,24 @@ struct v7_create_opts {
   size_t object_arena_size;
   size_t function_arena_size;
   size_t property_arena_size;
+  /*
+   * Max number of scripts whose compiled bcode is kept by `v7_exec()` and
+   * friends, so that executing the same source again skips parsing and
+   * compilation. 0 (the default) disables the cache.
+   */
+  size_t bcode_cache_size;
+  /*
+   * Garbage collection policy. After each collection, the heap is allowed to
+   * grow until the live data (cells and strings) make up `gc_live_ratio`
+   * percent of it, and at least by `gc_alloc_budget` bytes, before the next
+   * collection is triggered; 100 collects whenever an arena runs out of
+   * cells. Arenas grow by blocks of `gc_min_growth` to `gc_max_growth` cells.
+   * Defaults are 80, 0, 10 and 1000 respectively.
+   */
+  unsigned int gc_live_ratio;
+  size_t gc_alloc_budget;
+  size_t gc_min_growth;
+  size_t gc_max_growth;
 #ifdef V7_STACK_SIZE
   void *c_stack_base;
 #endif
@@ -857,6 +911,24 @@ struct v7_create_opts {
   size_t object_arena_size;
   size_t function_arena_size;
   size_t property_arena_size;
+  /*
+   * Max number of scripts whose compiled bcode is kept by `v7_exec()` and
+   * friends, so that executing the same source again skips parsing and
+   * compilation. 0 (the default) disables the cache.
+   */
+  size_t bcode_cache_size;
+  /*
+   * Garbage collection policy. After each collection, the heap is allowed to
+   * grow until the live data (cells and strings) make up `gc_live_ratio`
+   * percent of it, and at least by `gc_alloc_budget` bytes, before the next
+   * collection is triggered; 100 collects whenever an arena runs out of
+   * cells. Arenas grow by blocks of `gc_min_growth` to `gc_max_growth` cells.
+   * Defaults are 80, 0, 10 and 1000 respectively.
+   */
+  unsigned int gc_live_ratio;
+  size_t gc_alloc_budget;
+  size_t gc_min_growth;
+  size_t gc_max_growth;
 #ifdef V7_STACK_SIZE
   void *c_stack_base;
 #endif
@@ -1219,6 +1291,8 @@ typedef unsigned short v7_prop_attr_t;
  * keep all offsets in one place
  */
 #define _V7_DESC_PRESERVE_VALUE (1 << 8)
+/* special property holding the hash index of object's own properties */
+#define _V7_PROPERTY_INDEX (1 << 9)
 
 #define V7_PROP_ATTR_IS_WRITABLE(a) (!(a & V7_PROPERTY_NON_WRITABLE))
 #define V7_PROP_ATTR_IS_ENUMERABLE(a) (!(a & V7_PROPERTY_NON_ENUMERABLE))
@@ -1354,6 +1428,10 @@ struct prop_iter_ctx {
   struct prop_iter_proxy_ctx *proxy_ctx;
 #endif
   struct v7_property *cur_prop;
+#if V7_ENABLE_DENSE_ARRAYS
+  v7_val_t dense_array;
+  unsigned long dense_idx;
+#endif
 
   unsigned init : 1;
 };
@@ -1694,6 +1772,32 @@ enum v7_err v7_stringify_throwing(struct v7 *v7, v7_val_t v, char *buf,
                                   size_t size, enum v7_stringify_mode mode,
                                   char **res);
 
+/*
+ * Output callback for `v7_stringify_to_callback()`: receives the next `len`
+ * bytes of the generated string. The data is not 0-terminated.
+ */
+typedef void (*v7_stringify_cb_t)(const char *data, size_t len,
+                                  void *user_data);
+
+/*
+ * Like `v7_stringify_throwing()`, but instead of collecting the whole string
+ * in memory, passes it to the callback `cb` in chunks as it's generated. Use
+ * it to write large values directly to a file or a socket.
+ *
+ * Example code:
+ *
+ *     static void write_cb(const char *data, size_t len, void *user_data) {
+ *       fwrite(data, 1, len, (FILE *) user_data);
+ *     }
+ *     ...
+ *     rcode = v7_stringify_to_callback(v7, obj, V7_STRINGIFY_JSON, write_cb,
+ *                                      stdout);
+ */
+WARN_UNUSED_RESULT
+enum v7_err v7_stringify_to_callback(struct v7 *v7, v7_val_t v,
+                                     enum v7_stringify_mode mode,
+                                     v7_stringify_cb_t cb, void *user_data);
+
 /*
  * A shortcut for `v7_stringify()` with `V7_STRINGIFY_JSON`
  */
@@ -1788,6 +1892,15 @@ enum v7_err v7_exec_buf(struct v7 *v7, const char *js_code, size_t len,
 WARN_UNUSED_RESULT
 enum v7_err v7_exec_file(struct v7 *v7, const char *path, v7_val_t *result);
 
+/*
+ * Executes the precompiled bcode image in `path`, written by `v7_compile()`
+ * with `use_bcode`. Where supported, the file is mapped in memory and
+ * executed in place. The image is unloaded once no function it defines is
+ * alive anymore.
+ */
+WARN_UNUSED_RESULT
+enum v7_err v7_load_image(struct v7 *v7, const char *path, v7_val_t *result);
+
 /*
  * Parse `str` and store corresponding JavaScript object in `res` variable.
  * String `str` should be '\0'-terminated.
@@ -1802,6 +1915,39 @@ enum v7_err v7_parse_json(struct v7 *v7, const char *str, v7_val_t *res);
 WARN_UNUSED_RESULT
 enum v7_err v7_parse_json_file(struct v7 *v7, const char *path, v7_val_t *res);
 
+/*
+ * Incremental JSON parser, for documents which arrive in pieces (e.g. from
+ * the network) or are too large to be kept in memory as a whole:
+ *
+ *    struct v7_json_parser *p = v7_json_parser_create(v7);
+ *    while (<more data>) {
+ *      if (v7_json_parser_feed(p, buf, len) != V7_OK) break;
+ *    }
+ *    rcode = v7_json_parser_end(p, &res);
+ *    v7_json_parser_destroy(p);
+ *
+ * Chunks may be split at arbitrary positions. Errors are reported as soon as
+ * they are detected: `v7_json_parser_feed()` and `v7_json_parser_end()`
+ * return `V7_SYNTAX_ERROR` and the exception is available via
+ * `v7_get_thrown_value()`.
+ */
+struct v7_json_parser;
+
+struct v7_json_parser *v7_json_parser_create(struct v7 *v7);
+
+WARN_UNUSED_RESULT
+enum v7_err v7_json_parser_feed(struct v7_json_parser *p, const char *buf,
+                                size_t len);
+
+/*
+ * Finishes parsing and stores the parsed value in `res`. If the document is
+ * incomplete, returns `V7_SYNTAX_ERROR`.
+ */
+WARN_UNUSED_RESULT
+enum v7_err v7_json_parser_end(struct v7_json_parser *p, v7_val_t *res);
+
+void v7_json_parser_destroy(struct v7_json_parser *p);
+
 #if !defined(V7_NO_COMPILER)
 
 /*
@@ -1930,11 +2076,26 @@ enum v7_heap_stat_what {
   V7_HEAP_STAT_BCODE_LIT_TOTAL_SIZE,
   V7_HEAP_STAT_BCODE_LIT_DESER_SIZE,
   V7_HEAP_STAT_FUNC_OWNED,
-  V7_HEAP_STAT_FUNC_OWNED_MAX
+  V7_HEAP_STAT_FUNC_OWNED_MAX,
+  V7_HEAP_STAT_IC_HITS,
+  V7_HEAP_STAT_IC_MISSES,
+  V7_HEAP_STAT_BCODE_CACHE_HITS,
+  V7_HEAP_STAT_BCODE_CACHE_MISSES,
+  V7_HEAP_STAT_BCODE_CACHE_BYTES,
+  V7_HEAP_STAT_GC_COUNT
 };
 
 /* Returns a given heap statistics */
 int v7_heap_stat(struct v7 *v7, enum v7_heap_stat_what what);
+
+/*
+ * Returns inline cache statistics of the given JS function: number of
+ * property lookups served by the cache (`hits`) and the ones which had to
+ * walk the property lists (`misses`). Returns 0 on success, or -1 if `func`
+ * is not a JS function.
+ */
+int v7_func_ic_stat(struct v7 *v7, v7_val_t func, unsigned long *hits,
+                    unsigned long *misses);
 #endif
 
 /*
@@ -1943,12 +2104,86 @@ int v7_heap_stat(struct v7 *v7, enum v7_heap_stat_what what);
  */
 void v7_gc(struct v7 *v7, int full);
 
+/*
+ * Collections triggered by allocations only mark the live cells, and leave
+ * the garbage to be swept lazily, a few blocks at a time, when the arenas run
+ * out of free cells. This function performs a step of that pending sweep,
+ * visiting about `max_cells` cells at most, so that the host can get it done
+ * in between I/O. Returns non-zero if some sweeping is still pending.
+ *
+ * `v7_gc()` always sweeps the whole heap before returning.
+ */
+int v7_gc_step(struct v7 *v7, size_t max_cells);
+
 #if defined(__cplusplus)
 }
 #endif /* __cplusplus */
 
 #endif /* CS_V7_SRC_GC_PUBLIC_H_ */
 #ifdef V7_MODULE_LINES
+#line 1 "v7/src/profiler_public.h"
+#endif
+/*
+ * Copyright (c) 2014 Cesanta Software Limited
+ * All rights reserved
+ */
+
+/*
+ * === Bcode profiler
+ */
+
+#ifndef CS_V7_SRC_PROFILER_PUBLIC_H_
+#define CS_V7_SRC_PROFILER_PUBLIC_H_
+
+/* Amalgamated: #include "v7/src/core_public.h" */
+
+#if V7_ENABLE_PROFILER
+
+#include <stdio.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Starts profiling the bcode executed by the given instance: every
+ * `period`-th executed instruction is sampled and attributed, together with
+ * the wall time elapsed since the previous sample, to its filename, line
+ * number and opcode, as well as to the current JS call stack. A `period` of 1
+ * (or 0) counts every instruction.
+ *
+ * Data collected by a previous run is discarded.
+ */
+void v7_prof_start(struct v7 *v7, unsigned int period);
+
+/*
+ * Stops profiling. Collected data is kept until the next `v7_prof_start()`
+ * or `v7_destroy()`, so it can be dumped later.
+ */
+void v7_prof_stop(struct v7 *v7);
+
+/*
+ * Writes a flat profile to `fp`: one line per (file, line, opcode) with the
+ * number of instructions and the wall time attributed to it, most executed
+ * first.
+ */
+void v7_prof_dump(struct v7 *v7, FILE *fp);
+
+/*
+ * Writes sampled call stacks to `fp` in the "folded" format consumed by
+ * flame graph tools: one line per distinct stack, frames separated by `;`
+ * from the outermost, followed by the instruction count.
+ */
+void v7_prof_dump_folded(struct v7 *v7, FILE *fp);
+
+#if defined(__cplusplus)
+}
+#endif /* __cplusplus */
+
+#endif /* V7_ENABLE_PROFILER */
+
+#endif /* CS_V7_SRC_PROFILER_PUBLIC_H_ */
+#ifdef V7_MODULE_LINES
 #line 1 "v7/src/util_public.h"
 #endif
 /*
@@ -1985,6 +2220,11 @@ void v7_fprint(FILE *f, struct v7 *v7, v7_val_t v);
  * V7_STRINGIFY_DEBUG mode is used. */
 void v7_fprintln(FILE *f, struct v7 *v7, v7_val_t v);
 
+/* Output JSON representation of the value to a file, without building it in
+ * memory first. See `v7_stringify_to_callback()`. */
+WARN_UNUSED_RESULT
+enum v7_err v7_fprint_json(FILE *f, struct v7 *v7, v7_val_t v);
+
 /* Output stack trace recorded in the exception `e` to file `f` */
 void v7_fprint_stack_trace(FILE *f, struct v7 *v7, v7_val_t e);
 